@@ -39,6 +39,8 @@ _start(struct crt_info *info)
     if (set_program_break(info->program_break) != 0)
         exit(1);
 
+    set_stdio_rings(info->stdout_ring, info->stderr_ring);
+
     for (i = 0; i < info->info_num; i++)
         local_init(&info->info[i]);
 
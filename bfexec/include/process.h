@@ -24,12 +24,15 @@
 
 #include <vector>
 #include <memory>
+#include <initializer_list>
 
 #include <processid.h>
 #include <processlistid.h>
 
 #include <crt_info.h>
+#include <stdio_ring.h>
 #include <bfelf_loader.h>
+#include <vmcall_hyperkernel_interface.h>
 
 class process
 {
@@ -40,6 +43,23 @@ public:
 
     gsl::not_null<bfelf_file_t *> load_elf(const std::string &filename);
 
+    /// Drain
+    ///
+    /// Copies whatever the VM app wrote to its stdout and stderr rings to
+    /// this process's own stdout and stderr.
+    ///
+    void drain();
+
+private:
+
+    /// Queue
+    ///
+    /// Adds an operation to the batch that sets up the VM app. Nothing is
+    /// sent to the VMM until the constructor runs the whole batch with
+    /// vmcall__batch.
+    ///
+    void queue(uint64_t op, std::initializer_list<uint64_t> args);
+
 private:
 
     processid::type m_id;
@@ -56,9 +76,14 @@ private:
     std::unique_ptr<char> m_stack;
     std::unique_ptr<crt_info> m_crt_info;
 
+    std::unique_ptr<stdio_ring_t> m_stdout_ring;
+    std::unique_ptr<stdio_ring_t> m_stderr_ring;
+
     std::vector<std::unique_ptr<char>> m_segments;
     std::vector<std::unique_ptr<bfelf_file_t>> m_elfs;
 
+    std::vector<batch_op_t> m_batch;
+
 public:
 
     friend class hyperkernel_ut;
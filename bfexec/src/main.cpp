@@ -21,8 +21,11 @@
 
 #include <gsl/gsl>
 
+#include <array>
 #include <vector>
 #include <memory>
+#include <iomanip>
+#include <iostream>
 
 #include <vcpu.h>
 #include <process.h>
@@ -38,8 +41,62 @@ std::unique_ptr<process_list> g_proclt;
 std::vector<std::unique_ptr<vcpu>> g_vcpus;
 std::vector<std::unique_ptr<process>> g_processes;
 
+static const std::array<const char *, 65> exit_reason_names = {{
+    "exception_or_nmi", "external_interrupt", "triple_fault", "init_signal",
+    "sipi", "io_smi", "other_smi", "interrupt_window",
+    "nmi_window", "task_switch", "cpuid", "getsec",
+    "hlt", "invd", "invlpg", "rdpmc",
+    "rdtsc", "rsm", "vmcall", "vmclear",
+    "vmlaunch", "vmptrld", "vmptrst", "vmread",
+    "vmresume", "vmwrite", "vmxoff", "vmxon",
+    "control_register_accesses", "mov_dr", "io_instruction", "rdmsr",
+    "wrmsr", "vm_entry_failure_invalid_guest_state", "vm_entry_failure_msr_loading", "unknown_35",
+    "mwait", "monitor_trap_flag", "unknown_38", "monitor",
+    "pause", "vm_entry_failure_machine_check_event", "unknown_42", "tpr_below_threshold",
+    "apic_access", "virtualized_eoi", "access_to_gdtr_or_idtr", "access_to_ldtr_or_tr",
+    "ept_violation", "ept_misconfiguration", "invept", "rdtscp",
+    "vmx_preemption_timer_expired", "invvpid", "wbinvd", "xsetbv",
+    "apic_write", "rdrand", "invpcid", "vmfunc",
+    "unknown_60", "rdseed", "unknown_62", "xsaves",
+    "xrstors"
+}};
+
+void
+print_exit_stats(const vcpu &vc)
+{
+    std::cout << "vcpu " << std::hex << vc.id() << std::dec << " exits:" << '\n';
+
+    for (auto reason = 0UL; reason < EXIT_STATS_NUM_REASONS; reason++)
+    {
+        auto &&count = vmcall__get_exit_count(vc.id(), reason);
+        if (count == 0 || count == REG_INVALID)
+            continue;
+
+        std::cout << "    " << std::left << std::setw(40);
+
+        if (reason < exit_reason_names.size())
+            std::cout << exit_reason_names.at(reason);
+        else
+            std::cout << ("unknown_" + std::to_string(reason));
+
+        std::cout << std::right << std::setw(12) << count << '\n';
+    }
+
+    std::cout << "vcpu " << std::hex << vc.id() << std::dec << " exit to entry latency (cycles):" << '\n';
+
+    for (auto bucket = 0UL; bucket < EXIT_STATS_NUM_BUCKETS; bucket++)
+    {
+        auto &&count = vmcall__get_exit_histogram(vc.id(), bucket);
+        if (count == 0 || count == REG_INVALID)
+            continue;
+
+        std::cout << "    [2^" << std::setw(2) << bucket << ", 2^" << std::setw(2) << bucket + 1 << ")"
+                  << std::setw(12) << count << '\n';
+    }
+}
+
 int
-protected_main(const arg_list_type &args)
+protected_main(arg_list_type args)
 {
     auto ___ = gsl::finally([&]
     {
@@ -48,6 +105,10 @@ protected_main(const arg_list_type &args)
         g_proclt.reset();
     });
 
+    auto &&report = !args.empty() && args.front() == "--stats";
+    if (report)
+        args.erase(args.begin());
+
     g_proclt = std::make_unique<process_list>();
 
     for (auto i = 0; i < 1; i++)
@@ -56,8 +117,44 @@ protected_main(const arg_list_type &args)
     for (const auto &arg : args)
         g_processes.push_back(std::make_unique<process>(arg, g_proclt->id()));
 
-    if (!vmcall__sched_yield())
-        throw std::runtime_error("vmcall__sched_yield failed");
+    // Note:
+    //
+    // The host only gets its core back once the VM apps have nothing left
+    // to run, which is also the case when they are all parked in HLT, so
+    // keep yielding until every process has actually exited. Each time the
+    // host gets the core back, the VM apps' output is drained (a VM app
+    // yields when its output rings fill up, see stdio_ring_t).
+    //
+
+    while (true)
+    {
+        if (!vmcall__sched_yield())
+            throw std::runtime_error("vmcall__sched_yield failed");
+
+        for (const auto &proc : g_processes)
+            proc->drain();
+
+        auto &&jobs = vmcall__sched_num_jobs(g_proclt->id());
+        if (jobs == REG_INVALID)
+            throw std::runtime_error("vmcall__sched_num_jobs failed");
+
+        if (jobs == 0)
+            break;
+
+        ::sched_yield();
+    }
+
+    // Note:
+    //
+    // The exit statistics belong to the vCPUs, so they have to be read
+    // before the vCPUs are deleted.
+    //
+
+    if (report)
+    {
+        for (const auto &vc : g_vcpus)
+            print_exit_stats(*vc);
+    }
 
     return EXIT_SUCCESS;
 }
@@ -29,8 +29,10 @@
 #include <vmcall_hyperkernel_interface.h>
 
 #include <fstream>
+#include <iostream>
 #include <algorithm>
 
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <unistd.h>
 #include <cstdlib>
@@ -159,23 +161,65 @@ process::process(const std::string &filename, processlistid::type procltid) :
 
     m_crt_info->program_break = m_virt_addr;
 
-    if (!vmcall__vm_map_foreign_lookup(
-            m_procltid,
-            m_id,
-            0x00600000UL - STACK_SIZE,
-            stack_int,
-            STACK_SIZE,
-            0))
-        throw std::runtime_error("vmcall__vm_map_foreign_lookup failed");
+    // Note:
+    //
+    // The VM app's stdout and stderr are rings in this process's memory,
+    // mapped just above crt_info, so the VM app can write to them without
+    // exiting (see stdio_ring_t). Like the segments, they are locked so
+    // that the mapping stays valid.
+    //
 
-    if (!vmcall__vm_map_foreign_lookup(
-            m_procltid,
-            m_id,
-            m_info_addr,
-            crt_info_int,
-            0x1000,
-            0))
-        throw std::runtime_error("vmcall__vm_map_foreign_lookup failed");
+    auto &&ring_size = bfn::upper(sizeof(stdio_ring_t) + 0xFFF);
+    auto &&stdout_addr = m_info_addr + 0x1000;
+    auto &&stderr_addr = stdout_addr + ring_size;
+
+    m_stdout_ring = std::unique_ptr<stdio_ring_t>(malloc_aligned<stdio_ring_t>(ring_size));
+    m_stderr_ring = std::unique_ptr<stdio_ring_t>(malloc_aligned<stdio_ring_t>(ring_size));
+
+    for (const auto &ring : {m_stdout_ring.get(), m_stderr_ring.get()})
+    {
+        if (mlock(ring, ring_size) != 0)
+            throw std::runtime_error("mlock failed");
+    }
+
+    queue(BATCH_OP_VM_MAP_LOOKUP, {
+        m_procltid,
+        m_id,
+        stdout_addr,
+        reinterpret_cast<uintptr_t>(m_stdout_ring.get()),
+        ring_size,
+        0
+    });
+
+    queue(BATCH_OP_VM_MAP_LOOKUP, {
+        m_procltid,
+        m_id,
+        stderr_addr,
+        reinterpret_cast<uintptr_t>(m_stderr_ring.get()),
+        ring_size,
+        0
+    });
+
+    m_crt_info->stdout_ring = stdout_addr;
+    m_crt_info->stderr_ring = stderr_addr;
+
+    queue(BATCH_OP_VM_MAP_LOOKUP, {
+        m_procltid,
+        m_id,
+        0x00600000UL - STACK_SIZE,
+        stack_int,
+        STACK_SIZE,
+        0
+    });
+
+    queue(BATCH_OP_VM_MAP_LOOKUP, {
+        m_procltid,
+        m_id,
+        m_info_addr,
+        crt_info_int,
+        0x1000,
+        0
+    });
 
     auto &&entry = 0UL;
     auto &&stack = 0x00600000UL - 0x1000;
@@ -184,23 +228,89 @@ process::process(const std::string &filename, processlistid::type procltid) :
     if (ret != BFELF_SUCCESS)
         throw std::runtime_error("bfelf_file_get_entry failed");
 
-    if (!vmcall__set_thread_foreign_info(
-            m_procltid,
-            m_id,
-            0,
-            entry,
-            stack,
-            m_info_addr,
-            0))
-        throw std::runtime_error("vmcall__set_thread_foreign_info failed");
+    queue(BATCH_OP_SET_THREAD_INFO, {
+        m_procltid,
+        m_id,
+        0,
+        entry,
+        stack,
+        m_info_addr,
+        0
+    });
+
+    // Note:
+    //
+    // Every map (including the segments queued by load_elf) and the
+    // thread's info are sent to the VMM here, BATCH_MAX_OPS at a time,
+    // so setting up a VM app takes one exit (or a few, for a VM app with
+    // a lot of segments) instead of one per operation.
+    //
+
+    for (auto i = 0UL; i < m_batch.size(); i += BATCH_MAX_OPS)
+    {
+        auto num = std::min<uint64_t>(m_batch.size() - i, BATCH_MAX_OPS);
+        auto done = vmcall__batch(&m_batch.at(i), num);
+
+        if (done == REG_INVALID)
+            throw std::runtime_error("vmcall__batch failed");
+
+        if (done != num)
+            throw std::runtime_error("vmcall__batch failed: op #" + std::to_string(i + done));
+    }
+
+    m_batch.clear();
+}
+
+void
+process::queue(uint64_t op, std::initializer_list<uint64_t> args)
+{
+    batch_op_t batch_op = {};
+
+    if (args.size() > sizeof(batch_op.args) / sizeof(uint64_t))
+        throw std::runtime_error("too many batch op args: " + std::to_string(args.size()));
+
+    batch_op.op = op;
+    std::copy(args.begin(), args.end(), std::begin(batch_op.args));
+
+    m_batch.push_back(batch_op);
 }
 
 process::~process()
 {
+    this->drain();
+
     if (!vmcall__delete_foreign_process(m_procltid, m_id))
         bfwarning << "vmcall__delete_process failed\n";
 }
 
+void
+process::drain()
+{
+    auto drain_ring = [](stdio_ring_t * ring, std::ostream & os)
+    {
+        if (ring == nullptr)
+            return;
+
+        auto tail = ring->tail;
+        auto head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+        while (tail != head)
+        {
+            auto offset = tail % STDIO_RING_SIZE;
+            auto num = std::min(head - tail, STDIO_RING_SIZE - offset);
+
+            os.write(&gsl::at(ring->data, static_cast<std::ptrdiff_t>(offset)), static_cast<std::streamsize>(num));
+            tail += num;
+        }
+
+        os.flush();
+        __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+    };
+
+    drain_ring(m_stdout_ring.get(), std::cout);
+    drain_ring(m_stderr_ring.get(), std::cerr);
+}
+
 gsl::not_null<bfelf_file_t *>
 process::load_elf(const std::string &filename)
 {
@@ -224,6 +334,24 @@ process::load_elf(const std::string &filename)
     auto &&pic = bfelf_file_get_pic_pie(elf_ptr);
     auto &&mem = malloc_aligned<char>(static_cast<std::size_t>(tsz));
 
+    // Note:
+    //
+    // Only the EPT is populated lazily, meaning the hypervisor only looks
+    // up (and maps) a page of a segment the first time the VM app touches
+    // it. The image itself is still loaded up front: every segment is
+    // copied here, and relocated by bfelf_loader_add, as the relocations
+    // can touch any segment. Since the lookup happens long after this
+    // function returns, the memory must not be paged out in the meantime.
+    //
+    // FUTURE:
+    //
+    // Deferring the copy (and relocation) until first touch would need a
+    // way for the VMM to call back into bfexec, which does not exist yet.
+    //
+
+    if (mlock(mem, static_cast<std::size_t>(tsz)) != 0)
+        throw std::runtime_error("mlock failed");
+
     for (auto i = 0; i < bfelf_file_get_num_load_instrs(elf_ptr); i++)
     {
         struct bfelf_load_instr *instr = nullptr;
@@ -241,16 +369,14 @@ process::load_elf(const std::string &filename)
         auto &&addr_int = reinterpret_cast<uintptr_t>(&mem_view.at(instr->mem_offset));
         auto &&perm_int = instr->perm;
 
-        auto result = vmcall__vm_map_foreign_lookup(
-                          m_procltid,
-                          m_id,
-                          virt_int,
-                          addr_int,
-                          instr->memsz,
-                          perm_int);
-
-        if (!result)
-            throw std::runtime_error("vmcall__vm_map_foreign_lookup failed");
+        queue(BATCH_OP_VM_MAP_LAZY, {
+            m_procltid,
+            m_id,
+            virt_int,
+            addr_int,
+            instr->memsz,
+            perm_int
+        });
     }
 
     auto &&virt = pic == 1 ? reinterpret_cast<char *>(m_virt_addr) : nullptr;
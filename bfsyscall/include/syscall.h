@@ -30,6 +30,12 @@ extern "C" {
 int
 set_program_break(uint64_t program_break);
 
+void
+set_stdio_rings(uint64_t stdout_ring, uint64_t stderr_ring);
+
+int
+enable_syscall_page(void);
+
 #ifdef __cplusplus
 }
 #endif
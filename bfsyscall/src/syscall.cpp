@@ -57,6 +57,8 @@
 #include <constants.h>
 #include <eh_frame_list.h>
 
+#include <stdio_ring.h>
+#include <syscall_page.h>
 #include <vmcall_hyperkernel_interface.h>
 
 #define UNHANDLED() \
@@ -270,11 +272,21 @@ link(const char *oldpath, const char *newpath)
     return -1;
 }
 
+static void syscall_flush();
+extern bool g_syscall_page_enabled;
+
 extern "C" void
 _exit(int status)
 {
     (void) status;
 
+    // Writes that were posted to the syscall page may still be waiting for
+    // the console's queue to drain, and would be lost once the process is
+    // removed.
+
+    if (g_syscall_page_enabled)
+        syscall_flush();
+
     vmcall__sched_yield_and_remove();
     while (1);
 }
@@ -431,24 +443,192 @@ extern "C" void
 __gxx_personality_v0(void)
 { }
 
+// Note:
+//
+// Once a VM app calls enable_syscall_page, requests that do not need an
+// answer right away (writes to the console) are posted to the syscall
+// page instead of making a vmcall, and requests that need several
+// vmcalls (growing the program break by more than a page) are posted as
+// one request and flushed with a single yield. Writes are copied into a
+// per entry buffer first, as the caller is free to reuse its buffer as
+// soon as write returns (an entry's buffer is only reused once the VMM
+// is done with the entry).
+//
+
+constexpr const auto syscall_write_size = 0x200UL;
+
+alignas(0x1000) syscall_page_t g_syscall_page = {};
+char g_syscall_write_buffers[SYSCALL_PAGE_ENTRIES][syscall_write_size] = {};
+
+bool g_syscall_page_enabled = false;
+
 extern "C" int
-write(int file, const void *buffer, size_t count)
+enable_syscall_page(void)
 {
-    (void) file;
+    if (!vmcall__set_syscall_page(reinterpret_cast<uintptr_t>(&g_syscall_page)))
+        return -1;
+
+    g_syscall_page_enabled = true;
+    return 0;
+}
+
+static void
+syscall_flush()
+{
+    // A yield processes everything that this thread has submitted, so
+    // this only loops if the VMM could not take the yield, or a write is
+    // waiting for the console's queue to drain.
+
+    while (__atomic_load_n(&g_syscall_page.completed, __ATOMIC_ACQUIRE) != g_syscall_page.submitted)
+        vmcall__sched_yield();
+}
+
+static uint64_t
+syscall_next()
+{
+    auto index = g_syscall_page.submitted % SYSCALL_PAGE_ENTRIES;
+
+    // The ring is full, so give the VMM a chance to catch up.
+
+    while (__atomic_load_n(&g_syscall_page.entries[index].status, __ATOMIC_ACQUIRE) == SYSCALL_STATUS_SUBMITTED)
+        vmcall__sched_yield();
+
+    return index;
+}
+
+static syscall_entry_t *
+syscall_submit(uint64_t index, uint64_t op, uint64_t arg0, uint64_t arg1)
+{
+    auto entry = &g_syscall_page.entries[index];
+
+    entry->op = op;
+    entry->args[0] = arg0;
+    entry->args[1] = arg1;
+    entry->ret = SYSCALL_RET_FAILURE;
+
+    __atomic_store_n(&entry->status, SYSCALL_STATUS_SUBMITTED, __ATOMIC_RELEASE);
+    g_syscall_page.submitted++;
+
+    return entry;
+}
+
+static size_t
+syscall_write(const char *buf, size_t count)
+{
+    auto index = syscall_next();
+    auto data = g_syscall_write_buffers[index];
+
+    memcpy(data, buf, count);
+    syscall_submit(index, SYSCALL_OP_WRITE, reinterpret_cast<uintptr_t>(data), count);
+
+    return count;
+}
+
+stdio_ring_t *g_stdout_ring = nullptr;
+stdio_ring_t *g_stderr_ring = nullptr;
+
+extern "C" void
+set_stdio_rings(uint64_t stdout_ring, uint64_t stderr_ring)
+{
+    g_stdout_ring = reinterpret_cast<stdio_ring_t *>(stdout_ring);
+    g_stderr_ring = reinterpret_cast<stdio_ring_t *>(stderr_ring);
+}
+
+static size_t
+write_ring(stdio_ring_t *ring, const char *buf, size_t count)
+{
+    auto written = 0UL;
+    auto head = ring->head;
+
+    auto was_below = head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) < STDIO_RING_WATERMARK;
+
+    while (written < count)
+    {
+        auto tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        auto space = STDIO_RING_SIZE - (head - tail);
+
+        // The ring is full, so ring the doorbell (give the core up, so
+        // that bfexec can drain the ring), and try again.
+
+        if (space == 0)
+        {
+            vmcall__sched_yield();
+            continue;
+        }
+
+        auto offset = head % STDIO_RING_SIZE;
+        auto num = count - written;
+
+        if (num > space)
+            num = space;
+
+        if (num > STDIO_RING_SIZE - offset)
+            num = STDIO_RING_SIZE - offset;
 
+        memcpy(&ring->data[offset], buf + written, num);
+
+        head += num;
+        written += num;
+
+        __atomic_store_n(&ring->head, head, __ATOMIC_RELEASE);
+    }
+
+    if (was_below && head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= STDIO_RING_WATERMARK)
+        vmcall__sched_yield();
+
+    return written;
+}
+
+extern "C" int
+write(int file, const void *buffer, size_t count)
+{
     if (buffer == nullptr || count == 0)
         return 0;
 
-    try
+    auto &&buf = static_cast<const char *>(buffer);
+
+    // Note:
+    //
+    // If bfexec gave the VM app rings for its output, writing to stdout
+    // and stderr is just a copy into the ring. Everything else goes to
+    // the VMM (the console, or the ttys0 driver).
+    //
+
+    if (file == STDOUT_FILENO && g_stdout_ring != nullptr)
+        return static_cast<int>(write_ring(g_stdout_ring, buf, count));
+
+    if (file == STDERR_FILENO && g_stderr_ring != nullptr)
+        return static_cast<int>(write_ring(g_stderr_ring, buf, count));
+
+    if (g_syscall_page_enabled)
     {
-        for (auto i = 0UL; i < count; i++)
-            vmcall__ttys0(static_cast<const char *>(buffer)[i]);
+        if (count <= syscall_write_size)
+            return static_cast<int>(syscall_write(buf, count));
 
-        return static_cast<int>(count);
+        // Anything that was posted has to reach the VMM before this
+        // write does.
+
+        syscall_flush();
     }
-    catch (...) { }
 
-    return 0;
+    auto written = 0UL;
+
+    while (written < count)
+    {
+        auto &&num = vmcall__write(buf + written, count - written);
+
+        if (num == REG_INVALID)
+            break;
+
+        // The driver's queue is full, so give it a chance to drain it.
+
+        if (num == 0)
+            vmcall__sched_yield();
+
+        written += num;
+    }
+
+    return static_cast<int>(written);
 }
 
 extern "C" int
@@ -491,6 +671,17 @@ sbrk(ptrdiff_t inc)
 {
     g_program_cursor += static_cast<uintptr_t>(inc);
 
+    if (g_syscall_page_enabled && g_program_break < g_program_cursor)
+    {
+        auto num = (g_program_cursor - g_program_break + 0xFFF) >> 12;
+        auto entry = syscall_submit(syscall_next(), SYSCALL_OP_INCREASE_PROGRAM_BREAK, num, 0);
+
+        syscall_flush();
+
+        if (entry->ret != SYSCALL_RET_FAILURE)
+            g_program_break += entry->ret << 12;
+    }
+
     while (g_program_break < g_program_cursor)
     {
         if (!vmcall__increase_program_break())
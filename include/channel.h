@@ -0,0 +1,202 @@
+//
+// Bareflank Hyperkernel
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+
+#ifndef CHANNEL_H
+#define CHANNEL_H
+
+#include <stdint.h>
+
+#pragma pack(push, 1)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Channel
+///
+/// A bounded, multiple producer / single consumer queue of 64bit messages
+/// that lives in a shared memory region (see vmcall__create_shm), so any
+/// number of VM apps, in any process list, can map it and send messages
+/// to its receiver without exiting.
+///
+/// The receiver maps the region, and binds it (vmcall__bind_channel),
+/// which makes the calling thread the one that is notified, until the
+/// receiver unmaps the region. It drains the channel with channel_recv.
+/// Once it runs dry, it calls channel_prepare_wait, and if the channel is
+/// still empty, blocks with vmcall__hlt_process. A producer sends any number of messages with
+/// channel_send, and then calls channel_needs_notify once for the whole
+/// batch. Only if that returns true (i.e. the receiver is, or is about
+/// to be, blocked), does the producer call vmcall__notify_channel, so a
+/// busy receiver costs its producers no exits at all.
+///
+/// The queue is the usual sequence numbered ring (one sequence number per
+/// slot). The sequence numbers are stored relative to the slot's index,
+/// so a freshly created (zeroed) region is an empty channel, and no one
+/// has to initialize it before the producers start.
+///
+#define CHANNEL_SLOTS 0x1000UL
+#define CHANNEL_MASK (CHANNEL_SLOTS - 1)
+
+struct channel_slot_t
+{
+    uint64_t seq;
+    uint64_t msg;
+};
+
+struct channel_t
+{
+    uint64_t head;
+    uint64_t reserved1[7];
+
+    uint64_t tail;
+    uint64_t reserved2[7];
+
+    uint64_t waiting;
+    uint64_t reserved3[7];
+
+    struct channel_slot_t slots[CHANNEL_SLOTS];
+};
+
+/// Channel Send
+///
+/// @param ch the channel
+/// @param msg the message to send
+/// @return 1 if the message was queued, 0 if the channel is full
+///
+static inline int
+channel_send(struct channel_t *ch, uint64_t msg)
+{
+    struct channel_slot_t *slot;
+    uint64_t pos = __atomic_load_n(&ch->tail, __ATOMIC_RELAXED);
+
+    for (;;)
+    {
+        slot = &ch->slots[pos & CHANNEL_MASK];
+
+        uint64_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) + (pos & CHANNEL_MASK);
+        int64_t diff = (int64_t)(seq - pos);
+
+        if (diff == 0)
+        {
+            if (__atomic_compare_exchange_n(&ch->tail, &pos, pos + 1, 1,
+                                            __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            return 0;
+        }
+        else
+        {
+            pos = __atomic_load_n(&ch->tail, __ATOMIC_RELAXED);
+        }
+    }
+
+    slot->msg = msg;
+    __atomic_store_n(&slot->seq, pos + 1 - (pos & CHANNEL_MASK), __ATOMIC_RELEASE);
+
+    return 1;
+}
+
+/// Channel Receive
+///
+/// Must only be called by the receiver.
+///
+/// @param ch the channel
+/// @param msg where to store the message
+/// @return 1 if a message was received, 0 if the channel is empty
+///
+static inline int
+channel_recv(struct channel_t *ch, uint64_t *msg)
+{
+    uint64_t pos = ch->head;
+    struct channel_slot_t *slot = &ch->slots[pos & CHANNEL_MASK];
+
+    uint64_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) + (pos & CHANNEL_MASK);
+
+    if (seq != pos + 1)
+        return 0;
+
+    *msg = slot->msg;
+
+    __atomic_store_n(&slot->seq, pos + CHANNEL_SLOTS - (pos & CHANNEL_MASK), __ATOMIC_RELEASE);
+    __atomic_store_n(&ch->head, pos + 1, __ATOMIC_RELAXED);
+
+    return 1;
+}
+
+/// Channel Prepare Wait
+///
+/// Tells producers that the receiver is about to block. Must only be
+/// called by the receiver, once channel_recv has returned 0.
+///
+/// @param ch the channel
+/// @return 1 if the channel is still empty, and the receiver should
+///     block, 0 if a message arrived in the meantime
+///
+static inline int
+channel_prepare_wait(struct channel_t *ch)
+{
+    uint64_t pos = ch->head;
+    struct channel_slot_t *slot = &ch->slots[pos & CHANNEL_MASK];
+
+    __atomic_store_n(&ch->waiting, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) + (pos & CHANNEL_MASK) == pos + 1)
+    {
+        __atomic_store_n(&ch->waiting, 0, __ATOMIC_RELAXED);
+        return 0;
+    }
+
+    return 1;
+}
+
+/// Channel Needs Notify
+///
+/// Must be called by a producer after sending a batch of messages.
+///
+/// @param ch the channel
+/// @return 1 if the receiver is blocked (or about to be), and the
+///     producer must call vmcall__notify_channel, 0 otherwise. Only one
+///     of the producers that race here is told to notify.
+///
+static inline int
+channel_needs_notify(struct channel_t *ch)
+{
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&ch->waiting, __ATOMIC_RELAXED) == 0)
+        return 0;
+
+    return __atomic_exchange_n(&ch->waiting, 0, __ATOMIC_RELAXED) != 0;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#pragma pack(pop)
+
+#endif
@@ -38,6 +38,9 @@ struct crt_info
 
     uintptr_t program_break;
 
+    uintptr_t stdout_ring;
+    uintptr_t stderr_ring;
+
     int info_num;
     struct section_info_t info[MAX_NUM_MODULES];
 };
@@ -30,6 +30,7 @@
 
 #include <domainid.h>
 #include <user_data.h>
+#include <memory_account.h>
 
 class domain : public user_data
 {
@@ -91,17 +92,113 @@ public:
     virtual bool is_initialized()
     { return m_is_initialized; }
 
+    /// Set Quotas
+    ///
+    /// Limits the resources that this domain can consume. A quota of 0
+    /// means unlimited. Lowering a quota below what the domain is already
+    /// using does not take anything away, it only prevents the domain
+    /// from acquiring more.
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param max_process_lists the max number of process lists
+    /// @param max_vcpus the max number of vCPUs
+    /// @param max_memory the max number of bytes of VMM memory (i.e. the
+    ///     hard limit of the domain's memory account)
+    ///
+    virtual void set_quotas(
+        std::size_t max_process_lists,
+        std::size_t max_vcpus,
+        memory_account::size_type max_memory);
+
+    /// Acquire Process List
+    ///
+    /// Called for each process list that is created in this domain (see
+    /// domain_manager::acquire_domain).
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @throws if the domain's process list quota has been reached
+    ///
+    virtual void acquire_process_list();
+
+    /// Release Process List
+    ///
+    /// @expects num_process_lists() != 0
+    /// @ensures none
+    ///
+    virtual void release_process_list();
+
+    /// Acquire vCPU
+    ///
+    /// Called each time a vCPU is added to a process list in this domain.
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @throws if the domain's vCPU quota has been reached
+    ///
+    virtual void acquire_vcpu();
+
+    /// Release vCPU
+    ///
+    /// @expects num_vcpus() != 0
+    /// @ensures none
+    ///
+    virtual void release_vcpu();
+
+    /// Number of Process Lists
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @return the number of process lists that belong to this domain
+    ///
+    virtual std::size_t num_process_lists() const;
+
+    /// Number of vCPUs
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @return the number of vCPUs that belong to this domain
+    ///
+    virtual std::size_t num_vcpus() const;
+
+    /// Memory Account
+    ///
+    /// The parent of the memory account of every process list in this
+    /// domain.
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @return the domain's memory account
+    ///
+    virtual memory_account &account()
+    { return m_account; }
+
 private:
 
     domainid::type m_id;
     bool m_is_initialized;
 
+    mutable std::mutex m_quota_mutex;
+    std::size_t m_max_process_lists;
+    std::size_t m_max_vcpus;
+    std::size_t m_num_process_lists;
+    std::size_t m_num_vcpus;
+
+    memory_account m_account;
+
 public:
 
     friend class hyperkernel_ut;
 
-    domain(domain &&) = default;
-    domain &operator=(domain &&) = default;
+    domain(domain &&) = delete;
+    domain &operator=(domain &&) = delete;
 
     domain(const domain &) = delete;
     domain &operator=(const domain &) = delete;
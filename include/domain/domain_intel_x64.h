@@ -74,11 +74,25 @@ public:
     ///
     void fini(user_data *data = nullptr) override;
 
-    virtual integer_pointer cr3() const
-    { return m_root_pt->cr3(); }
+    /// CR3
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @return the cr3 of the guest page tables. The page tables are shared
+    ///     by all domains
+    ///
+    virtual integer_pointer cr3() const;
 
-    virtual memory_descriptor_list &cr3_mdl()
-    { return m_cr3_mdl; }
+    /// CR3 Memory Descriptor List
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @return the list of pages that make up the (shared) guest page
+    ///     tables
+    ///
+    virtual memory_descriptor_list &cr3_mdl();
 
     virtual integer_pointer tss_base_phys() const
     { return m_tss_base_phys; }
@@ -98,12 +112,54 @@ public:
     virtual integer_pointer idt_base_virt() const
     { return m_idt_base_virt; }
 
+    virtual integer_pointer exception_stub_base_phys() const
+    { return m_exception_stub_base_phys; }
+
+    virtual integer_pointer exception_stub_base_virt() const
+    { return m_exception_stub_base_virt; }
+
+    /// Exception Info Virtual Address
+    ///
+    /// The exception stub reads the handler that the VM app registered from
+    /// this address. The page is private to each process (i.e. it is mapped
+    /// by the process's EPT when the handler is registered).
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @return the virtual address of the process's exception info page
+    ///
+    virtual integer_pointer exception_info_virt() const
+    { return 0x0000000100005000UL; }
+
+    /// Exception Stack Virtual Address
+    ///
+    /// The exception stub runs on IST1, which points to the top of this
+    /// stack. Like the exception info page, the stack is private to each
+    /// process.
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @return the virtual address of the bottom of the exception stack
+    ///
+    virtual integer_pointer exception_stack_virt() const
+    { return 0x0000000100006000UL; }
+
+    virtual std::size_t exception_stack_size() const
+    { return 0x2000UL; }
+
     virtual gsl::not_null<gdt_x64 *> gdt()
     { return &m_vmapp_gdt; }
 
     virtual gsl::not_null<idt_x64 *> idt()
     { return &m_vmapp_idt; }
 
+private:
+
+    void init_exception_stub();
+    void init_idt();
+
 private:
 
     gdt_x64 m_vmapp_gdt;
@@ -118,8 +174,9 @@ private:
     gdt_x64::integer_pointer m_gdt_base_virt;
     idt_x64::integer_pointer m_idt_base_virt;
 
-    memory_descriptor_list m_cr3_mdl;
-    std::unique_ptr<root_page_table_x64> m_root_pt;
+    std::unique_ptr<char[]> m_exception_stub;
+    integer_pointer m_exception_stub_base_phys;
+    integer_pointer m_exception_stub_base_virt;
 
 public:
 
@@ -23,6 +23,8 @@
 #define DOMAIN_MANAGER_H
 
 #include <map>
+#include <list>
+#include <mutex>
 #include <memory>
 
 #include <domainid.h>
@@ -82,9 +84,80 @@ public:
     ///
     virtual gsl::not_null<domain *> get_domain(domainid::type domainid);
 
+    /// Acquire Domain
+    ///
+    /// Looks up the domain and acquires a process list from it (see
+    /// domain::acquire_process_list) while holding the same lock that
+    /// delete_domain holds, so the domain cannot be deleted between the
+    /// lookup and the acquire. The process list that is created with the
+    /// returned domain takes over this reference, and gives it back when
+    /// it is destroyed.
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param domainid the id of the domain to acquire
+    /// @return returns the domain associated with the provided id
+    ///
+    /// @throws if the domain does not exist, or if its process list quota
+    ///     has been reached
+    ///
+    virtual gsl::not_null<domain *> acquire_domain(domainid::type domainid);
+
+    /// Set Domain Pool Size
+    ///
+    /// The domain manager keeps a pool of domains that are already
+    /// initialized, so that create_domain only has to hand one out.
+    /// This sets how many domains the pool should hold. If the pool
+    /// holds more than this, the extra domains are deleted. The pool is
+    /// not filled until refill_domain_pool is called.
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param size the number of domains the pool should hold
+    ///
+    virtual void set_domain_pool_size(std::size_t size);
+
+    /// Refill Domain Pool
+    ///
+    /// Initializes domains until the pool is full, or until max domains
+    /// have been added. This should be called when the VMM is not
+    /// servicing a request (e.g. when a thread yields) so that the cost
+    /// of initializing a domain is not seen by create_domain.
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param max the max number of domains to add
+    /// @return the number of domains that were added to the pool
+    ///
+    virtual std::size_t refill_domain_pool(std::size_t max = ~0UL);
+
+    /// Domain Pool Size
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @return the number of domains the pool should hold
+    ///
+    virtual std::size_t domain_pool_size() const;
+
+    /// Pooled Domains
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @return the number of domains the pool currently holds
+    ///
+    virtual std::size_t pooled_domains() const;
+
 private:
 
     domain_manager() noexcept;
+    domainid::type __next_domainid();
+    std::unique_ptr<domain> __make_domain(user_data *data);
+    std::unique_ptr<domain> __acquire_pooled_domain();
     std::unique_ptr<domain> &__add_domain(domainid::type domainid, user_data *data);
     std::unique_ptr<domain> &__get_domain(domainid::type domainid);
 
@@ -94,6 +167,10 @@ private:
     domainid::type m_domian_next_id;
     std::map<domainid::type, std::unique_ptr<domain>> m_domains;
 
+    mutable std::mutex m_pool_mutex;
+    std::size_t m_pool_size;
+    std::list<std::unique_ptr<domain>> m_pool;
+
 private:
 
     std::unique_ptr<domain_factory> m_domain_factory;
@@ -0,0 +1,202 @@
+//
+// Bareflank Hyperkernel
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#ifndef DRIVER_MANAGER_H
+#define DRIVER_MANAGER_H
+
+#include <map>
+#include <deque>
+#include <mutex>
+
+#include <gsl/gsl>
+
+#include <deviceid.h>
+#include <driver_data_intel_x64.h>
+
+class process;
+class process_list;
+
+/// Driver Manager
+///
+/// Keeps track of the VM apps that serve a device (i.e. the drivers). Each
+/// driver has a queue of requests (bytes written to the device). Writing to
+/// a device only queues the data, and posts the device's event to the
+/// driver's thread (see thread_intel_x64::post_device_events), which is
+/// given the bitmap of the devices with pending requests (bit n is device
+/// n) as its event handler's second argument, and drains them with read. Since events are coalesced, a burst of writes
+/// is handed to the driver as a single batch.
+///
+class driver_manager
+{
+public:
+
+    using size_type = std::size_t;
+
+    /// The most data that can be queued for a driver. Once the queue is
+    /// full, writes fail until the driver catches up.
+    ///
+    constexpr static const size_type max_queue_size = 0x10000;
+
+    /// Destructor
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    virtual ~driver_manager() = default;
+
+    /// Get Singleton Instance
+    ///
+    /// @expects none
+    /// @ensures ret != nullptr
+    ///
+    /// Get an instance to the singleton class.
+    ///
+    static driver_manager *instance() noexcept;
+
+    /// Register Driver
+    ///
+    /// Registers dd->m_thread as the driver of the device. The thread's
+    /// event handler is set to dd->m_entry, and its process is detached
+    /// from its process list (see process_list::detach_process), so that
+    /// an idle driver does not keep its host process waiting.
+    ///
+    /// @expects deviceid < deviceid::max
+    /// @expects dd->m_thread != nullptr
+    /// @expects dd->m_proclt != nullptr
+    /// @ensures is_registered(deviceid)
+    ///
+    /// @param deviceid the device to register a driver for
+    /// @param dd the driver's entry point, thread and process list
+    ///
+    virtual void register_driver(deviceid::type deviceid, gsl::not_null<driver_data_intel_x64 *> dd);
+
+    /// Unregister Driver
+    ///
+    /// Requests that were not read yet are dropped.
+    ///
+    /// @expects none
+    /// @ensures !is_registered(deviceid)
+    ///
+    /// @param deviceid the device to unregister
+    ///
+    virtual void unregister_driver(deviceid::type deviceid);
+
+    /// Unregister Process
+    ///
+    /// Unregisters every driver served by the process. Must be called
+    /// before the process is deleted.
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param proc the process that is being deleted
+    ///
+    virtual void unregister_process(gsl::not_null<process *> proc);
+
+    /// Unregister Process List
+    ///
+    /// Unregisters every driver served by a process in the process list.
+    /// Must be called before the process list is deleted.
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param proclt the process list that is being deleted
+    ///
+    virtual void unregister_process_list(gsl::not_null<process_list *> proclt);
+
+    /// Is Registered
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param deviceid the device to check
+    /// @return true if a driver is registered for the device
+    ///
+    virtual bool is_registered(deviceid::type deviceid) const;
+
+    /// Write
+    ///
+    /// Queues data for the device's driver, and if the driver's queue was
+    /// empty, posts the device's event to it, waking it if it is parked.
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param deviceid the device to write to
+    /// @param data the data to write
+    /// @return true if the data was queued, false if the queue is full
+    ///
+    virtual bool write(deviceid::type deviceid, gsl::span<const char> data);
+
+    /// Read
+    ///
+    /// Takes queued data off of the device's queue.
+    ///
+    /// @expects none
+    /// @ensures ret <= data.size()
+    ///
+    /// @param deviceid the device to read from
+    /// @param data where to store the data
+    /// @return the number of bytes read
+    ///
+    virtual size_type read(deviceid::type deviceid, gsl::span<char> data);
+
+private:
+
+    driver_manager() noexcept = default;
+
+    struct driver_t
+    {
+        driver_data_intel_x64 m_data;
+        std::deque<char> m_requests;
+    };
+
+    driver_t &__get_driver(deviceid::type deviceid);
+
+private:
+
+    mutable std::mutex m_driver_mutex;
+    std::map<deviceid::type, driver_t> m_drivers;
+
+public:
+
+    friend class hyperkernel_ut;
+
+    driver_manager(driver_manager &&) = delete;
+    driver_manager &operator=(driver_manager &&) = delete;
+
+    driver_manager(const driver_manager &) = delete;
+    driver_manager &operator=(const driver_manager &) = delete;
+};
+
+/// Driver Manager Macro
+///
+/// The following macro can be used to quickly call the driver manager as
+/// this class will likely be called by a lot of code. This call is
+/// guaranteed to not be NULL
+///
+/// @expects none
+/// @ensures ret != nullptr
+///
+#define g_drm driver_manager::instance()
+
+#endif
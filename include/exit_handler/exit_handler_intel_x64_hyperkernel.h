@@ -24,19 +24,24 @@
 
 #include <gsl/gsl>
 
+#include <memory>
+
 #include <coreid.h>
 #include <vcpuid.h>
 #include <domainid.h>
-#include <driver_data_intel_x64.h>
 
 #include <vmcs/vmcs_intel_x64_hyperkernel.h>
 #include <exit_handler/exit_handler_intel_x64_eapis.h>
 
 class process_list;
+class memory_account;
 class domain_intel_x64;
 class thread_intel_x64;
 class process_intel_x64;
 
+struct batch_op_t;
+struct syscall_entry_t;
+
 class exit_handler_intel_x64_hyperkernel : public exit_handler_intel_x64_eapis
 {
 public:
@@ -109,27 +114,123 @@ public:
     virtual void set_current_thread(thread_intel_x64 *thrd)
     { m_thread = thrd; }
 
+    /// Set Field Cache
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param cache the shadow of the hot fields of this exit handler's
+    ///     vmcs (see vmcs_intel_x64_hyperkernel::field_cache)
+    ///
+    virtual void set_field_cache(gsl::not_null<vmcs_intel_x64_field_cache *> cache)
+    { m_field_cache = cache; }
+
+    /// Set Exit Statistics
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param stats the exit statistics of this exit handler's vCPU (see
+    ///     vmcs_intel_x64_hyperkernel::exit_stats)
+    ///
+    virtual void set_exit_stats(gsl::not_null<vmcs_intel_x64_exit_stats *> stats)
+    { m_exit_stats = stats; }
+
+    /// Rebind
+    ///
+    /// Moves this exit handler to another process list / domain (see
+    /// vcpu_intel_x64_hyperkernel::rebind). The current thread, which
+    /// belongs to the old process list, is dropped.
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param proclt the new process list
+    /// @param domain the new domain
+    /// @param vcpuid the vCPU's new id
+    ///
+    virtual void rebind(
+        gsl::not_null<process_list *> proclt,
+        gsl::not_null<domain_intel_x64 *> domain,
+        vcpuid::type vcpuid)
+    {
+        m_vcpuid = vcpuid;
+        m_proclt = proclt;
+        m_domain = domain;
+
+        m_thread = nullptr;
+    }
+
 protected:
 
     void handle_exit(intel_x64::vmcs::value_type reason) override;
     void handle_vmcall_registers(vmcall_registers_t &regs) override;
 
+    void handle_ept_violation();
+    void handle_exception();
+    void handle_cr_access();
+    void handle_hlt();
+    void handle_guest_failure();
+    void inject_page_fault(uintptr_t gpa);
+    void switch_extended_state();
+
     void create_process_list(vmcall_registers_t &regs);
     void delete_process_list(vmcall_registers_t &regs);
 
     void create_vcpu(vmcall_registers_t &regs);
     void delete_vcpu(vmcall_registers_t &regs);
+    void set_vcpu_pool_size(vmcall_registers_t &regs);
 
     void create_process(vmcall_registers_t &regs);
     void delete_process(vmcall_registers_t &regs);
+    void run_process(vmcall_registers_t &regs);
+    void hlt_process(vmcall_registers_t &regs);
 
     void vm_map(vmcall_registers_t &regs);
     void vm_map_lookup(vmcall_registers_t &regs);
+    void vm_map_lazy(vmcall_registers_t &regs);
 
     void set_thread_info(vmcall_registers_t &regs);
+    void batch(vmcall_registers_t &regs);
+
+    void create_shm(vmcall_registers_t &regs);
+    void map_shm(vmcall_registers_t &regs);
+    void unmap_shm(vmcall_registers_t &regs);
+    void destroy_shm(vmcall_registers_t &regs);
+
+    void get_memory_usage(vmcall_registers_t &regs);
+    void set_memory_limits(vmcall_registers_t &regs);
+
+    void set_numa_node(vmcall_registers_t &regs);
+    void add_numa_frames(vmcall_registers_t &regs);
+    void set_numa_policy(vmcall_registers_t &regs);
+    void get_numa_stats(vmcall_registers_t &regs);
+
+    void set_exception_handler(vmcall_registers_t &regs);
+
+    void set_event_handler(vmcall_registers_t &regs);
+    void inject_event(vmcall_registers_t &regs);
+    void event_return(vmcall_registers_t &regs);
+
+    void ipc_call(vmcall_registers_t &regs);
+    void ipc_reply_wait(vmcall_registers_t &regs);
+
+    void bind_channel(vmcall_registers_t &regs);
+    void notify_channel(vmcall_registers_t &regs);
+
+    void set_domain_pool_size(vmcall_registers_t &regs);
+    void create_domain(vmcall_registers_t &regs);
+    void delete_domain(vmcall_registers_t &regs);
+
+    void get_vmcs_stats(vmcall_registers_t &regs);
+    void get_vmcall_count(vmcall_registers_t &regs);
+    void get_vmcall_histogram(vmcall_registers_t &regs);
+    void get_exit_count(vmcall_registers_t &regs);
+    void get_exit_histogram(vmcall_registers_t &regs);
 
     void sched_yield(vmcall_registers_t &regs);
     void sched_yield_and_remove(vmcall_registers_t &regs);
+    void sched_num_jobs(vmcall_registers_t &regs);
 
     void set_program_break(vmcall_registers_t &regs);
     void increase_program_break(vmcall_registers_t &regs);
@@ -137,7 +238,33 @@ protected:
 
     void handle_ttys0(vmcall_registers_t &regs);
     void handle_ttys1(vmcall_registers_t &regs);
-    void register_ttys0(vmcall_registers_t &regs);
+    void handle_write(vmcall_registers_t &regs);
+    void handle_write_ttys1(vmcall_registers_t &regs);
+
+    void set_syscall_page(vmcall_registers_t &regs);
+
+    void register_driver(vmcall_registers_t &regs);
+    void unregister_driver(vmcall_registers_t &regs);
+    void read_driver(vmcall_registers_t &regs);
+
+private:
+
+    static void register_vmcalls();
+
+    process_intel_x64 *get_process(uint64_t procltid, uint64_t processid);
+    thread_intel_x64 *get_thread(process_intel_x64 *proc, uint64_t threadid);
+    memory_account &get_account(uint64_t procltid, uint64_t processid);
+
+    bool run_batch_op(batch_op_t &op);
+    void copy_caller_memory(uintptr_t virt, gsl::span<char> buffer, bool to_caller);
+
+    uint64_t write_guest(process_intel_x64 *proc, uintptr_t gva, uint64_t size, bool bypass_driver = false);
+
+    uint64_t process_syscall(thread_intel_x64 *thrd, const syscall_entry_t &entry);
+    void process_syscalls();
+
+    void save_thread_state();
+    uint64_t guest_gpr(uint64_t index);
 
 private:
 
@@ -147,8 +274,10 @@ private:
     gsl::not_null<domain_intel_x64 *> m_domain;
 
     thread_intel_x64 *m_thread;
+    vmcs_intel_x64_field_cache *m_field_cache;
+    vmcs_intel_x64_exit_stats *m_exit_stats;
 
-    driver_data_intel_x64 m_ttys0;
+    std::unique_ptr<char[]> m_write_buffer;
 
 public:
 
@@ -0,0 +1,193 @@
+//
+// Bareflank Hyperkernel
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#ifndef VMCALL_DISPATCH_TABLE_H
+#define VMCALL_DISPATCH_TABLE_H
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+#include <vmcall_interface.h>
+
+class exit_handler_intel_x64_hyperkernel;
+
+/// VMCall Dispatch Table
+///
+/// Maps a vmcall index (regs.r02) to its handler. Indexes are made up of
+/// a group (bits 8 and up) and a function (bits 0-7), e.g. 0x302 is
+/// function 2 of group 3, and the table is a dense array indexed by both,
+/// so a lookup is a bounds check and a load.
+///
+/// Handlers are registered at init (the hyperkernel's own vmcalls are
+/// registered when the first exit handler is created), which means an
+/// extension can add vmcalls of its own, or replace the hyperkernel's,
+/// without touching the exit handler.
+///
+/// The table also keeps, for each vmcall, the number of times it was
+/// called and a histogram of the number of cycles the handler took (in
+/// powers of 2, i.e. bucket n counts calls that took [2^n, 2^(n+1))
+/// cycles). Handlers that do not return (e.g. sched_yield) are counted,
+/// but do not show up in the histogram.
+///
+class vmcall_dispatch_table
+{
+public:
+
+    using index_type = uint64_t;
+    using handler_type = void (*)(exit_handler_intel_x64_hyperkernel *, vmcall_registers_t &);
+
+    constexpr static const index_type num_groups = 0x40;
+    constexpr static const index_type num_functions = 0x10;
+    constexpr static const index_type num_buckets = 32;
+
+    /// Destructor
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    virtual ~vmcall_dispatch_table() = default;
+
+    /// Get Singleton Instance
+    ///
+    /// @expects none
+    /// @ensures ret != nullptr
+    ///
+    /// Get an instance to the singleton class.
+    ///
+    static vmcall_dispatch_table *instance() noexcept;
+
+    /// Register Handler
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param index the vmcall index (regs.r02) to handle
+    /// @param handler the handler to call, or nullptr to remove the
+    ///     current handler
+    /// @return false if index does not fit in the table, true otherwise
+    ///
+    virtual bool register_handler(index_type index, handler_type handler) noexcept;
+
+    /// Handler
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param index the vmcall index (regs.r02)
+    /// @return the handler for index, or nullptr if there is none
+    ///
+    virtual handler_type handler(index_type index) const noexcept
+    {
+        if (!valid(index))
+            return nullptr;
+
+        return m_entries[slot(index)].m_handler;
+    }
+
+    /// Record Call
+    ///
+    /// @expects handler(index) != nullptr
+    /// @ensures none
+    ///
+    /// @param index the vmcall index that was called
+    ///
+    virtual void record_call(index_type index) noexcept
+    { m_entries[slot(index)].m_count.fetch_add(1, std::memory_order_relaxed); }
+
+    /// Record Cycles
+    ///
+    /// @expects handler(index) != nullptr
+    /// @ensures none
+    ///
+    /// @param index the vmcall index that was called
+    /// @param cycles the number of cycles the handler took
+    ///
+    virtual void record_cycles(index_type index, uint64_t cycles) noexcept;
+
+    /// Count
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param index the vmcall index
+    /// @return the number of times index was called (0 if index is
+    ///     invalid)
+    ///
+    virtual uint64_t count(index_type index) const noexcept;
+
+    /// Histogram
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param index the vmcall index
+    /// @param bucket the histogram bucket
+    /// @return the number of calls that took [2^bucket, 2^(bucket+1))
+    ///     cycles (0 if index or bucket is invalid)
+    ///
+    virtual uint64_t histogram(index_type index, index_type bucket) const noexcept;
+
+private:
+
+    vmcall_dispatch_table() noexcept = default;
+
+    static bool valid(index_type index) noexcept
+    { return (index >> 8) < num_groups && (index & 0xFFUL) < num_functions; }
+
+    static index_type slot(index_type index) noexcept
+    { return ((index >> 8) * num_functions) + (index & 0xFFUL); }
+
+private:
+
+    struct entry
+    {
+        handler_type m_handler;
+
+        std::atomic<uint64_t> m_count;
+        std::array<std::atomic<uint64_t>, num_buckets> m_histogram;
+    };
+
+    std::array<entry, num_groups * num_functions> m_entries{};
+
+public:
+
+    friend class hyperkernel_ut;
+
+    vmcall_dispatch_table(vmcall_dispatch_table &&) = delete;
+    vmcall_dispatch_table &operator=(vmcall_dispatch_table &&) = delete;
+
+    vmcall_dispatch_table(const vmcall_dispatch_table &) = delete;
+    vmcall_dispatch_table &operator=(const vmcall_dispatch_table &) = delete;
+};
+
+/// VMCall Dispatch Table Macro
+///
+/// The following macro can be used to quickly call the vmcall dispatch
+/// table as this class will likely be called by a lot of code. This call
+/// is guaranteed to not be NULL
+///
+/// @expects none
+/// @ensures ret != nullptr
+///
+#define g_vdt vmcall_dispatch_table::instance()
+
+#endif
@@ -0,0 +1,210 @@
+//
+// Bareflank Hyperkernel
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#ifndef FRAME_ALLOCATOR_H
+#define FRAME_ALLOCATOR_H
+
+#include <map>
+#include <list>
+#include <mutex>
+#include <vector>
+
+#include <coreid.h>
+
+// *INDENT-OFF*
+
+namespace numa
+{
+    using node_type = uint64_t;
+
+    constexpr const node_type max_nodes = 8;
+
+    namespace policy
+    {
+        using type = uint64_t;
+
+        constexpr const type local = 0;
+        constexpr const type interleave = 1;
+        constexpr const type explicit_node = 2;
+    }
+}
+
+// *INDENT-ON*
+
+/// Frame Allocator
+///
+/// The VMM's heap is handed to the VMM by the driver, and carries no
+/// information about which NUMA node its memory lives on. The frame
+/// allocator keeps a free list of 4k page frames for each node, so that
+/// memory given to VM apps can be placed on the node of the core that is
+/// running them.
+///
+/// Frames are donated by the host (which knows which node they are on, for
+/// example by binding the memory with mbind() before pinning it), and
+/// which cores belong to which node is also provided by the host. Until
+/// then, every core is on node 0 and no frames are available, in which
+/// case callers fall back to the VMM's heap.
+///
+class frame_allocator
+{
+public:
+
+    using integer_pointer = uintptr_t;
+    using size_type = std::size_t;
+
+    /// Destructor
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    virtual ~frame_allocator() = default;
+
+    /// Get Singleton Instance
+    ///
+    /// @expects none
+    /// @ensures ret != nullptr
+    ///
+    /// Get an instance to the singleton class.
+    ///
+    static frame_allocator *instance() noexcept;
+
+    /// Set Core Node
+    ///
+    /// @expects node < numa::max_nodes
+    /// @ensures none
+    ///
+    /// @param coreid the core to set the node of
+    /// @param node the node the core belongs to
+    ///
+    virtual void set_core_node(coreid::type coreid, numa::node_type node);
+
+    /// Core Node
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param coreid the core to get the node of
+    /// @return the node the core belongs to (0 if unknown)
+    ///
+    virtual numa::node_type core_node(coreid::type coreid) const;
+
+    /// Add Frame
+    ///
+    /// Donates a page frame on the provided node to the allocator. The frame
+    /// belongs to the allocator from this point on, and must remain valid
+    /// (i.e. pinned by the host) for the life of the VMM.
+    ///
+    /// @expects node < numa::max_nodes
+    /// @expects phys is page aligned
+    /// @ensures none
+    ///
+    /// @param node the node the frame is located on
+    /// @param phys the physical address of the frame
+    ///
+    virtual void add_frame(numa::node_type node, integer_pointer phys);
+
+    /// Allocate
+    ///
+    /// @expects node < numa::max_nodes
+    /// @ensures none
+    ///
+    /// @param node the node to allocate the frame from
+    /// @return the physical address of a zeroed frame on node, or 0 if the
+    ///     node has no free frames
+    ///
+    virtual integer_pointer allocate(numa::node_type node);
+
+    /// Free
+    ///
+    /// @expects phys was allocated using allocate()
+    /// @ensures none
+    ///
+    /// @param phys the frame to return to its node
+    ///
+    virtual void free(integer_pointer phys);
+
+    /// Frame Node
+    ///
+    /// @expects phys was donated using add_frame()
+    /// @ensures none
+    ///
+    /// @param phys the frame to get the node of
+    /// @return the node that phys is located on
+    ///
+    virtual numa::node_type frame_node(integer_pointer phys) const;
+
+    /// Free Frames
+    ///
+    /// @expects node < numa::max_nodes
+    /// @ensures none
+    ///
+    /// @param node the node to get the number of free frames for
+    /// @return the number of free frames on node
+    ///
+    virtual size_type free_frames(numa::node_type node) const;
+
+    /// Number of Nodes
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @return one more than the highest node a core or frame has been
+    ///     assigned to
+    ///
+    virtual numa::node_type num_nodes() const
+    { return m_num_nodes; }
+
+private:
+
+    frame_allocator() noexcept;
+
+private:
+
+    mutable std::mutex m_mutex;
+
+    numa::node_type m_num_nodes;
+    std::map<coreid::type, numa::node_type> m_core_nodes;
+    std::map<integer_pointer, numa::node_type> m_frame_nodes;
+    std::vector<std::list<integer_pointer>> m_free_frames;
+
+public:
+
+    friend class hyperkernel_ut;
+
+    frame_allocator(frame_allocator &&) = delete;
+    frame_allocator &operator=(frame_allocator &&) = delete;
+
+    frame_allocator(const frame_allocator &) = delete;
+    frame_allocator &operator=(const frame_allocator &) = delete;
+};
+
+/// Frame Allocator Macro
+///
+/// The following macro can be used to quickly call the frame allocator as
+/// this class will likely be called by a lot of code. This call is
+/// guaranteed to not be NULL
+///
+/// @expects none
+/// @ensures ret != nullptr
+///
+#define g_fa frame_allocator::instance()
+
+#endif
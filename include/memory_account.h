@@ -0,0 +1,253 @@
+//
+// Bareflank Hyperkernel
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#ifndef MEMORY_ACCOUNT_H
+#define MEMORY_ACCOUNT_H
+
+#include <array>
+#include <atomic>
+#include <string>
+#include <stdexcept>
+
+#include <debug.h>
+
+// *INDENT-OFF*
+
+namespace memory_category
+{
+    using type = uint64_t;
+
+    constexpr const type program_break = 0;
+    constexpr const type ept = 1;
+    constexpr const type thread = 2;
+    constexpr const type mapped = 3;
+
+    constexpr const type num = 4;
+}
+
+// *INDENT-ON*
+
+/// Memory Account
+///
+/// Tracks how much memory an object (process, process list) is consuming,
+/// broken down by category. Accounts are chained, so that a charge against
+/// a process is also a charge against the process list that owns it. Each
+/// account may have a soft limit (a warning is printed the first time it is
+/// crossed) and a hard limit (the charge fails with an exception before any
+/// memory is allocated). A limit of 0 means unlimited.
+///
+/// Only memory that comes from the VMM's heap counts towards the limits
+/// (program break pages, EPT pages and threads). Mapped memory is memory
+/// owned by someone else (e.g. bfexec) that has been mapped into the
+/// process, and is tracked for reporting only.
+///
+class memory_account
+{
+public:
+
+    using size_type = uint64_t;
+
+    /// Default Constructor
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    memory_account() noexcept :
+        m_usage{},
+        m_limited_usage(0),
+        m_soft_limit(0),
+        m_hard_limit(0),
+        m_warned(false),
+        m_parent(nullptr)
+    { }
+
+    /// Destructor
+    ///
+    /// Whatever is still charged to this account is returned to the
+    /// parent account.
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    ~memory_account()
+    {
+        if (m_parent == nullptr)
+            return;
+
+        for (auto category = 0UL; category < memory_category::num; category++)
+            m_parent->uncharge(category, m_usage.at(category));
+    }
+
+    /// Set Parent
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param parent the account that is also charged when this account
+    ///     is charged
+    ///
+    void set_parent(memory_account *parent) noexcept
+    { m_parent = parent; }
+
+    /// Set Limits
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param soft the soft limit in bytes (0 == unlimited)
+    /// @param hard the hard limit in bytes (0 == unlimited)
+    ///
+    void set_limits(size_type soft, size_type hard) noexcept
+    {
+        m_soft_limit = soft;
+        m_hard_limit = hard;
+        m_warned = false;
+    }
+
+    /// Charge
+    ///
+    /// @expects category < memory_category::num
+    /// @ensures none
+    ///
+    /// @param category the category to charge
+    /// @param bytes the number of bytes to charge
+    ///
+    void charge(memory_category::type category, size_type bytes)
+    {
+        if (category != memory_category::mapped)
+        {
+            // Each account is charged using a CAS loop, so two concurrent
+            // charges cannot both pass the hard limit check. If an account
+            // up the chain is over its limit, the accounts that were
+            // already charged are rolled back.
+
+            for (auto acct = this; acct != nullptr; acct = acct->m_parent)
+            {
+                try
+                {
+                    acct->charge_limited(bytes);
+                }
+                catch (...)
+                {
+                    for (auto prev = this; prev != acct; prev = prev->m_parent)
+                        prev->m_limited_usage -= bytes;
+
+                    throw;
+                }
+            }
+        }
+
+        for (auto acct = this; acct != nullptr; acct = acct->m_parent)
+            acct->m_usage.at(category) += bytes;
+    }
+
+    /// Uncharge
+    ///
+    /// @expects category < memory_category::num
+    /// @ensures none
+    ///
+    /// @param category the category to uncharge
+    /// @param bytes the number of bytes to uncharge
+    ///
+    void uncharge(memory_category::type category, size_type bytes)
+    {
+        for (auto acct = this; acct != nullptr; acct = acct->m_parent)
+        {
+            acct->m_usage.at(category) -= bytes;
+
+            if (category != memory_category::mapped)
+                acct->m_limited_usage -= bytes;
+        }
+    }
+
+    /// Usage
+    ///
+    /// @expects category < memory_category::num
+    /// @ensures none
+    ///
+    /// @param category the category to get
+    /// @return the number of bytes currently charged to category
+    ///
+    size_type usage(memory_category::type category) const
+    { return m_usage.at(category); }
+
+    /// Limited Usage
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @return the number of bytes that count towards the limits
+    ///
+    size_type limited_usage() const
+    { return m_limited_usage; }
+
+    size_type soft_limit() const noexcept
+    { return m_soft_limit; }
+
+    size_type hard_limit() const noexcept
+    { return m_hard_limit; }
+
+private:
+
+    void charge_limited(size_type bytes)
+    {
+        auto usage = m_limited_usage.load();
+        auto total = usage + bytes;
+
+        do
+        {
+            total = usage + bytes;
+
+            if (m_hard_limit != 0 && total > m_hard_limit)
+                throw std::runtime_error("memory hard limit reached: " + std::to_string(m_hard_limit));
+        }
+        while (!m_limited_usage.compare_exchange_weak(usage, total));
+
+        if (m_soft_limit != 0 && total > m_soft_limit && !m_warned)
+        {
+            bfwarning << "memory soft limit reached: " << m_soft_limit << bfendl;
+            m_warned = true;
+        }
+    }
+
+private:
+
+    std::array<std::atomic<size_type>, memory_category::num> m_usage;
+    std::atomic<size_type> m_limited_usage;
+
+    size_type m_soft_limit;
+    size_type m_hard_limit;
+    bool m_warned;
+
+    memory_account *m_parent;
+
+public:
+
+    friend class hyperkernel_ut;
+
+    memory_account(memory_account &&) = delete;
+    memory_account &operator=(memory_account &&) = delete;
+
+    memory_account(const memory_account &) = delete;
+    memory_account &operator=(const memory_account &) = delete;
+};
+
+#endif
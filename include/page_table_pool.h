@@ -0,0 +1,220 @@
+//
+// Bareflank Hyperkernel
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#ifndef PAGE_TABLE_POOL_H
+#define PAGE_TABLE_POOL_H
+
+#include <mutex>
+#include <memory>
+#include <vector>
+
+/// Page Table Pool
+///
+/// Keeps a bounded number of root page tables (EPTs or guest page tables)
+/// around once their owner is done with them. A root page table allocates
+/// its table pages on demand as memory is mapped, so reusing one that has
+/// already been populated means a new process / domain does not have to go
+/// back to the VMM's heap for every table, and process / domain creation
+/// and deletion stop churning the general allocator.
+///
+/// It is up to the user of the pool to return a page table in a state that
+/// the next user expects (i.e. the EPTs of a process must have all of their
+/// private mappings removed, and the EPT invalidated, before being
+/// released). Unmapping a page clears its entry, so the table pages of a
+/// released page table only ever hold empty entries, and nothing from the
+/// previous owner is visible to the next one.
+///
+/// The pool is global rather than per core. Page tables are only acquired
+/// and released when a process / domain is created or deleted, which is
+/// far from the hot path and already takes several global locks, so the
+/// pool's lock is not contended in practice. A per core pool would also
+/// strand page tables on the core that released them, while a process can
+/// be created on any core.
+///
+template<class T>
+class page_table_pool
+{
+public:
+
+    using size_type = std::size_t;
+
+    /// Destructor
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    virtual ~page_table_pool() = default;
+
+    /// Get Singleton Instance
+    ///
+    /// @expects none
+    /// @ensures ret != nullptr
+    ///
+    /// Get an instance to the singleton class.
+    ///
+    static page_table_pool *instance() noexcept
+    {
+        static page_table_pool self;
+        return &self;
+    }
+
+    /// Try Acquire
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @return a recycled page table, or nullptr if the pool is empty
+    ///
+    std::unique_ptr<T> try_acquire()
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        if (m_pool.empty())
+        {
+            m_misses++;
+            return nullptr;
+        }
+
+        auto pt = std::move(m_pool.back());
+        m_pool.pop_back();
+
+        m_hits++;
+        return pt;
+    }
+
+    /// Acquire
+    ///
+    /// @expects none
+    /// @ensures ret != nullptr
+    ///
+    /// @return a recycled page table, or a new page table if the pool is
+    ///     empty
+    ///
+    std::unique_ptr<T> acquire()
+    {
+        if (auto &&pt = try_acquire())
+            return std::move(pt);
+
+        return std::make_unique<T>();
+    }
+
+    /// Release
+    ///
+    /// Returns a page table to the pool. If the pool is full, the page
+    /// table (and all of its table pages) are freed.
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param pt the page table to return to the pool
+    ///
+    void release(std::unique_ptr<T> pt)
+    {
+        if (!pt)
+            return;
+
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        if (m_pool.size() < m_max_size)
+            m_pool.push_back(std::move(pt));
+    }
+
+    /// Trim
+    ///
+    /// Frees page tables until at most count remain in the pool.
+    ///
+    /// @expects none
+    /// @ensures size() <= count
+    ///
+    /// @param count the number of page tables to keep
+    ///
+    void trim(size_type count = 0)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        if (m_pool.size() > count)
+            m_pool.resize(count);
+    }
+
+    /// Set Max Size
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param max_size the max number of page tables to keep in the pool
+    ///
+    void set_max_size(size_type max_size)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        m_max_size = max_size;
+
+        if (m_pool.size() > max_size)
+            m_pool.resize(max_size);
+    }
+
+    size_type size() const
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_pool.size();
+    }
+
+    size_type hits() const
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_hits;
+    }
+
+    size_type misses() const
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        return m_misses;
+    }
+
+private:
+
+    page_table_pool() noexcept :
+        m_max_size(16),
+        m_hits(0),
+        m_misses(0)
+    { }
+
+private:
+
+    mutable std::mutex m_mutex;
+    std::vector<std::unique_ptr<T>> m_pool;
+
+    size_type m_max_size;
+    size_type m_hits;
+    size_type m_misses;
+
+public:
+
+    friend class hyperkernel_ut;
+
+    page_table_pool(page_table_pool &&) = delete;
+    page_table_pool &operator=(page_table_pool &&) = delete;
+
+    page_table_pool(const page_table_pool &) = delete;
+    page_table_pool &operator=(const page_table_pool &) = delete;
+};
+
+#endif
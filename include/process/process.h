@@ -27,8 +27,12 @@
 #include <mutex>
 #include <memory>
 
+#include <coreid.h>
 #include <user_data.h>
 #include <processid.h>
+#include <memory_account.h>
+
+#include <frame_allocator/frame_allocator.h>
 
 #include <thread/thread.h>
 #include <thread/thread_factory.h>
@@ -86,6 +90,27 @@ public:
                                uintptr_t size,
                                uintptr_t perm);
 
+    virtual void vm_map_lazy(uintptr_t virt,
+                             uintptr_t rtpt,
+                             uintptr_t addr,
+                             uintptr_t size,
+                             uintptr_t perm);
+
+    /// VM Unmap
+    ///
+    /// Removes a range that was mapped using vm_map. Once this returns,
+    /// the process can no longer access the range, so the memory backing
+    /// it can be safely freed.
+    ///
+    /// @expects virt and size are page aligned
+    /// @ensures none
+    ///
+    /// @param virt the guest virtual address of the range
+    /// @param size the size of the range in bytes
+    ///
+    virtual void vm_unmap(uintptr_t virt,
+                          uintptr_t size);
+
     /// Process Id
     ///
     /// @expects none
@@ -137,6 +162,59 @@ public:
     ///
     virtual gsl::not_null<thread *> get_thread(threadid::type threadid);
 
+    /// Memory Account
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @return returns the memory account for this process
+    ///
+    virtual memory_account &account()
+    { return m_account; }
+
+    /// Set Home Core
+    ///
+    /// Records the core that this process was last scheduled on. Memory
+    /// allocated with the local NUMA policy comes from this core's node.
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param coreid the core this process is running on
+    ///
+    virtual void set_home_core(coreid::type coreid)
+    { m_home_core = coreid; }
+
+    /// Set NUMA Policy
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param policy the policy to use when allocating memory for this
+    ///     process (local, interleave or explicit node)
+    /// @param node the node to allocate from when the policy is
+    ///     numa::policy::explicit_node (ignored otherwise)
+    ///
+    virtual void set_numa_policy(numa::policy::type policy, numa::node_type node = 0);
+
+    /// NUMA Statistics
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @return the number of frames that were allocated on the node of the
+    ///     process's home core, on another node, or from the VMM's heap
+    ///     because the node had no free frames
+    ///
+    virtual uint64_t numa_local_allocs() const
+    { return m_numa_local_allocs; }
+
+    virtual uint64_t numa_remote_allocs() const
+    { return m_numa_remote_allocs; }
+
+    virtual uint64_t numa_fallback_allocs() const
+    { return m_numa_fallback_allocs; }
+
     /// Clear and Set Program Break
     ///
     /// @expects none
@@ -164,18 +242,46 @@ public:
     ///
     virtual void decrease_program_break_4k();
 
+    /// In Program Break
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param virt the guest virtual address to check
+    /// @return true if virt is backed by a page that was added by
+    ///     increase_program_break_4k (and can therefore be freed by
+    ///     decrease_program_break_4k), false otherwise
+    ///
+    virtual bool in_program_break(integer_pointer virt) const
+    { return virt < m_program_break && virt >= m_program_break - (m_pages.size() * 0x1000); }
+
 private:
 
     std::unique_ptr<thread> &__add_thread(threadid::type threadid, user_data *data);
     std::unique_ptr<thread> &__get_thread(threadid::type threadid);
 
+    numa::node_type __next_numa_node();
+    void __free_page(std::pair<std::unique_ptr<char[]>, integer_pointer> &page);
+
 private:
 
     processid::type m_id;
     bool m_is_initialized;
 
+    memory_account m_account;
+
     integer_pointer m_program_break;
-    std::list<std::unique_ptr<char[]>> m_pages;
+    std::list<std::pair<std::unique_ptr<char[]>, integer_pointer>> m_pages;
+
+    coreid::type m_home_core;
+
+    numa::policy::type m_numa_policy;
+    numa::node_type m_numa_node;
+    numa::node_type m_numa_next_node;
+
+    uint64_t m_numa_local_allocs;
+    uint64_t m_numa_remote_allocs;
+    uint64_t m_numa_fallback_allocs;
 
 private:
 
@@ -22,11 +22,17 @@
 #ifndef PROCESS_INTEL_X64_H
 #define PROCESS_INTEL_X64_H
 
+#include <map>
+#include <list>
+#include <set>
+
 #include <gsl/gsl>
 
+#include <shmid.h>
 #include <process/process.h>
 #include <vmcs/root_ept_intel_x64.h>
 
+class shared_memory;
 class domain_intel_x64;
 
 class process_intel_x64 : public process
@@ -80,17 +86,232 @@ public:
                        uintptr_t size,
                        uintptr_t perm) override;
 
+    /// VM Unmap
+    ///
+    /// Removes the range from this process's EPT and invalidates the
+    /// EPT before returning, so that the frames can be freed.
+    ///
+    /// @see process::vm_unmap
+    ///
+    void vm_unmap(uintptr_t virt,
+                  uintptr_t size) override;
+
+    /// VM Map Lazy
+    ///
+    /// Registers a range that is mapped on demand. Nothing is mapped until
+    /// the process touches a page in the range, at which point the EPT
+    /// violation is handled by vm_map_fault, which looks up the physical
+    /// address of the page (using rtpt) and maps just that page. Only the
+    /// EPT is populated lazily; the memory at addr must already hold the
+    /// page's contents.
+    ///
+    /// @expects the memory at addr remains resident for the life of the
+    ///     process
+    /// @ensures none
+    ///
+    /// @see vm_map_lookup
+    ///
+    void vm_map_lazy(uintptr_t virt,
+                     uintptr_t rtpt,
+                     uintptr_t addr,
+                     uintptr_t size,
+                     uintptr_t perm) override;
+
     void vm_map_page(uintptr_t virt,
                      uintptr_t phys,
                      uintptr_t perm);
 
+    /// VM Map Fault
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param gpa the guest physical address that caused an EPT violation
+    /// @return true if gpa is in a lazy range and is now mapped, false
+    ///     otherwise
+    ///
+    bool vm_map_fault(uintptr_t gpa);
+
+    /// VM Map Shared Memory
+    ///
+    /// Maps the page frames of a shared memory region into this process's
+    /// EPT at virt. The frames are not copied, so every process that maps
+    /// the same region sees the same memory. Shared memory is never
+    /// mapped executable.
+    ///
+    /// @expects virt is page aligned, and the region does not overlap
+    ///     another shared memory region or a lazy range
+    /// @ensures none
+    ///
+    /// @param virt the guest physical address to map the region to
+    /// @param shmid the id of the shared memory region to map
+    /// @param perm the permissions of the map (VM_PERM_R / VM_PERM_W)
+    ///
+    void vm_map_shared(uintptr_t virt,
+                       shmid::type shmid,
+                       uintptr_t perm);
+
+    /// VM Unmap Shared Memory
+    ///
+    /// @expects virt was previously mapped using vm_map_shared
+    /// @ensures none
+    ///
+    /// @param virt the guest physical address the region was mapped to
+    ///
+    void vm_unmap_shared(uintptr_t virt);
+
+    /// In Shared Map
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param virt the guest physical address to check
+    /// @return true if virt is in a region mapped using vm_map_shared
+    ///
+    bool in_shared_map(uintptr_t virt) const;
+
+    /// Maps Shared
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param shmid the shared memory region to check
+    /// @return true if this process has shmid mapped (see vm_map_shared)
+    ///
+    bool maps_shared(shmid::type shmid) const;
+
+    /// Set Exception Handler
+    ///
+    /// Registers the function that the domain's exception stub calls when
+    /// the VM app takes an exception. The first time a handler is set,
+    /// the exception info page and the exception stack are allocated and
+    /// mapped into this process's EPT.
+    ///
+    /// @expects none
+    /// @ensures has_exception_handler() == (handler != 0)
+    ///
+    /// @param handler the guest virtual address of the handler, or 0 to
+    ///     remove the handler
+    ///
+    void set_exception_handler(uintptr_t handler);
+
+    /// Has Exception Handler
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @return true if the VM app registered an exception handler
+    ///
+    bool has_exception_handler() const;
+
+    /// Set Exception Fault Address
+    ///
+    /// EPT violations are reflected to the VM app as a #PF. The faulting
+    /// address is loaded into the guest's CR2 (see
+    /// exit_handler_intel_x64_hyperkernel::inject_page_fault), and is also
+    /// passed to the handler using the exception info page.
+    ///
+    /// @expects has_exception_handler()
+    /// @ensures none
+    ///
+    /// @param gpa the guest physical address that caused the fault
+    ///
+    void set_exception_fault_addr(uintptr_t gpa);
+
+    /// Copy From Guest
+    ///
+    /// Copies memory from this process into the VMM. The VM app's page
+    /// tables are an identity map, so gva is also the guest physical
+    /// address, which is translated using this process's own record of
+    /// its EPT mappings (pages in a lazy range are faulted in). Each page
+    /// is mapped into the VMM once, so the cost is per page, not per
+    /// byte.
+    ///
+    /// @expects the range is below 4G, and mapped into this process
+    /// @ensures none
+    ///
+    /// @param gva the guest virtual address to copy from
+    /// @param buffer where to copy the memory to
+    ///
+    void copy_from_guest(uintptr_t gva, gsl::span<char> buffer);
+
+    /// Copy To Guest
+    ///
+    /// Copies memory from the VMM into this process (see copy_from_guest).
+    ///
+    /// @expects the range is below 4G, and mapped into this process
+    /// @ensures none
+    ///
+    /// @param gva the guest virtual address to copy to
+    /// @param buffer the memory to copy
+    ///
+    void copy_to_guest(uintptr_t gva, gsl::span<const char> buffer);
+
+    /// Guest To Host Physical
+    ///
+    /// @expects gva is below 4G, and mapped into this process
+    /// @ensures none
+    ///
+    /// @param gva the guest virtual address to translate (see
+    ///     copy_from_guest)
+    /// @return the host physical address of gva (pages in a lazy range
+    ///     are faulted in)
+    ///
+    uintptr_t gva_to_hpa(uintptr_t gva);
+
     auto eptp() const
     { return m_root_ept->eptp(); }
 
+    /// VPID
+    ///
+    /// Each process has its own VPID, so that its TLB entries are tagged
+    /// separately from every other process's, and a vCPU can switch
+    /// between processes without flushing the TLB.
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @return the VPID of this process
+    ///
+    auto vpid() const
+    { return m_vpid; }
+
+private:
+
+    std::set<uintptr_t> __charge_ept(uintptr_t virt, uintptr_t size);
+    void __rollback_map(uintptr_t virt, uintptr_t size, uintptr_t mapped, const std::set<uintptr_t> &tables);
+    void __map_4k(uintptr_t virt, uintptr_t phys, uintptr_t perm);
+    void __map_4k_attr(uintptr_t virt, uintptr_t phys, uint64_t attr);
+
+    bool __overlaps_shared(uintptr_t virt, uintptr_t size) const;
+    bool __overlaps_lazy(uintptr_t virt, uintptr_t size) const;
+
+    uintptr_t __gpa_to_hpa(uintptr_t gpa);
+
 private:
 
     gsl::not_null<domain_intel_x64 *> m_domain;
     std::unique_ptr<root_ept_intel_x64> m_root_ept;
+    uint16_t m_vpid;
+
+    std::map<uintptr_t, shared_memory *> m_shared_maps;
+
+    std::set<uintptr_t> m_ept_tables;
+    std::map<uintptr_t, uintptr_t> m_mapped_gpas;
+
+    struct lazy_range
+    {
+        uintptr_t virt;
+        uintptr_t rtpt;
+        uintptr_t addr;
+        uintptr_t size;
+        uintptr_t perm;
+    };
+
+    std::map<uintptr_t, lazy_range> m_lazy_ranges;
+
+    std::unique_ptr<uintptr_t[]> m_exception_info;
+    std::list<std::unique_ptr<char[]>> m_exception_stack;
 
 public:
 
@@ -33,6 +33,7 @@
 #include <vcpuid.h>
 #include <user_data.h>
 #include <processlistid.h>
+#include <memory_account.h>
 
 #include <process/process.h>
 #include <process/process_factory.h>
@@ -51,7 +52,10 @@ public:
     /// @ensures none
     ///
     /// @param id the id of the process_list
-    /// @param domain the domain the process_list belongs too
+    /// @param domain the domain the process_list belongs too. The caller
+    ///     must have acquired a process list from it (see
+    ///     domain_manager::acquire_domain), which is released when the
+    ///     process_list is destroyed
     ///
     process_list(
         processlistid::type id,
@@ -114,6 +118,19 @@ public:
     virtual bool is_initialized()
     { return m_is_initialized; }
 
+    /// Memory Account
+    ///
+    /// The memory account of a process list is charged whenever any of
+    /// its processes are charged.
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @return returns the memory account for this process list
+    ///
+    virtual memory_account &account()
+    { return m_account; }
+
     /// Add vCPU
     ///
     /// @expects none
@@ -185,6 +202,48 @@ public:
     ///
     virtual void remove_process(processid::type processid);
 
+    /// Park Process
+    ///
+    /// Takes the process off of the run list until it is woken, either by
+    /// wake_process, or once deadline passes. Unlike remove_process, the
+    /// process is still counted by num_pending_jobs.
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param processid the process to park
+    /// @param deadline the TSC value after which the process is woken, or
+    ///     0 to park the process until it is woken explicitly
+    ///
+    virtual void park_process(processid::type processid, uint64_t deadline = 0);
+
+    /// Detach Process
+    ///
+    /// A detached process is not counted by num_pending_jobs while it is
+    /// parked. This is for processes that only run on demand (e.g. drivers,
+    /// see driver_manager), which would otherwise keep the host process
+    /// that waits on this process list from ever finishing.
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param processid the process to detach
+    ///
+    virtual void detach_process(processid::type processid);
+
+    /// Wake Process
+    ///
+    /// Puts a parked process back on the run list. Does nothing if the
+    /// process is not parked.
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param processid the process to wake
+    /// @return true if the process was parked, false otherwise
+    ///
+    virtual bool wake_process(processid::type processid);
+
     /// Get Next Job
     ///
     /// This function is called by a vCPU to get the next thing to execute.
@@ -201,16 +260,41 @@ public:
 
     /// Job Count
     ///
-    /// @return returns the total number of processes in this process list.
+    /// @return returns the number of processes in this process list that
+    ///     are ready to run.
     ///
     auto num_jobs()
-    { return m_process_list.size(); }
+    {
+        std::lock_guard<std::mutex> guard(m_process_mutex);
+
+        __wake_expired();
+        return m_process_list.size();
+    }
+
+    /// Pending Job Count
+    ///
+    /// @return returns the number of processes in this process list that
+    ///     are ready to run, or parked (and not detached).
+    ///
+    auto num_pending_jobs()
+    {
+        std::lock_guard<std::mutex> guard(m_process_mutex);
+
+        auto &&num = m_process_list.size();
+
+        for (const auto &pair : m_parked)
+            num += m_detached.count(pair.first) == 0 ? 1 : 0;
+
+        return num;
+    }
 
 private:
 
     std::unique_ptr<process> &__add_process(processid::type processid, user_data *data);
     std::unique_ptr<process> &__get_process(processid::type processid);
 
+    void __wake_expired();
+
 private:
 
     processlistid::type m_id;
@@ -218,6 +302,8 @@ private:
 
     bool m_is_initialized;
 
+    memory_account m_account;
+
 private:
 
     mutable std::mutex m_vcpu_mutex;
@@ -231,6 +317,10 @@ private:
 
     std::list<processid::type> m_process_list;
 
+    uint64_t m_next_deadline;
+    std::map<processid::type, uint64_t> m_parked;
+    std::set<processid::type> m_detached;
+
 private:
 
     std::unique_ptr<process_factory> m_process_factory;
@@ -0,0 +1,220 @@
+//
+// Bareflank Hyperkernel
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#ifndef SHARED_MEMORY_H
+#define SHARED_MEMORY_H
+
+#include <vector>
+#include <memory>
+
+#include <gsl/gsl>
+
+#include <shmid.h>
+#include <threadid.h>
+#include <processid.h>
+#include <processlistid.h>
+
+class process;
+
+/// Channel Receiver
+///
+/// The thread that is notified when a shared memory region is used as a
+/// channel (see exit_handler_intel_x64_hyperkernel::notify_channel). The
+/// thread is looked up by id, and proc is only used to recognize the
+/// receiver's process when it unmaps the region (see
+/// shared_memory_manager::unbind_receiver), never dereferenced.
+///
+struct channel_receiver
+{
+    processlistid::type procltid{processlistid::invalid};
+    processid::type processid{processid::invalid};
+    threadid::type threadid{threadid::invalid};
+
+    const process *proc{nullptr};
+};
+
+class shared_memory
+{
+public:
+
+    using integer_pointer = uintptr_t;
+    using size_type = std::size_t;
+
+    /// Constructor
+    ///
+    /// Allocates the page frames that back this region. The frames are
+    /// zeroed, and stay put for the lifetime of the region so that any
+    /// number of processes can map them without the VMM ever copying
+    /// the contents.
+    ///
+    /// @expects size != 0
+    /// @ensures none
+    ///
+    /// @param id the id (name) of the shared memory region
+    /// @param size the size of the region in bytes (rounded up to a page)
+    ///
+    shared_memory(shmid::type id, size_type size);
+
+    /// Destructor
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    virtual ~shared_memory() = default;
+
+    /// Shared Memory Id
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @return the shared memory region's id
+    ///
+    virtual shmid::type id() const
+    { return m_id; }
+
+    /// Size
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @return the size of the region in bytes
+    ///
+    virtual size_type size() const
+    { return m_pages.size() * 0x1000; }
+
+    /// Number of Pages
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @return the number of 4k page frames backing this region
+    ///
+    virtual size_type num_pages() const
+    { return m_pages.size(); }
+
+    /// Page Physical Address
+    ///
+    /// @expects index < num_pages()
+    /// @ensures none
+    ///
+    /// @param index the page to get the physical address of
+    /// @return the physical address of the page frame at index
+    ///
+    virtual integer_pointer phys(size_type index) const;
+
+    /// Acquire
+    ///
+    /// Adds a reference to this region. A reference is held for every
+    /// mapping of the region into a process.
+    ///
+    /// @expects !is_destroyed()
+    /// @ensures none
+    ///
+    virtual void acquire();
+
+    /// Release
+    ///
+    /// @expects refs() != 0
+    /// @ensures none
+    ///
+    virtual void release();
+
+    /// References
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @return the number of mappings currently referencing this region
+    ///
+    virtual size_type refs() const
+    { return m_refs; }
+
+    /// Destroy
+    ///
+    /// Marks the region as destroyed. A destroyed region cannot be mapped
+    /// again, but the frames remain valid until the last mapping is
+    /// removed.
+    ///
+    /// @expects none
+    /// @ensures is_destroyed()
+    ///
+    virtual void destroy()
+    { m_destroyed = true; }
+
+    /// Is Destroyed
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @return true if destroy() has been called, false otherwise
+    ///
+    virtual bool is_destroyed() const
+    { return m_destroyed; }
+
+    /// Set Receiver
+    ///
+    /// Sets the thread that is notified when the region is used as a
+    /// channel (see channel_receiver).
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param receiver the receiver, or a default constructed
+    ///     channel_receiver to clear it
+    ///
+    virtual void set_receiver(const channel_receiver &receiver)
+    { m_receiver = receiver; }
+
+    /// Receiver
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @return the receiver (receiver().proc is nullptr if no receiver
+    ///     has been set)
+    ///
+    virtual const channel_receiver &receiver() const
+    { return m_receiver; }
+
+private:
+
+    shmid::type m_id;
+
+    size_type m_refs;
+    bool m_destroyed;
+
+    channel_receiver m_receiver;
+
+    std::vector<integer_pointer> m_phys;
+    std::vector<std::unique_ptr<char[]>> m_pages;
+
+public:
+
+    friend class hyperkernel_ut;
+
+    shared_memory(shared_memory &&) = delete;
+    shared_memory &operator=(shared_memory &&) = delete;
+
+    shared_memory(const shared_memory &) = delete;
+    shared_memory &operator=(const shared_memory &) = delete;
+};
+
+#endif
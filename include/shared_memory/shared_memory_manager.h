@@ -0,0 +1,178 @@
+//
+// Bareflank Hyperkernel
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#ifndef SHARED_MEMORY_MANAGER_H
+#define SHARED_MEMORY_MANAGER_H
+
+#include <map>
+#include <list>
+#include <mutex>
+#include <memory>
+
+#include <shmid.h>
+#include <shared_memory/shared_memory.h>
+
+class shared_memory_manager
+{
+public:
+
+    using size_type = shared_memory::size_type;
+
+    /// Destructor
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    virtual ~shared_memory_manager() = default;
+
+    /// Get Singleton Instance
+    ///
+    /// @expects none
+    /// @ensures ret != nullptr
+    ///
+    /// Get an instance to the singleton class.
+    ///
+    static shared_memory_manager *instance() noexcept;
+
+    /// Create Shared Memory
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param shmid the id (name) of the region to create
+    /// @param size the size of the region in bytes
+    ///
+    virtual void create_shared_memory(shmid::type shmid, size_type size);
+
+    /// Destroy Shared Memory
+    ///
+    /// Removes the name of the region right away, so the id can be reused
+    /// (and the region can no longer be acquired). The frames are freed
+    /// once the last process that has the region mapped unmaps it.
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param shmid the id of the region to destroy
+    ///
+    virtual void destroy_shared_memory(shmid::type shmid);
+
+    /// Acquire Shared Memory
+    ///
+    /// Returns the region associated with the provided id, and adds a
+    /// reference to it. Every call must be paired with a call to
+    /// release_shared_memory.
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param shmid the id of the region to acquire
+    /// @return returns the region associated with the provided id
+    ///
+    virtual gsl::not_null<shared_memory *> acquire_shared_memory(shmid::type shmid);
+
+    /// Release Shared Memory
+    ///
+    /// Takes the region itself rather than its id, as the region may have
+    /// been destroyed (and its id reused) since it was acquired.
+    ///
+    /// @expects shm was returned by acquire_shared_memory
+    /// @ensures none
+    ///
+    /// @param shm the region to release
+    ///
+    virtual void release_shared_memory(gsl::not_null<shared_memory *> shm);
+
+    /// Bind Receiver
+    ///
+    /// Makes the provided thread the receiver of the region's
+    /// notifications (see shared_memory::set_receiver). Any previous
+    /// receiver is replaced. The receiver's process must have the region
+    /// mapped, and the binding lasts until that process unmaps it (see
+    /// unbind_receiver).
+    ///
+    /// @expects receiver.proc != nullptr
+    /// @ensures none
+    ///
+    /// @param shmid the id of the region
+    /// @param receiver the receiver
+    ///
+    virtual void bind_receiver(shmid::type shmid, const channel_receiver &receiver);
+
+    /// Unbind Receiver
+    ///
+    /// Clears the region's receiver if it belongs to proc. Called when
+    /// proc unmaps the region (which includes when proc is deleted), so
+    /// that a channel never names a receiver that no longer exists.
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param shm the region
+    /// @param proc the process that is unmapping the region
+    ///
+    virtual void unbind_receiver(gsl::not_null<shared_memory *> shm, const process *proc);
+
+    /// Get Receiver
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param shmid the id of the region
+    /// @return returns the region's receiver (receiver.proc is nullptr if
+    ///     no receiver is bound)
+    ///
+    virtual channel_receiver get_receiver(shmid::type shmid);
+
+private:
+
+    shared_memory_manager() noexcept = default;
+    std::unique_ptr<shared_memory> &__get_shared_memory(shmid::type shmid);
+
+private:
+
+    mutable std::mutex m_shared_memory_mutex;
+    std::map<shmid::type, std::unique_ptr<shared_memory>> m_shared_memory;
+    std::list<std::unique_ptr<shared_memory>> m_destroyed_shared_memory;
+
+public:
+
+    friend class hyperkernel_ut;
+
+    shared_memory_manager(shared_memory_manager &&) = delete;
+    shared_memory_manager &operator=(shared_memory_manager &&) = delete;
+
+    shared_memory_manager(const shared_memory_manager &) = delete;
+    shared_memory_manager &operator=(const shared_memory_manager &) = delete;
+};
+
+/// Shared Memory Manager Macro
+///
+/// The following macro can be used to quickly call the shared memory manager
+/// as this class will likely be called by a lot of code. This call is
+/// guaranteed to not be NULL
+///
+/// @expects none
+/// @ensures ret != nullptr
+///
+#define g_smm shared_memory_manager::instance()
+
+#endif
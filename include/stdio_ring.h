@@ -0,0 +1,68 @@
+//
+// Bareflank Hyperkernel
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#ifndef STDIO_RING_H
+#define STDIO_RING_H
+
+#include <stdint.h>
+
+#pragma pack(push, 1)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Stdio Ring
+///
+/// A single producer / single consumer ring that carries one of a VM
+/// app's output streams (stdout or stderr) to the bfexec process that
+/// launched it. The ring lives in bfexec's memory, and is mapped into the
+/// VM app (see crt_info), so writing to it does not exit.
+///
+/// head and tail are free running byte counts (head - tail is the number
+/// of bytes in the ring). Only the VM app writes head, and only bfexec
+/// writes tail, and they are kept on separate cache lines.
+///
+/// bfexec drains the ring whenever it gets the core. The VM app only
+/// gives it the core (the doorbell) once the ring crosses
+/// STDIO_RING_WATERMARK, or when the ring is full.
+///
+#define STDIO_RING_SIZE 0x10000UL
+#define STDIO_RING_WATERMARK (STDIO_RING_SIZE / 2)
+
+struct stdio_ring_t
+{
+    uint64_t head;
+    uint64_t reserved1[7];
+
+    uint64_t tail;
+    uint64_t reserved2[7];
+
+    char data[STDIO_RING_SIZE];
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#pragma pack(pop)
+
+#endif
@@ -0,0 +1,89 @@
+//
+// Bareflank Hyperkernel
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+
+#ifndef SYSCALL_PAGE_H
+#define SYSCALL_PAGE_H
+
+#include <stdint.h>
+
+#pragma pack(push, 1)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Syscall Page
+///
+/// A page, owned by a VM app thread, that the thread posts requests to
+/// instead of making a vmcall for each one (see vmcall__set_syscall_page).
+/// The VMM processes the requests in bulk, the next time the thread
+/// yields or halts, and posts a completion for each one. Since the VMM
+/// writes to the page for as long as it is registered, it must be part of
+/// the VM app's image (not program break or shared memory).
+///
+/// The entries are used as a ring. The VM app fills in the entry at
+/// submitted % SYSCALL_PAGE_ENTRIES (which must not be SUBMITTED), sets
+/// its status to SUBMITTED, and then increments submitted. The VMM
+/// processes entries in order, setting each one's ret and status (DONE),
+/// and then incrementing completed. A DONE entry can be reused as soon as
+/// its result has been read (or right away, if nobody is waiting for it).
+/// A request that can't be completed yet (a write while the console's
+/// queue is full) stays SUBMITTED, and stalls the entries after it, until
+/// a later yield completes it.
+///
+#define SYSCALL_PAGE_ENTRIES 63UL
+
+#define SYSCALL_STATUS_FREE 0x0UL
+#define SYSCALL_STATUS_SUBMITTED 0x1UL
+#define SYSCALL_STATUS_DONE 0x2UL
+
+#define SYSCALL_OP_INCREASE_PROGRAM_BREAK 0x1UL     // args[0] = # of pages, ret = # of pages added
+#define SYSCALL_OP_MAP_SHM 0x2UL                    // args[0] = shmid, args[1] = virt, args[2] = perm
+#define SYSCALL_OP_WRITE 0x3UL                      // args[0] = buffer, args[1] = size, ret = # of bytes
+
+#define SYSCALL_RET_FAILURE 0xFFFFFFFFFFFFFFFFUL
+
+struct syscall_entry_t
+{
+    uint64_t status;
+    uint64_t op;
+    uint64_t args[3];
+    uint64_t ret;
+    uint64_t reserved[2];
+};
+
+struct syscall_page_t
+{
+    uint64_t submitted;
+    uint64_t completed;
+    uint64_t reserved[6];
+
+    struct syscall_entry_t entries[SYSCALL_PAGE_ENTRIES];
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#pragma pack(pop)
+
+#endif
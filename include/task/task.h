@@ -83,12 +83,62 @@ public:
     ///
     virtual void schedule(thread *thrd, uintptr_t entry, uintptr_t arg1, uintptr_t arg2) = 0;
 
+    /// Bind
+    ///
+    /// Adds this task to a process list, and to its core's scheduler. A
+    /// task is bound to the process list it was created with, and can be
+    /// moved to another one with unbind / bind.
+    ///
+    /// @expects is_bound() == false
+    /// @ensures is_bound() == true
+    ///
+    /// @param proclt the process list this task will execute
+    /// @param domain the domain that this task will execute on
+    /// @param vcpuid the id the process list knows this task by
+    ///
+    void bind(
+        gsl::not_null<process_list *> proclt,
+        gsl::not_null<domain *> domain,
+        vcpuid::type vcpuid);
+
+    /// Unbind
+    ///
+    /// Removes this task from its process list and scheduler, so that it
+    /// is no longer executed. Does nothing if the task is not bound.
+    ///
+    /// @expects none
+    /// @ensures is_bound() == false
+    ///
+    void unbind();
+
+    /// Is Bound
+    ///
+    /// @return returns true if the task is bound to a process list
+    ///
+    bool is_bound() const
+    { return m_is_bound; }
+
+    /// Bound vCPU ID
+    ///
+    /// @return returns the id this task was last bound with (see bind)
+    ///
+    vcpuid::type bound_vcpuid() const
+    { return m_vcpuid; }
+
     /// Done
     ///
     /// @return returns true if there is no more work to be done,
     ///     false otherwise
     virtual size_t num_jobs();
 
+    /// Is Host
+    ///
+    /// @return returns true if this task runs the host OS. The host can
+    ///     always be scheduled, even when it has no jobs.
+    ///
+    virtual bool is_host() const
+    { return (m_vcpuid >> vcpuid::guest_from) == 0; }
+
 private:
 
     coreid::type m_coreid;
@@ -96,6 +146,8 @@ private:
     gsl::not_null<process_list *> m_proclt;
     gsl::not_null<domain *> m_domain;
 
+    bool m_is_bound;
+
 public:
 
     friend class hyperkernel_ut;
@@ -0,0 +1,150 @@
+//
+// Bareflank Hyperkernel
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+
+#ifndef SYSCALL_PAGE_INTEL_X64_H
+#define SYSCALL_PAGE_INTEL_X64_H
+
+#include <map>
+#include <mutex>
+#include <functional>
+
+#include <gsl/gsl>
+
+#include <syscall_page.h>
+#include <memory_manager/map_ptr_x64.h>
+
+class thread_intel_x64;
+
+/// Syscall Page Manager
+///
+/// Keeps track of the syscall pages that VM app threads have registered
+/// (see syscall_page.h), each of which is mapped into the VMM once, when
+/// it is registered, and walks their rings. What each request does is up
+/// to the caller (see exit_handler_intel_x64_hyperkernel::process_syscall),
+/// so this class only deals with the ring itself.
+///
+class syscall_page_manager
+{
+public:
+
+    using handler_type = std::function<uint64_t(thread_intel_x64 *, const syscall_entry_t &)>;
+
+    /// Retry
+    ///
+    /// A handler returns this for a request that can't be completed yet
+    /// (e.g. a write to a driver whose queue is full). The request is left
+    /// in the ring, and processing of the ring stops there (so that the
+    /// requests stay in order) until the next time the page is processed.
+    ///
+    static constexpr const uint64_t retry = 0xFFFFFFFFFFFFFFFEUL;
+
+    /// Destructor
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    virtual ~syscall_page_manager() = default;
+
+    /// Get Singleton Instance
+    ///
+    /// @expects none
+    /// @ensures ret != nullptr
+    ///
+    static syscall_page_manager *instance() noexcept;
+
+    /// Set Page
+    ///
+    /// Registers thrd's syscall page, replacing any page that was
+    /// registered before.
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param thrd the thread that owns the page
+    /// @param hpa the host physical address of the page
+    ///
+    virtual void set_page(gsl::not_null<thread_intel_x64 *> thrd, uintptr_t hpa);
+
+    /// Release
+    ///
+    /// Called when a thread is deleted (or stops using its page).
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param thrd the thread being deleted
+    ///
+    virtual void release(thread_intel_x64 *thrd);
+
+    /// Process
+    ///
+    /// Processes every request that thrd has submitted. Does nothing if
+    /// thrd does not have a syscall page.
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param thrd the thread whose page should be processed
+    /// @param handler called for each request, returns the request's result
+    ///
+    virtual void process(thread_intel_x64 *thrd, const handler_type &handler);
+
+private:
+
+    syscall_page_manager() noexcept = default;
+
+    struct page_t
+    {
+        bfn::unique_map_ptr_x64<syscall_page_t> m_page;
+        uint64_t m_completed;
+    };
+
+    void __process(thread_intel_x64 *thrd, page_t &page, const handler_type &handler);
+
+private:
+
+    std::mutex m_mutex;
+    std::map<thread_intel_x64 *, page_t> m_pages;
+
+public:
+
+    friend class hyperkernel_ut;
+
+    syscall_page_manager(syscall_page_manager &&) = delete;
+    syscall_page_manager &operator=(syscall_page_manager &&) = delete;
+
+    syscall_page_manager(const syscall_page_manager &) = delete;
+    syscall_page_manager &operator=(const syscall_page_manager &) = delete;
+};
+
+/// Syscall Page Manager Macro
+///
+/// The following macro can be used to quickly call the syscall page
+/// manager as this class will likely be called by a lot of code. This call
+/// is guaranteed to not be NULL
+///
+/// @expects none
+/// @ensures ret != nullptr
+///
+#define g_spm syscall_page_manager::instance()
+
+#endif
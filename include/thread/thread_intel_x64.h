@@ -22,7 +22,10 @@
 #ifndef THREAD_INTEL_X64_H
 #define THREAD_INTEL_X64_H
 
+#include <atomic>
+
 #include <thread/thread.h>
+#include <thread/xsave_intel_x64.h>
 #include <exit_handler/state_save_intel_x64.h>
 
 class thread_intel_x64 : public thread
@@ -44,7 +47,7 @@ public:
     /// @expects none
     /// @ensures none
     ///
-    ~thread_intel_x64() override = default;
+    ~thread_intel_x64() override;
 
     /// Set Thread Info
     ///
@@ -58,6 +61,106 @@ public:
     ///
     void set_info(uintptr_t entry, uintptr_t stack, uintptr_t arg1, uintptr_t arg2) override;
 
+    /// Set Event Handler
+    ///
+    /// Registers the function that pending events are delivered to (see
+    /// deliver_events). The handler is given the pending events in rdi,
+    /// and the pending device events in rsi (i.e. it is a
+    /// void (*)(uint64_t events, uint64_t devices)), and must finish with
+    /// vmcall__event_return instead of returning.
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param entry the event handler, or 0 to stop delivering events
+    ///
+    virtual void set_event_handler(uintptr_t entry);
+
+    /// Post Events
+    ///
+    /// Marks events as pending. Events are delivered at the thread's next
+    /// VM entry, and events that are posted before then are coalesced
+    /// into a single delivery. Safe to call from any core.
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param events a bitmap of the events to post
+    ///
+    virtual void post_events(uint64_t events);
+
+    /// Post Device Events
+    ///
+    /// Same as post_events, but for the devices a driver serves (bit n is
+    /// device n, see driver_manager). Device events are kept in their own
+    /// bitmap, so they never collide with the events that VM apps post to
+    /// each other using inject_event.
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param devices a bitmap of the devices with pending requests
+    ///
+    virtual void post_device_events(uint64_t devices);
+
+    /// Has Deliverable Events
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @return true if events are pending, and deliver_events would
+    ///     deliver them
+    ///
+    virtual bool has_deliverable_events() const;
+
+    /// Notify
+    ///
+    /// Marks a notification as pending. Unlike an event, a notification
+    /// is not delivered to a handler, it only ends (or prevents) the
+    /// thread's next hlt_process, and any number of notifications that
+    /// arrive before then are coalesced into one. Safe to call from any
+    /// core.
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    virtual void notify();
+
+    /// Consume Notification
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @return true if a notification was pending (which is cleared),
+    ///     false otherwise
+    ///
+    virtual bool consume_notification();
+
+    /// Deliver Events
+    ///
+    /// If events are pending, and the thread is not already running its
+    /// event handler, state_save (the state the thread is about to be
+    /// resumed with) is saved, and redirected to the event handler. The
+    /// pending events are consumed all at once.
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param state_save the state the thread is about to be resumed with
+    ///
+    virtual void deliver_events(state_save_intel_x64 &state_save);
+
+    /// Event Return
+    ///
+    /// Restores the state that was interrupted by deliver_events.
+    ///
+    /// @expects the thread is running its event handler
+    /// @ensures none
+    ///
+    /// @param state_save the state the thread is about to be resumed with
+    ///
+    virtual void event_return(state_save_intel_x64 &state_save);
+
     /// TODO:
     ///
     /// These should not be public
@@ -65,12 +168,36 @@ public:
     uintptr_t m_stack;
     state_save_intel_x64 m_state_save;
 
+    /// The thread's extended state. This is not allocated until the
+    /// thread first uses SIMD (see xsave_manager).
+    ///
+    xsave_area m_xsave;
+
+    /// The thread's IPC state (see exit_handler_intel_x64_hyperkernel::ipc_call).
+    /// m_ipc_waiting is set while the thread is blocked in ipc_reply_wait,
+    /// m_ipc_caller is the thread that is blocked waiting for this thread's
+    /// reply, and m_ipc_callee is the thread that this thread is waiting on.
+    ///
+    std::atomic<bool> m_ipc_waiting;
+    thread_intel_x64 *m_ipc_caller;
+    thread_intel_x64 *m_ipc_callee;
+
+private:
+
+    std::atomic<uint64_t> m_pending_events;
+    std::atomic<uint64_t> m_pending_device_events;
+    std::atomic<bool> m_pending_notification;
+
+    uintptr_t m_event_entry;
+    bool m_in_event;
+    state_save_intel_x64 m_event_state_save;
+
 public:
 
     friend class hyperkernel_ut;
 
-    thread_intel_x64(thread_intel_x64 &&) = default;
-    thread_intel_x64 &operator=(thread_intel_x64 &&) = default;
+    thread_intel_x64(thread_intel_x64 &&) = delete;
+    thread_intel_x64 &operator=(thread_intel_x64 &&) = delete;
 
     thread_intel_x64(const thread_intel_x64 &) = delete;
     thread_intel_x64 &operator=(const thread_intel_x64 &) = delete;
@@ -0,0 +1,240 @@
+//
+// Bareflank Hyperkernel
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#ifndef XSAVE_INTEL_X64_H
+#define XSAVE_INTEL_X64_H
+
+#include <map>
+#include <mutex>
+#include <memory>
+
+#include <gsl/gsl>
+
+#include <coreid.h>
+
+extern "C" uint64_t __xgetbv(uint64_t xcr) noexcept;
+extern "C" void __xsetbv(uint64_t xcr, uint64_t value) noexcept;
+extern "C" void __xsaveopt(void *area, uint64_t rfbm) noexcept;
+extern "C" void __xrstor(void *area, uint64_t rfbm) noexcept;
+extern "C" void __cpuid_xsave(uint64_t subleaf, uint32_t *regs) noexcept;
+
+class thread_intel_x64;
+
+// *INDENT-OFF*
+
+namespace xcr0
+{
+    using value_type = uint64_t;
+
+    constexpr const value_type x87 = 0x1UL;
+    constexpr const value_type sse = 0x2UL;
+    constexpr const value_type avx = 0x4UL;
+    constexpr const value_type opmask = 0x20UL;
+    constexpr const value_type zmm_hi256 = 0x40UL;
+    constexpr const value_type hi16_zmm = 0x80UL;
+
+    constexpr const value_type avx512 = opmask | zmm_hi256 | hi16_zmm;
+}
+
+// *INDENT-ON*
+
+/// XSAVE Area
+///
+/// A 64 byte aligned buffer large enough to hold the extended state of
+/// every feature the CPU supports.
+///
+struct xsave_area
+{
+    std::unique_ptr<char[]> m_mem{};
+    char *m_area{nullptr};
+
+    explicit operator bool() const noexcept
+    { return m_area != nullptr; }
+};
+
+/// XSAVE Manager
+///
+/// Owns the extended state (x87, SSE, AVX, AVX-512) of each core, and
+/// switches it lazily. When a VM app thread is scheduled, the guest's
+/// CR0.TS is set unless the thread already owns the core's extended state.
+/// The first SIMD instruction the thread executes causes a #NM, which
+/// traps to the VMM, at which point the previous owner's state is saved
+/// (using XSAVEOPT) and the thread's state is restored (using XRSTOR).
+/// Threads that never touch SIMD never pay for a save or restore.
+///
+/// Since VM apps run in ring 0, TS is owned by the VMM (it is in the CR0
+/// guest/host mask), so a thread that clears it itself (CLTS, LMSW or MOV
+/// to CR0) traps as well, and is switched the same way as on a #NM.
+///
+/// A thread's state is saved whenever the thread gives up a core (which is
+/// cheap with XSAVEOPT if nothing changed), and a thread is the owner of at
+/// most one core at a time, so a thread that moves to another core always
+/// restores its latest state, and the core it left never saves stale state
+/// over it.
+///
+/// The host OS's extended state is treated like any other owner, except
+/// that it is switched back eagerly before the host vCPU is resumed, as the
+/// VMM does not trap the host's use of SIMD.
+///
+class xsave_manager
+{
+public:
+
+    /// Destructor
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    virtual ~xsave_manager() = default;
+
+    /// Get Singleton Instance
+    ///
+    /// @expects none
+    /// @ensures ret != nullptr
+    ///
+    static xsave_manager *instance() noexcept;
+
+    /// XCR0
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @return the XCR0 that VM apps run with (x87 and SSE, plus AVX and
+    ///     AVX-512 when the CPU supports them). AVX2 does not have its own
+    ///     state component, and is covered by AVX.
+    ///
+    virtual xcr0::value_type vm_xcr0() const noexcept
+    { return m_vm_xcr0; }
+
+    /// Owner
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param coreid the core to query
+    /// @return the thread whose extended state is loaded on coreid, or
+    ///     nullptr if it is the host's (or nobody's)
+    ///
+    virtual thread_intel_x64 *owner(coreid::type coreid) const;
+
+    /// Switch To Thread
+    ///
+    /// Saves the extended state of coreid's current owner, and loads
+    /// thrd's. If thrd has never used SIMD, it is given a clean state.
+    /// If thrd owns another core, that core gives up ownership (its
+    /// registers no longer hold thrd's latest state). Does nothing if
+    /// thrd already owns coreid.
+    ///
+    /// @expects thrd != nullptr
+    /// @ensures owner(coreid) == thrd
+    ///
+    /// @param coreid the current core
+    /// @param thrd the thread that will own the core's extended state
+    ///
+    virtual void switch_to_thread(coreid::type coreid, gsl::not_null<thread_intel_x64 *> thrd);
+
+    /// Save
+    ///
+    /// Called when thrd gives up coreid. If thrd owns coreid's extended
+    /// state, the state is saved (using XSAVEOPT), so that thrd's area is
+    /// up to date if thrd is resumed on another core. The core keeps
+    /// ownership, so if thrd is resumed on the same core, nothing has to
+    /// be restored.
+    ///
+    /// @expects thrd != nullptr
+    /// @ensures none
+    ///
+    /// @param coreid the current core
+    /// @param thrd the thread that is giving up the core
+    ///
+    virtual void save(coreid::type coreid, gsl::not_null<thread_intel_x64 *> thrd);
+
+    /// Switch To Host
+    ///
+    /// Saves the extended state of coreid's current owner, and loads the
+    /// host's (including the host's XCR0). Does nothing if the host's
+    /// state is already loaded.
+    ///
+    /// @expects none
+    /// @ensures owner(coreid) == nullptr
+    ///
+    /// @param coreid the current core
+    ///
+    virtual void switch_to_host(coreid::type coreid);
+
+    /// Release
+    ///
+    /// Called when a thread is deleted. If the thread owns a core's
+    /// extended state, the state is discarded rather than saved.
+    ///
+    /// @expects none
+    /// @ensures owner(coreid) != thrd for every core
+    ///
+    /// @param thrd the thread being deleted
+    ///
+    virtual void release(thread_intel_x64 *thrd);
+
+private:
+
+    xsave_manager();
+
+    xsave_area __make_area() const;
+
+private:
+
+    struct core_state
+    {
+        thread_intel_x64 *m_owner{nullptr};
+        bool m_host_loaded{true};
+
+        xsave_area m_host_area{};
+        xcr0::value_type m_host_xcr0{0};
+    };
+
+    std::size_t m_area_size;
+    xcr0::value_type m_vm_xcr0;
+
+    mutable std::mutex m_mutex;
+    std::map<coreid::type, core_state> m_cores;
+
+public:
+
+    friend class hyperkernel_ut;
+
+    xsave_manager(xsave_manager &&) = delete;
+    xsave_manager &operator=(xsave_manager &&) = delete;
+
+    xsave_manager(const xsave_manager &) = delete;
+    xsave_manager &operator=(const xsave_manager &) = delete;
+};
+
+/// XSAVE Manager Macro
+///
+/// The following macro can be used to quickly call the xsave manager as
+/// this class will likely be called by a lot of code. This call is
+/// guaranteed to not be NULL
+///
+/// @expects none
+/// @ensures ret != nullptr
+///
+#define g_xsm xsave_manager::instance()
+
+#endif
@@ -82,7 +82,7 @@ public:
 
     /// Destructor
     ///
-    ~vcpu_intel_x64_hyperkernel() override = default;
+    ~vcpu_intel_x64_hyperkernel() override;
 
     /// Init vCPU
     ///
@@ -191,18 +191,47 @@ public:
     /// Unlike all of the other classes, vCPUs are actually managed by
     /// Bareflank itself. vCPU IDs need to be very specific for Bareflank
     /// as they also represent Core IDs, but the remaining vCPU ids can
-    /// be arbitrary.
+    /// be arbitrary. Guest vCPU IDs come from the vCPU ID allocator, and
+    /// are released when the vCPU is deleted.
     ///
     /// @expects none
     /// @ensures none
     ///
+    /// @param coreid the core the vCPU will be created on
     /// @return returns the next vCPU ID
     ///
-    static vcpuid::type next_vcpuid();
+    static vcpuid::type next_vcpuid(coreid::type coreid);
+
+    /// Rebind
+    ///
+    /// Binds an unbound vCPU (see vcpu_pool) to a process list / domain.
+    /// The vCPU keeps its VMCS and exit handler, so unless the vCPU has
+    /// never been launched, the only part of the VMCS that changes is the
+    /// guest CR3, which is written the next time the vCPU is scheduled
+    /// (the GDT, IDT and TSS are mapped at the same address in every
+    /// domain).
+    ///
+    /// The vCPU is given a new id (see vcpuid_allocator), so the ids it
+    /// was known by before it was pooled are dead. Note that id() (the id
+    /// Bareflank's vCPU manager knows the vCPU by) does not change.
+    ///
+    /// @expects is_bound() == false
+    /// @ensures is_bound() == true
+    ///
+    /// @param proclt the process list the vcpu should use.
+    /// @param domain the domain the vcpu should use.
+    /// @param vcpuid the vCPU's new id, acquired from g_vid
+    ///
+    virtual void rebind(
+        gsl::not_null<process_list *> proclt,
+        gsl::not_null<domain_intel_x64 *> domain,
+        vcpuid::type vcpuid);
 
 private:
 
     coreid::type m_coreid;
+    bool m_is_host;
+    uintptr_t m_pending_cr3;
     gsl::not_null<process_list *> m_proclt;
     gsl::not_null<domain_intel_x64 *> m_domain;
 
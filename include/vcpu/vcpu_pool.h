@@ -0,0 +1,198 @@
+//
+// Bareflank Hyperkernel
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#ifndef VCPU_POOL_H
+#define VCPU_POOL_H
+
+#include <gsl/gsl>
+
+#include <map>
+#include <list>
+#include <mutex>
+
+#include <coreid.h>
+#include <vcpuid.h>
+
+class vcpu_data_intel_x64;
+class vcpu_intel_x64_hyperkernel;
+
+/// vCPU Pool
+///
+/// Building a guest vCPU means allocating and initializing its vmcs, exit
+/// handler and guest state, and the VMCS itself is written in full the
+/// first time the vCPU is launched. The vCPU pool keeps, for each core, a
+/// number of guest vCPUs that are already built (and, once they have been
+/// used, already launched), but that are not bound to a process list, and
+/// therefore never scheduled. create_vcpu hands one of these out by
+/// rebinding it to the caller's process list, and delete_vcpu puts a vCPU
+/// back into the pool, if there is room for it, instead of deleting it.
+/// A pooled vCPU does not keep its id. The id is released when the vCPU is
+/// pooled, and a new one is acquired each time it is handed out.
+///
+/// Note that the vCPUs are still owned by Bareflank's vCPU manager. The
+/// pool only tracks which of them are free.
+///
+class vcpu_pool
+{
+public:
+
+    /// Destructor
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    virtual ~vcpu_pool() = default;
+
+    /// Get Singleton Instance
+    ///
+    /// @expects none
+    /// @ensures ret != nullptr
+    ///
+    /// Get an instance to the singleton class.
+    ///
+    static vcpu_pool *instance() noexcept;
+
+    /// Create vCPU
+    ///
+    /// Rebinds a pooled vCPU of vd->m_coreid to vd->m_proclt / vd->m_domain,
+    /// or creates a new vCPU if the pool is empty.
+    ///
+    /// @expects vd->m_proclt != nullptr
+    /// @expects vd->m_domain != nullptr
+    /// @ensures none
+    ///
+    /// @param vd the core, process list and domain of the vCPU
+    /// @return the id of the vCPU
+    ///
+    virtual vcpuid::type create_vcpu(gsl::not_null<vcpu_data_intel_x64 *> vd);
+
+    /// Delete vCPU
+    ///
+    /// Unbinds the vCPU and puts it back into its core's pool, or deletes
+    /// it if the pool is full. Either way, vcpuid is released, so it is
+    /// never valid again, even if the vCPU is handed out again by
+    /// create_vcpu (which gives it a new id).
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param vcpuid the vCPU to delete
+    /// @return false if vcpuid is not the id of a bound vCPU (e.g. it was
+    ///     already deleted), true otherwise
+    ///
+    virtual bool delete_vcpu(vcpuid::type vcpuid);
+
+    /// Set Pool Size
+    ///
+    /// Sets how many vCPUs each core's pool should hold. If a pool holds
+    /// more than this, the extra vCPUs are deleted. The pools are not
+    /// filled until refill is called.
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param size the number of vCPUs each core's pool should hold
+    ///
+    virtual void set_pool_size(std::size_t size);
+
+    /// Refill
+    ///
+    /// Creates vCPUs for vd->m_coreid's pool until it is full, or until
+    /// max vCPUs have been added. This should be called when the VMM is
+    /// not servicing a request (e.g. when the host yields) so that the cost
+    /// of building a vCPU is not seen by create_vcpu. The new vCPUs are
+    /// built for vd->m_proclt / vd->m_domain, and unbound right away.
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param vd the core, process list and domain to build the vCPUs with
+    /// @param max the max number of vCPUs to add
+    /// @return the number of vCPUs that were added to the pool
+    ///
+    virtual std::size_t refill(gsl::not_null<vcpu_data_intel_x64 *> vd, std::size_t max = ~0UL);
+
+    /// Pool Size
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @return the number of vCPUs each core's pool should hold
+    ///
+    virtual std::size_t pool_size() const;
+
+    /// Pooled vCPUs
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param coreid the core to query
+    /// @return the number of vCPUs coreid's pool currently holds
+    ///
+    virtual std::size_t pooled_vcpus(coreid::type coreid) const;
+
+    /// Remove
+    ///
+    /// Called by every guest vCPU when it is deleted.
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param vcpu the vCPU that is being deleted
+    ///
+    virtual void remove(gsl::not_null<vcpu_intel_x64_hyperkernel *> vcpu) noexcept;
+
+private:
+
+    vcpu_pool() noexcept;
+
+    vcpu_intel_x64_hyperkernel *__acquire(coreid::type coreid);
+
+private:
+
+    mutable std::mutex m_mutex;
+    std::size_t m_pool_size;
+
+    std::map<coreid::type, std::list<vcpu_intel_x64_hyperkernel *>> m_pool;
+
+public:
+
+    friend class hyperkernel_ut;
+
+    vcpu_pool(vcpu_pool &&) = delete;
+    vcpu_pool &operator=(vcpu_pool &&) = delete;
+
+    vcpu_pool(const vcpu_pool &) = delete;
+    vcpu_pool &operator=(const vcpu_pool &) = delete;
+};
+
+/// vCPU Pool Macro
+///
+/// The following macro can be used to quickly call the vCPU pool as this
+/// class will likely be called by a lot of code. This call is guaranteed
+/// to not be NULL
+///
+/// @expects none
+/// @ensures ret != nullptr
+///
+#define g_vpl vcpu_pool::instance()
+
+#endif
@@ -0,0 +1,183 @@
+//
+// Bareflank Hyperkernel
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#ifndef VCPUID_ALLOCATOR_H
+#define VCPUID_ALLOCATOR_H
+
+#include <array>
+#include <atomic>
+#include <memory>
+
+#include <coreid.h>
+#include <vcpuid.h>
+
+class vcpu_intel_x64_hyperkernel;
+
+/// vCPU ID Allocator
+///
+/// Hands out the ids of guest vCPUs. Each core has its own table of
+/// vCPU slots, and a guest vCPU id is made up of:
+///
+/// - bits [0, guest_from): the core the vCPU was created on
+/// - bits [guest_from, generation_from): the vCPU's slot on that core
+/// - bits [generation_from, 63): the slot's generation
+///
+/// When an id is released, its slot goes back on the core's free list,
+/// and the slot's generation is incremented, so the next vCPU to get the
+/// slot has a different id, and any use of the old id (e.g. a
+/// delete_vcpu of a vCPU that was already deleted) is caught by lookup
+/// and release. This includes vCPUs that are reused by the vCPU pool,
+/// which releases a vCPU's id when the vCPU is pooled, and acquires a new
+/// one each time the vCPU is handed out again (see vcpu_pool), so each
+/// binding of a vCPU to a process list has its own id.
+///
+/// acquire and release are lock-free (the free list is a stack with a
+/// tagged head, so a slot that is popped and pushed back while another
+/// core is popping it is not mistaken for the same head), and lookup is
+/// a bounds check and two loads, which is why vCPUs are looked up by id
+/// through this allocator rather than a map.
+///
+class vcpuid_allocator
+{
+public:
+
+    using index_type = uint64_t;
+
+    constexpr static const index_type max_cores = 256;
+    constexpr static const index_type max_vcpus_per_core = 1024;
+
+    constexpr static const index_type index_bits = 20;
+    constexpr static const index_type generation_from = vcpuid::guest_from + index_bits;
+    constexpr static const index_type generation_mask = (1UL << (63 - generation_from)) - 1;
+
+    /// Destructor
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    virtual ~vcpuid_allocator();
+
+    /// Get Singleton Instance
+    ///
+    /// @expects none
+    /// @ensures ret != nullptr
+    ///
+    /// Get an instance to the singleton class.
+    ///
+    static vcpuid_allocator *instance() noexcept;
+
+    /// Acquire
+    ///
+    /// @expects coreid < max_cores
+    /// @ensures ret is a guest vCPU id
+    ///
+    /// @param coreid the core the vCPU will be created on
+    /// @return a vCPU id that is not used by any other vCPU
+    ///
+    virtual vcpuid::type acquire(coreid::type coreid);
+
+    /// Release
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param vcpuid the vCPU id to release
+    /// @return false if vcpuid is not a live id (it was never acquired,
+    ///     or was already released), true otherwise
+    ///
+    virtual bool release(vcpuid::type vcpuid) noexcept;
+
+    /// Set
+    ///
+    /// Sets the vCPU that lookup returns for vcpuid.
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param vcpuid a live vCPU id
+    /// @param vcpu the vCPU with this id (or nullptr)
+    /// @return false if vcpuid is not a live id, true otherwise
+    ///
+    virtual bool set(vcpuid::type vcpuid, vcpu_intel_x64_hyperkernel *vcpu) noexcept;
+
+    /// Lookup
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param vcpuid the vCPU id to look up
+    /// @return the vCPU set for vcpuid, or nullptr if there is none, or
+    ///     if vcpuid is not a live id
+    ///
+    virtual vcpu_intel_x64_hyperkernel *lookup(vcpuid::type vcpuid) const noexcept;
+
+private:
+
+    struct slot
+    {
+        std::atomic<index_type> m_generation{1};
+        std::atomic<index_type> m_next{0};
+        std::atomic<vcpu_intel_x64_hyperkernel *> m_vcpu{nullptr};
+    };
+
+    struct core_table
+    {
+        std::atomic<index_type> m_free{0};
+        std::atomic<index_type> m_next_unused{0};
+
+        std::array<slot, max_vcpus_per_core> m_slots;
+    };
+
+    vcpuid_allocator() noexcept = default;
+
+    core_table *__table(coreid::type coreid);
+    slot *__slot(vcpuid::type vcpuid) const noexcept;
+
+    static vcpuid::type __make_id(coreid::type coreid, index_type index, index_type generation) noexcept
+    { return (generation << generation_from) | (index << vcpuid::guest_from) | coreid; }
+
+private:
+
+    std::array<std::atomic<core_table *>, max_cores> m_tables{};
+
+public:
+
+    friend class hyperkernel_ut;
+
+    vcpuid_allocator(vcpuid_allocator &&) = delete;
+    vcpuid_allocator &operator=(vcpuid_allocator &&) = delete;
+
+    vcpuid_allocator(const vcpuid_allocator &) = delete;
+    vcpuid_allocator &operator=(const vcpuid_allocator &) = delete;
+};
+
+/// vCPU ID Allocator Macro
+///
+/// The following macro can be used to quickly call the vCPU ID allocator
+/// as this class will likely be called by a lot of code. This call is
+/// guaranteed to not be NULL
+///
+/// @expects none
+/// @ensures ret != nullptr
+///
+#define g_vid vcpuid_allocator::instance()
+
+#endif
@@ -29,6 +29,47 @@
 #define REG_CURRENT 0xFFFFFFFFFFFFFFF0UL
 #define REG_SUCCESS 0x0
 
+#define VM_PERM_X 0x1UL
+#define VM_PERM_W 0x2UL
+#define VM_PERM_R 0x4UL
+
+#define MEM_CATEGORY_PROGRAM_BREAK 0x0UL
+#define MEM_CATEGORY_EPT 0x1UL
+#define MEM_CATEGORY_THREAD 0x2UL
+#define MEM_CATEGORY_MAPPED 0x3UL
+
+#define NUMA_POLICY_LOCAL 0x0UL
+#define NUMA_POLICY_INTERLEAVE 0x1UL
+#define NUMA_POLICY_EXPLICIT_NODE 0x2UL
+
+#define NUMA_STAT_LOCAL 0x0UL
+#define NUMA_STAT_REMOTE 0x1UL
+#define NUMA_STAT_FALLBACK 0x2UL
+
+#define VMCS_STAT_EXITS 0x0UL
+#define VMCS_STAT_VMREADS 0x1UL
+#define VMCS_STAT_VMWRITES 0x2UL
+#define VMCS_STAT_VMREADS_SAVED 0x3UL
+#define VMCS_STAT_VMWRITES_SAVED 0x4UL
+
+#define EXIT_STATS_NUM_REASONS 128UL
+#define EXIT_STATS_NUM_BUCKETS 32UL
+
+#define DEVICE_TTYS0 0x0UL
+#define DEVICE_MAX 64UL
+
+#define BATCH_OP_VM_MAP 0x1UL
+#define BATCH_OP_VM_MAP_LOOKUP 0x2UL
+#define BATCH_OP_VM_MAP_LAZY 0x3UL
+#define BATCH_OP_SET_THREAD_INFO 0x4UL
+#define BATCH_OP_CREATE_THREAD 0x5UL
+
+#define BATCH_STATUS_NOT_RUN 0x0UL
+#define BATCH_STATUS_SUCCESS 0x1UL
+#define BATCH_STATUS_FAILURE 0x2UL
+
+#define BATCH_MAX_OPS 128UL
+
 #pragma pack(push, 1)
 
 #ifdef __cplusplus
@@ -51,6 +92,96 @@ extern "C" {
 #define scast(a, b) (static_cast<a>(b))
 #endif
 
+#ifndef __cplusplus
+#define rcast(a, b) ((a)(b))
+#else
+#define rcast(a, b) (reinterpret_cast<a>(b))
+#endif
+
+/// Exception Info
+///
+/// Shared between a VM app and the domain's exception stub. The stub calls
+/// handler, and fault_addr holds the guest physical address of the last
+/// EPT violation that was reflected to the VM app as a #PF. active is set
+/// by the stub while the handler is running (a second exception in the
+/// meantime is fatal).
+///
+struct exception_info_t
+{
+    uint64_t handler;
+    uint64_t fault_addr;
+    uint64_t active;
+};
+
+/// Exception Frame
+///
+/// The state that the exception stub pushes before calling the VM app's
+/// handler (which is given a pointer to this frame). Changes to the frame
+/// are restored when the handler returns, so a handler can, for example,
+/// skip the faulting instruction by advancing rip.
+///
+struct exception_frame_t
+{
+    uint64_t r15;
+    uint64_t r14;
+    uint64_t r13;
+    uint64_t r12;
+    uint64_t r11;
+    uint64_t r10;
+    uint64_t r09;
+    uint64_t r08;
+    uint64_t rbp;
+    uint64_t rdi;
+    uint64_t rsi;
+    uint64_t rdx;
+    uint64_t rcx;
+    uint64_t rbx;
+    uint64_t rax;
+
+    uint64_t vector;
+    uint64_t error_code;
+
+    uint64_t rip;
+    uint64_t cs;
+    uint64_t rflags;
+    uint64_t rsp;
+    uint64_t ss;
+};
+
+/// IPC Message
+///
+/// The message that is passed between VM app threads by ipc_call and
+/// ipc_reply_wait. The message is passed in registers, and is never
+/// copied through memory by the VMM.
+///
+/// ipc_call targets a single thread (usually thread 0 of a server that
+/// only has one thread), which must be in a process in the caller's own
+/// process list. Calling a VM app in another process list is not
+/// supported.
+///
+struct ipc_msg_t
+{
+    uint64_t w0;
+    uint64_t w1;
+    uint64_t w2;
+};
+
+/// Batch Operation
+///
+/// One of the operations run by vmcall__batch. args are the same as the
+/// arguments of the matching vmcall, in order (e.g. for
+/// BATCH_OP_VM_MAP_LOOKUP, the arguments of vmcall__vm_map_foreign_lookup),
+/// and status and ret are filled in by the VMM (ret is only used by
+/// BATCH_OP_CREATE_THREAD, which returns the id of the new thread).
+///
+struct batch_op_t
+{
+    uint64_t op;
+    uint64_t status;
+    uint64_t ret;
+    uint64_t args[7];
+};
+
 void vmcall(struct vmcall_registers_t *regs);
 
 enum hyperkernel_vmcall_functions
@@ -60,6 +191,7 @@ enum hyperkernel_vmcall_functions
 
     hyperkernel_vmcall__create_vcpu = 0x201,
     hyperkernel_vmcall__delete_vcpu = 0x202,
+    hyperkernel_vmcall__set_vcpu_pool_size = 0x203,
 
     hyperkernel_vmcall__create_process = 0x301,
     hyperkernel_vmcall__delete_process = 0x302,
@@ -68,24 +200,65 @@ enum hyperkernel_vmcall_functions
 
     hyperkernel_vmcall__vm_map = 0x401,
     hyperkernel_vmcall__vm_map_lookup = 0x402,
+    hyperkernel_vmcall__vm_map_lazy = 0x403,
 
     hyperkernel_vmcall__set_thread_info = 0x501,
 
+    hyperkernel_vmcall__create_shm = 0x601,
+    hyperkernel_vmcall__map_shm = 0x602,
+    hyperkernel_vmcall__unmap_shm = 0x603,
+    hyperkernel_vmcall__destroy_shm = 0x604,
+
+    hyperkernel_vmcall__get_memory_usage = 0x701,
+    hyperkernel_vmcall__set_memory_limits = 0x702,
+
+    hyperkernel_vmcall__set_numa_node = 0x801,
+    hyperkernel_vmcall__add_numa_frames = 0x802,
+    hyperkernel_vmcall__set_numa_policy = 0x803,
+    hyperkernel_vmcall__get_numa_stats = 0x804,
+
+    hyperkernel_vmcall__set_exception_handler = 0x901,
+
+    hyperkernel_vmcall__set_domain_pool_size = 0xA01,
+    hyperkernel_vmcall__create_domain = 0xA02,
+    hyperkernel_vmcall__delete_domain = 0xA03,
+
+    hyperkernel_vmcall__get_vmcs_stats = 0xB01,
+    hyperkernel_vmcall__get_vmcall_count = 0xB02,
+    hyperkernel_vmcall__get_vmcall_histogram = 0xB03,
+    hyperkernel_vmcall__get_exit_count = 0xB04,
+    hyperkernel_vmcall__get_exit_histogram = 0xB05,
+
+    hyperkernel_vmcall__set_event_handler = 0xC01,
+    hyperkernel_vmcall__inject_event = 0xC02,
+    hyperkernel_vmcall__event_return = 0xC03,
+
+    hyperkernel_vmcall__ipc_call = 0xD01,
+    hyperkernel_vmcall__ipc_reply_wait = 0xD02,
+
+    hyperkernel_vmcall__bind_channel = 0xE01,
+    hyperkernel_vmcall__notify_channel = 0xE02,
+
     hyperkernel_vmcall__sched_yield = 0x1001,
     hyperkernel_vmcall__sched_yield_and_remove = 0x1002,
+    hyperkernel_vmcall__sched_num_jobs = 0x1003,
 
     hyperkernel_vmcall__set_program_break = 0x1101,
     hyperkernel_vmcall__increase_program_break = 0x1102,
     hyperkernel_vmcall__decrease_program_break = 0x1103,
 
-    // TODO:
-    //
-    // These need to be made more generic
-    //
+    hyperkernel_vmcall__set_syscall_page = 0x1201,
+
+    hyperkernel_vmcall__batch = 0x1301,
 
     hyperkernel_vmcall__ttys0 = 0x2001,
     hyperkernel_vmcall__ttys1 = 0x2002,
-    hyperkernel_vmcall__register_ttys0 = 0x3001,
+    hyperkernel_vmcall__write = 0x2003,
+    hyperkernel_vmcall__write_ttys1 = 0x2004,
+
+    hyperkernel_vmcall__register_driver = 0x3001,
+    hyperkernel_vmcall__unregister_driver = 0x3002,
+    hyperkernel_vmcall__read_driver = 0x3003,
 
 };
 
@@ -243,6 +416,37 @@ vmcall__delete_foreign_process(uint64_t procltid, uint64_t processid)
     return regs.r01 == REG_SUCCESS;
 }
 
+inline bool
+vmcall__run_foreign_process(uint64_t procltid, uint64_t processid)
+{
+    struct vmcall_registers_t regs = struct_init;
+
+    regs.r00 = VMCALL_REGISTERS;
+    regs.r01 = VMCALL_MAGIC_NUMBER;
+    regs.r02 = hyperkernel_vmcall__run_process;                 // vmcall index
+    regs.r03 = procltid;                                        // process list id
+    regs.r04 = processid;                                       // process id
+
+    vmcall(&regs);
+
+    return regs.r01 == REG_SUCCESS;
+}
+
+inline bool
+vmcall__hlt_process(uint64_t cycles)
+{
+    struct vmcall_registers_t regs = struct_init;
+
+    regs.r00 = VMCALL_REGISTERS;
+    regs.r01 = VMCALL_MAGIC_NUMBER;
+    regs.r02 = hyperkernel_vmcall__hlt_process;                 // vmcall index
+    regs.r03 = cycles;                                          // TSC cycles to park for (0 == until woken)
+
+    vmcall(&regs);
+
+    return regs.r01 == REG_SUCCESS;
+}
+
 inline bool
 vmcall__vm_map_foreign(
     uint64_t procltid,
@@ -295,6 +499,32 @@ vmcall__vm_map_foreign_lookup(
     return regs.r01 == 0;
 }
 
+inline bool
+vmcall__vm_map_foreign_lazy(
+    uint64_t procltid,
+    uint64_t processid,
+    uint64_t virt,
+    uint64_t addr,
+    uint64_t size,
+    uint64_t perm)
+{
+    struct vmcall_registers_t regs = struct_init;
+
+    regs.r00 = VMCALL_REGISTERS;
+    regs.r01 = VMCALL_MAGIC_NUMBER;
+    regs.r02 = hyperkernel_vmcall__vm_map_lazy;                 // vmcall index
+    regs.r03 = procltid;                                        // process list id
+    regs.r04 = processid;                                       // process id
+    regs.r05 = virt;                                            // virtual address for the map
+    regs.r06 = addr;                                            // virtual address to lookup the physical addresses from (on first use)
+    regs.r07 = size;                                            // size of the map
+    regs.r08 = perm;                                            // permissions
+
+    vmcall(&regs);
+
+    return regs.r01 == 0;
+}
+
 inline bool
 vmcall__set_thread_info(
     uint64_t threadid,
@@ -349,28 +579,35 @@ vmcall__set_thread_foreign_info(
     return regs.r01 == 0;
 }
 
-inline bool
-vmcall__sched_yield()
+inline uint64_t
+vmcall__batch(struct batch_op_t *ops, uint64_t num)
 {
     struct vmcall_registers_t regs = struct_init;
 
     regs.r00 = VMCALL_REGISTERS;
     regs.r01 = VMCALL_MAGIC_NUMBER;
-    regs.r02 = hyperkernel_vmcall__sched_yield;                 // vmcall index
+    regs.r02 = hyperkernel_vmcall__batch;                       // vmcall index
+    regs.r03 = rcast(uint64_t, ops);                            // struct batch_op_t[num]
+    regs.r04 = num;                                             // number of operations (<= BATCH_MAX_OPS)
 
     vmcall(&regs);
 
-    return regs.r01 == REG_SUCCESS;
+    if (regs.r01 != REG_SUCCESS)
+        return REG_INVALID;
+
+    return regs.r03;                                            // number of operations that succeeded
 }
 
 inline bool
-vmcall__sched_yield_and_remove()
+vmcall__create_shm(uint64_t shmid, uint64_t size)
 {
     struct vmcall_registers_t regs = struct_init;
 
     regs.r00 = VMCALL_REGISTERS;
     regs.r01 = VMCALL_MAGIC_NUMBER;
-    regs.r02 = hyperkernel_vmcall__sched_yield_and_remove;      // vmcall index
+    regs.r02 = hyperkernel_vmcall__create_shm;                  // vmcall index
+    regs.r03 = shmid;                                           // shared memory id
+    regs.r04 = size;                                            // size of the region
 
     vmcall(&regs);
 
@@ -378,16 +615,18 @@ vmcall__sched_yield_and_remove()
 }
 
 inline bool
-vmcall__set_program_break(uint64_t program_break)
+vmcall__map_shm(uint64_t shmid, uint64_t virt, uint64_t perm)
 {
     struct vmcall_registers_t regs = struct_init;
 
     regs.r00 = VMCALL_REGISTERS;
     regs.r01 = VMCALL_MAGIC_NUMBER;
-    regs.r02 = hyperkernel_vmcall__set_program_break;           // vmcall index
+    regs.r02 = hyperkernel_vmcall__map_shm;                     // vmcall index
     regs.r03 = REG_CURRENT;                                     // process list id
     regs.r04 = REG_CURRENT;                                     // process id
-    regs.r05 = program_break;
+    regs.r05 = shmid;                                           // shared memory id
+    regs.r06 = virt;                                            // virtual address for the map
+    regs.r07 = perm;                                            // permissions
 
     vmcall(&regs);
 
@@ -395,15 +634,40 @@ vmcall__set_program_break(uint64_t program_break)
 }
 
 inline bool
-vmcall__increase_program_break()
+vmcall__map_foreign_shm(
+    uint64_t procltid,
+    uint64_t processid,
+    uint64_t shmid,
+    uint64_t virt,
+    uint64_t perm)
 {
     struct vmcall_registers_t regs = struct_init;
 
     regs.r00 = VMCALL_REGISTERS;
     regs.r01 = VMCALL_MAGIC_NUMBER;
-    regs.r02 = hyperkernel_vmcall__increase_program_break;      // vmcall index
+    regs.r02 = hyperkernel_vmcall__map_shm;                     // vmcall index
+    regs.r03 = procltid;                                        // process list id
+    regs.r04 = processid;                                       // process id
+    regs.r05 = shmid;                                           // shared memory id
+    regs.r06 = virt;                                            // virtual address for the map
+    regs.r07 = perm;                                            // permissions
+
+    vmcall(&regs);
+
+    return regs.r01 == REG_SUCCESS;
+}
+
+inline bool
+vmcall__unmap_shm(uint64_t virt)
+{
+    struct vmcall_registers_t regs = struct_init;
+
+    regs.r00 = VMCALL_REGISTERS;
+    regs.r01 = VMCALL_MAGIC_NUMBER;
+    regs.r02 = hyperkernel_vmcall__unmap_shm;                   // vmcall index
     regs.r03 = REG_CURRENT;                                     // process list id
     regs.r04 = REG_CURRENT;                                     // process id
+    regs.r05 = virt;                                            // virtual address of the map
 
     vmcall(&regs);
 
@@ -411,15 +675,16 @@ vmcall__increase_program_break()
 }
 
 inline bool
-vmcall__increase_foreign_program_break(uint64_t procltid, uint64_t processid)
+vmcall__unmap_foreign_shm(uint64_t procltid, uint64_t processid, uint64_t virt)
 {
     struct vmcall_registers_t regs = struct_init;
 
     regs.r00 = VMCALL_REGISTERS;
     regs.r01 = VMCALL_MAGIC_NUMBER;
-    regs.r02 = hyperkernel_vmcall__increase_program_break;      // vmcall index
+    regs.r02 = hyperkernel_vmcall__unmap_shm;                   // vmcall index
     regs.r03 = procltid;                                        // process list id
     regs.r04 = processid;                                       // process id
+    regs.r05 = virt;                                            // virtual address of the map
 
     vmcall(&regs);
 
@@ -427,15 +692,56 @@ vmcall__increase_foreign_program_break(uint64_t procltid, uint64_t processid)
 }
 
 inline bool
-vmcall__decrease_program_break()
+vmcall__destroy_shm(uint64_t shmid)
 {
     struct vmcall_registers_t regs = struct_init;
 
     regs.r00 = VMCALL_REGISTERS;
     regs.r01 = VMCALL_MAGIC_NUMBER;
-    regs.r02 = hyperkernel_vmcall__decrease_program_break;      // vmcall index
-    regs.r03 = REG_CURRENT;                                     // process list id
-    regs.r04 = REG_CURRENT;                                     // process id
+    regs.r02 = hyperkernel_vmcall__destroy_shm;                 // vmcall index
+    regs.r03 = shmid;                                           // shared memory id
+
+    vmcall(&regs);
+
+    return regs.r01 == REG_SUCCESS;
+}
+
+inline uint64_t
+vmcall__get_memory_usage(uint64_t procltid, uint64_t processid, uint64_t category)
+{
+    struct vmcall_registers_t regs = struct_init;
+
+    regs.r00 = VMCALL_REGISTERS;
+    regs.r01 = VMCALL_MAGIC_NUMBER;
+    regs.r02 = hyperkernel_vmcall__get_memory_usage;            // vmcall index
+    regs.r03 = procltid;                                        // process list id
+    regs.r04 = processid;                                       // process id (REG_INVALID == process list)
+    regs.r05 = category;                                        // MEM_CATEGORY_xxx
+
+    vmcall(&regs);
+
+    if (regs.r01 == 0)
+        return regs.r03;
+
+    return REG_INVALID;
+}
+
+inline bool
+vmcall__set_memory_limits(
+    uint64_t procltid,
+    uint64_t processid,
+    uint64_t soft_limit,
+    uint64_t hard_limit)
+{
+    struct vmcall_registers_t regs = struct_init;
+
+    regs.r00 = VMCALL_REGISTERS;
+    regs.r01 = VMCALL_MAGIC_NUMBER;
+    regs.r02 = hyperkernel_vmcall__set_memory_limits;           // vmcall index
+    regs.r03 = procltid;                                        // process list id
+    regs.r04 = processid;                                       // process id (REG_INVALID == process list)
+    regs.r05 = soft_limit;                                      // soft limit in bytes (0 == unlimited)
+    regs.r06 = hard_limit;                                      // hard limit in bytes (0 == unlimited)
 
     vmcall(&regs);
 
@@ -443,15 +749,91 @@ vmcall__decrease_program_break()
 }
 
 inline bool
-vmcall__decrease_foreign_program_break(uint64_t procltid, uint64_t processid)
+vmcall__set_numa_node(uint64_t coreid, uint64_t node)
 {
     struct vmcall_registers_t regs = struct_init;
 
     regs.r00 = VMCALL_REGISTERS;
     regs.r01 = VMCALL_MAGIC_NUMBER;
-    regs.r02 = hyperkernel_vmcall__decrease_program_break;      // vmcall index
+    regs.r02 = hyperkernel_vmcall__set_numa_node;               // vmcall index
+    regs.r03 = coreid;                                          // core id
+    regs.r04 = node;                                            // numa node
+
+    vmcall(&regs);
+
+    return regs.r01 == REG_SUCCESS;
+}
+
+inline bool
+vmcall__add_numa_frames(uint64_t node, uint64_t addr, uint64_t size)
+{
+    struct vmcall_registers_t regs = struct_init;
+
+    regs.r00 = VMCALL_REGISTERS;
+    regs.r01 = VMCALL_MAGIC_NUMBER;
+    regs.r02 = hyperkernel_vmcall__add_numa_frames;             // vmcall index
+    regs.r03 = node;                                            // numa node
+    regs.r04 = addr;                                            // virtual address to lookup the physical addresses from
+    regs.r05 = size;                                            // size of the memory to donate
+
+    vmcall(&regs);
+
+    return regs.r01 == REG_SUCCESS;
+}
+
+inline bool
+vmcall__set_numa_policy(
+    uint64_t procltid,
+    uint64_t processid,
+    uint64_t policy,
+    uint64_t node)
+{
+    struct vmcall_registers_t regs = struct_init;
+
+    regs.r00 = VMCALL_REGISTERS;
+    regs.r01 = VMCALL_MAGIC_NUMBER;
+    regs.r02 = hyperkernel_vmcall__set_numa_policy;             // vmcall index
+    regs.r03 = procltid;                                        // process list id
+    regs.r04 = processid;                                       // process id
+    regs.r05 = policy;                                          // NUMA_POLICY_xxx
+    regs.r06 = node;                                            // numa node (NUMA_POLICY_EXPLICIT_NODE)
+
+    vmcall(&regs);
+
+    return regs.r01 == REG_SUCCESS;
+}
+
+inline uint64_t
+vmcall__get_numa_stats(uint64_t procltid, uint64_t processid, uint64_t stat)
+{
+    struct vmcall_registers_t regs = struct_init;
+
+    regs.r00 = VMCALL_REGISTERS;
+    regs.r01 = VMCALL_MAGIC_NUMBER;
+    regs.r02 = hyperkernel_vmcall__get_numa_stats;              // vmcall index
     regs.r03 = procltid;                                        // process list id
     regs.r04 = processid;                                       // process id
+    regs.r05 = stat;                                            // NUMA_STAT_xxx
+
+    vmcall(&regs);
+
+    if (regs.r01 == 0)
+        return regs.r03;
+
+    return REG_INVALID;
+}
+
+inline bool
+vmcall__set_exception_handler(uintptr_t handler)
+{
+    struct vmcall_registers_t regs = struct_init;
+
+    regs.r00 = VMCALL_REGISTERS;
+    regs.r01 = VMCALL_MAGIC_NUMBER;
+    regs.r02 = hyperkernel_vmcall__set_exception_handler;       // vmcall index
+    regs.r03 = REG_CURRENT;                                     // process list id
+    regs.r04 = REG_CURRENT;                                     // process id
+    regs.r05 = handler;                                         // void (*)(struct exception_frame_t *)
 
     vmcall(&regs);
 
@@ -459,14 +841,17 @@ vmcall__decrease_foreign_program_break(uint64_t procltid, uint64_t processid)
 }
 
 inline bool
-vmcall__ttys0(char val)
+vmcall__set_event_handler(uintptr_t handler)
 {
     struct vmcall_registers_t regs = struct_init;
 
     regs.r00 = VMCALL_REGISTERS;
     regs.r01 = VMCALL_MAGIC_NUMBER;
-    regs.r02 = hyperkernel_vmcall__ttys0;
-    regs.r03 = scast(uintptr_t, val);
+    regs.r02 = hyperkernel_vmcall__set_event_handler;           // vmcall index
+    regs.r03 = REG_CURRENT;                                     // process list id
+    regs.r04 = REG_CURRENT;                                     // process id
+    regs.r05 = handler;                                         // void (*)(uint64_t events, uint64_t devices)
+    regs.r06 = REG_CURRENT;                                     // thread id (handlers are per thread)
 
     vmcall(&regs);
 
@@ -474,14 +859,17 @@ vmcall__ttys0(char val)
 }
 
 inline bool
-vmcall__ttys1(char val)
+vmcall__inject_event(uint64_t procltid, uint64_t processid, uint64_t threadid, uint64_t events)
 {
     struct vmcall_registers_t regs = struct_init;
 
     regs.r00 = VMCALL_REGISTERS;
     regs.r01 = VMCALL_MAGIC_NUMBER;
-    regs.r02 = hyperkernel_vmcall__ttys1;
-    regs.r03 = scast(uintptr_t, val);
+    regs.r02 = hyperkernel_vmcall__inject_event;                // vmcall index
+    regs.r03 = procltid;                                        // process list id
+    regs.r04 = processid;                                       // process id
+    regs.r05 = events;                                          // bitmap of events to post
+    regs.r06 = threadid;                                        // thread id (REG_CURRENT only for the caller)
 
     vmcall(&regs);
 
@@ -489,20 +877,522 @@ vmcall__ttys1(char val)
 }
 
 inline bool
-vmcall__register_ttys0(uintptr_t func)
+vmcall__event_return(void)
 {
     struct vmcall_registers_t regs = struct_init;
 
     regs.r00 = VMCALL_REGISTERS;
     regs.r01 = VMCALL_MAGIC_NUMBER;
-    regs.r02 = hyperkernel_vmcall__register_ttys0;
-    regs.r03 = func;
+    regs.r02 = hyperkernel_vmcall__event_return;                // vmcall index
 
     vmcall(&regs);
 
     return regs.r01 == REG_SUCCESS;
 }
 
+inline bool
+vmcall__ipc_call(uint64_t processid, uint64_t threadid, struct ipc_msg_t *msg)
+{
+    struct vmcall_registers_t regs = struct_init;
+
+    regs.r00 = VMCALL_REGISTERS;
+    regs.r01 = VMCALL_MAGIC_NUMBER;
+    regs.r02 = hyperkernel_vmcall__ipc_call;                    // vmcall index
+    regs.r03 = processid;                                       // server process id (same process list)
+    regs.r04 = msg->w0;                                         // request
+    regs.r05 = msg->w1;                                         // request
+    regs.r06 = msg->w2;                                         // request
+    regs.r07 = threadid;                                        // server thread id
+
+    vmcall(&regs);
+
+    if (regs.r01 != REG_SUCCESS)
+        return false;
+
+    msg->w0 = regs.r03;                                         // reply
+    msg->w1 = regs.r04;                                         // reply
+    msg->w2 = regs.r05;                                         // reply
+
+    return true;
+}
+
+inline bool
+vmcall__ipc_reply_wait(struct ipc_msg_t *msg)
+{
+    struct vmcall_registers_t regs = struct_init;
+
+    regs.r00 = VMCALL_REGISTERS;
+    regs.r01 = VMCALL_MAGIC_NUMBER;
+    regs.r02 = hyperkernel_vmcall__ipc_reply_wait;              // vmcall index
+    regs.r03 = msg->w0;                                         // reply (ignored if there is no caller)
+    regs.r04 = msg->w1;                                         // reply (ignored if there is no caller)
+    regs.r05 = msg->w2;                                         // reply (ignored if there is no caller)
+
+    vmcall(&regs);
+
+    if (regs.r01 != REG_SUCCESS)
+        return false;
+
+    msg->w0 = regs.r03;                                         // next request
+    msg->w1 = regs.r04;                                         // next request
+    msg->w2 = regs.r05;                                         // next request
+
+    return true;
+}
+
+inline bool
+vmcall__bind_channel(uint64_t shmid)
+{
+    struct vmcall_registers_t regs = struct_init;
+
+    regs.r00 = VMCALL_REGISTERS;
+    regs.r01 = VMCALL_MAGIC_NUMBER;
+    regs.r02 = hyperkernel_vmcall__bind_channel;                // vmcall index
+    regs.r03 = shmid;                                           // shared memory id of the channel
+
+    vmcall(&regs);
+
+    return regs.r01 == REG_SUCCESS;
+}
+
+inline bool
+vmcall__notify_channel(uint64_t shmid)
+{
+    struct vmcall_registers_t regs = struct_init;
+
+    regs.r00 = VMCALL_REGISTERS;
+    regs.r01 = VMCALL_MAGIC_NUMBER;
+    regs.r02 = hyperkernel_vmcall__notify_channel;              // vmcall index
+    regs.r03 = shmid;                                           // shared memory id of the channel
+
+    vmcall(&regs);
+
+    return regs.r01 == REG_SUCCESS;
+}
+
+inline bool
+vmcall__set_vcpu_pool_size(uint64_t size)
+{
+    struct vmcall_registers_t regs = struct_init;
+
+    regs.r00 = VMCALL_REGISTERS;
+    regs.r01 = VMCALL_MAGIC_NUMBER;
+    regs.r02 = hyperkernel_vmcall__set_vcpu_pool_size;          // vmcall index
+    regs.r03 = size;                                            // number of vcpus per core
+
+    vmcall(&regs);
+
+    return regs.r01 == REG_SUCCESS;
+}
+
+inline bool
+vmcall__set_domain_pool_size(uint64_t size)
+{
+    struct vmcall_registers_t regs = struct_init;
+
+    regs.r00 = VMCALL_REGISTERS;
+    regs.r01 = VMCALL_MAGIC_NUMBER;
+    regs.r02 = hyperkernel_vmcall__set_domain_pool_size;        // vmcall index
+    regs.r03 = size;                                            // number of domains
+
+    vmcall(&regs);
+
+    return regs.r01 == REG_SUCCESS;
+}
+
+inline uint64_t
+vmcall__create_domain(uint64_t max_process_lists, uint64_t max_vcpus, uint64_t max_memory)
+{
+    struct vmcall_registers_t regs = struct_init;
+
+    regs.r00 = VMCALL_REGISTERS;
+    regs.r01 = VMCALL_MAGIC_NUMBER;
+    regs.r02 = hyperkernel_vmcall__create_domain;               // vmcall index
+    regs.r03 = max_process_lists;                               // 0 == unlimited
+    regs.r04 = max_vcpus;                                       // 0 == unlimited
+    regs.r05 = max_memory;                                      // bytes, 0 == unlimited
+
+    vmcall(&regs);
+
+    if (regs.r01 == 0)
+        return regs.r03;
+
+    return REG_INVALID;
+}
+
+inline bool
+vmcall__delete_domain(uint64_t domainid)
+{
+    struct vmcall_registers_t regs = struct_init;
+
+    regs.r00 = VMCALL_REGISTERS;
+    regs.r01 = VMCALL_MAGIC_NUMBER;
+    regs.r02 = hyperkernel_vmcall__delete_domain;               // vmcall index
+    regs.r03 = domainid;                                        // domain id
+
+    vmcall(&regs);
+
+    return regs.r01 == REG_SUCCESS;
+}
+
+inline uint64_t
+vmcall__get_vmcs_stats(uint64_t stat)
+{
+    struct vmcall_registers_t regs = struct_init;
+
+    regs.r00 = VMCALL_REGISTERS;
+    regs.r01 = VMCALL_MAGIC_NUMBER;
+    regs.r02 = hyperkernel_vmcall__get_vmcs_stats;              // vmcall index
+    regs.r03 = stat;                                            // VMCS_STAT_xxx
+
+    vmcall(&regs);
+
+    if (regs.r01 == 0)
+        return regs.r03;
+
+    return REG_INVALID;
+}
+
+inline uint64_t
+vmcall__get_vmcall_count(uint64_t index)
+{
+    struct vmcall_registers_t regs = struct_init;
+
+    regs.r00 = VMCALL_REGISTERS;
+    regs.r01 = VMCALL_MAGIC_NUMBER;
+    regs.r02 = hyperkernel_vmcall__get_vmcall_count;            // vmcall index
+    regs.r03 = index;                                           // vmcall index to query
+
+    vmcall(&regs);
+
+    if (regs.r01 == 0)
+        return regs.r03;
+
+    return REG_INVALID;
+}
+
+inline uint64_t
+vmcall__get_vmcall_histogram(uint64_t index, uint64_t bucket)
+{
+    struct vmcall_registers_t regs = struct_init;
+
+    regs.r00 = VMCALL_REGISTERS;
+    regs.r01 = VMCALL_MAGIC_NUMBER;
+    regs.r02 = hyperkernel_vmcall__get_vmcall_histogram;        // vmcall index
+    regs.r03 = index;                                           // vmcall index to query
+    regs.r04 = bucket;                                          // calls that took [2^bucket, 2^(bucket+1)) cycles
+
+    vmcall(&regs);
+
+    if (regs.r01 == 0)
+        return regs.r03;
+
+    return REG_INVALID;
+}
+
+inline uint64_t
+vmcall__get_exit_count(uint64_t vcpuid, uint64_t reason)
+{
+    struct vmcall_registers_t regs = struct_init;
+
+    regs.r00 = VMCALL_REGISTERS;
+    regs.r01 = VMCALL_MAGIC_NUMBER;
+    regs.r02 = hyperkernel_vmcall__get_exit_count;              // vmcall index
+    regs.r03 = vcpuid;                                          // vcpu id (or REG_CURRENT)
+    regs.r04 = reason;                                          // basic exit reason
+
+    vmcall(&regs);
+
+    if (regs.r01 == 0)
+        return regs.r03;
+
+    return REG_INVALID;
+}
+
+inline uint64_t
+vmcall__get_exit_histogram(uint64_t vcpuid, uint64_t bucket)
+{
+    struct vmcall_registers_t regs = struct_init;
+
+    regs.r00 = VMCALL_REGISTERS;
+    regs.r01 = VMCALL_MAGIC_NUMBER;
+    regs.r02 = hyperkernel_vmcall__get_exit_histogram;          // vmcall index
+    regs.r03 = vcpuid;                                          // vcpu id (or REG_CURRENT)
+    regs.r04 = bucket;                                          // exits that took [2^bucket, 2^(bucket+1)) cycles
+
+    vmcall(&regs);
+
+    if (regs.r01 == 0)
+        return regs.r03;
+
+    return REG_INVALID;
+}
+
+inline bool
+vmcall__sched_yield()
+{
+    struct vmcall_registers_t regs = struct_init;
+
+    regs.r00 = VMCALL_REGISTERS;
+    regs.r01 = VMCALL_MAGIC_NUMBER;
+    regs.r02 = hyperkernel_vmcall__sched_yield;                 // vmcall index
+
+    vmcall(&regs);
+
+    return regs.r01 == REG_SUCCESS;
+}
+
+inline bool
+vmcall__sched_yield_and_remove()
+{
+    struct vmcall_registers_t regs = struct_init;
+
+    regs.r00 = VMCALL_REGISTERS;
+    regs.r01 = VMCALL_MAGIC_NUMBER;
+    regs.r02 = hyperkernel_vmcall__sched_yield_and_remove;      // vmcall index
+
+    vmcall(&regs);
+
+    return regs.r01 == REG_SUCCESS;
+}
+
+inline uint64_t
+vmcall__sched_num_jobs(uint64_t procltid)
+{
+    struct vmcall_registers_t regs = struct_init;
+
+    regs.r00 = VMCALL_REGISTERS;
+    regs.r01 = VMCALL_MAGIC_NUMBER;
+    regs.r02 = hyperkernel_vmcall__sched_num_jobs;              // vmcall index
+    regs.r03 = procltid;                                        // process list id
+
+    vmcall(&regs);
+
+    if (regs.r01 == 0)
+        return regs.r03;
+
+    return REG_INVALID;
+}
+
+inline bool
+vmcall__set_program_break(uint64_t program_break)
+{
+    struct vmcall_registers_t regs = struct_init;
+
+    regs.r00 = VMCALL_REGISTERS;
+    regs.r01 = VMCALL_MAGIC_NUMBER;
+    regs.r02 = hyperkernel_vmcall__set_program_break;           // vmcall index
+    regs.r03 = REG_CURRENT;                                     // process list id
+    regs.r04 = REG_CURRENT;                                     // process id
+    regs.r05 = program_break;
+
+    vmcall(&regs);
+
+    return regs.r01 == REG_SUCCESS;
+}
+
+inline bool
+vmcall__increase_program_break()
+{
+    struct vmcall_registers_t regs = struct_init;
+
+    regs.r00 = VMCALL_REGISTERS;
+    regs.r01 = VMCALL_MAGIC_NUMBER;
+    regs.r02 = hyperkernel_vmcall__increase_program_break;      // vmcall index
+    regs.r03 = REG_CURRENT;                                     // process list id
+    regs.r04 = REG_CURRENT;                                     // process id
+
+    vmcall(&regs);
+
+    return regs.r01 == REG_SUCCESS;
+}
+
+inline bool
+vmcall__increase_foreign_program_break(uint64_t procltid, uint64_t processid)
+{
+    struct vmcall_registers_t regs = struct_init;
+
+    regs.r00 = VMCALL_REGISTERS;
+    regs.r01 = VMCALL_MAGIC_NUMBER;
+    regs.r02 = hyperkernel_vmcall__increase_program_break;      // vmcall index
+    regs.r03 = procltid;                                        // process list id
+    regs.r04 = processid;                                       // process id
+
+    vmcall(&regs);
+
+    return regs.r01 == REG_SUCCESS;
+}
+
+inline bool
+vmcall__decrease_program_break()
+{
+    struct vmcall_registers_t regs = struct_init;
+
+    regs.r00 = VMCALL_REGISTERS;
+    regs.r01 = VMCALL_MAGIC_NUMBER;
+    regs.r02 = hyperkernel_vmcall__decrease_program_break;      // vmcall index
+    regs.r03 = REG_CURRENT;                                     // process list id
+    regs.r04 = REG_CURRENT;                                     // process id
+
+    vmcall(&regs);
+
+    return regs.r01 == REG_SUCCESS;
+}
+
+inline bool
+vmcall__decrease_foreign_program_break(uint64_t procltid, uint64_t processid)
+{
+    struct vmcall_registers_t regs = struct_init;
+
+    regs.r00 = VMCALL_REGISTERS;
+    regs.r01 = VMCALL_MAGIC_NUMBER;
+    regs.r02 = hyperkernel_vmcall__decrease_program_break;      // vmcall index
+    regs.r03 = procltid;                                        // process list id
+    regs.r04 = processid;                                       // process id
+
+    vmcall(&regs);
+
+    return regs.r01 == REG_SUCCESS;
+}
+
+inline bool
+vmcall__ttys0(char val)
+{
+    struct vmcall_registers_t regs = struct_init;
+
+    regs.r00 = VMCALL_REGISTERS;
+    regs.r01 = VMCALL_MAGIC_NUMBER;
+    regs.r02 = hyperkernel_vmcall__ttys0;
+    regs.r03 = scast(uintptr_t, val);
+
+    vmcall(&regs);
+
+    return regs.r01 == REG_SUCCESS;
+}
+
+inline bool
+vmcall__ttys1(char val)
+{
+    struct vmcall_registers_t regs = struct_init;
+
+    regs.r00 = VMCALL_REGISTERS;
+    regs.r01 = VMCALL_MAGIC_NUMBER;
+    regs.r02 = hyperkernel_vmcall__ttys1;
+    regs.r03 = scast(uintptr_t, val);
+
+    vmcall(&regs);
+
+    return regs.r01 == REG_SUCCESS;
+}
+
+inline uint64_t
+vmcall__write(const char *buf, uint64_t size)
+{
+    struct vmcall_registers_t regs = struct_init;
+
+    regs.r00 = VMCALL_REGISTERS;
+    regs.r01 = VMCALL_MAGIC_NUMBER;
+    regs.r02 = hyperkernel_vmcall__write;                       // vmcall index
+    regs.r03 = rcast(uintptr_t, buf);                           // buffer to write
+    regs.r04 = size;                                            // size of the buffer
+
+    vmcall(&regs);
+
+    if (regs.r01 != REG_SUCCESS)
+        return REG_INVALID;
+
+    return regs.r03;                                            // number of bytes written
+}
+
+inline uint64_t
+vmcall__write_ttys1(const char *buf, uint64_t size)
+{
+    struct vmcall_registers_t regs = struct_init;
+
+    regs.r00 = VMCALL_REGISTERS;
+    regs.r01 = VMCALL_MAGIC_NUMBER;
+    regs.r02 = hyperkernel_vmcall__write_ttys1;                 // vmcall index
+    regs.r03 = rcast(uintptr_t, buf);                           // buffer to write
+    regs.r04 = size;                                            // size of the buffer
+
+    vmcall(&regs);
+
+    if (regs.r01 != REG_SUCCESS)
+        return REG_INVALID;
+
+    return regs.r03;                                            // number of bytes written
+}
+
+inline bool
+vmcall__set_syscall_page(uintptr_t page)
+{
+    struct vmcall_registers_t regs = struct_init;
+
+    regs.r00 = VMCALL_REGISTERS;
+    regs.r01 = VMCALL_MAGIC_NUMBER;
+    regs.r02 = hyperkernel_vmcall__set_syscall_page;            // vmcall index
+    regs.r03 = page;                                            // struct syscall_page_t * (or 0 to stop)
+
+    vmcall(&regs);
+
+    return regs.r01 == REG_SUCCESS;
+}
+
+inline bool
+vmcall__register_driver(uint64_t deviceid, uintptr_t func)
+{
+    struct vmcall_registers_t regs = struct_init;
+
+    regs.r00 = VMCALL_REGISTERS;
+    regs.r01 = VMCALL_MAGIC_NUMBER;
+    regs.r02 = hyperkernel_vmcall__register_driver;             // vmcall index
+    regs.r03 = deviceid;                                        // device id (< DEVICE_MAX)
+    regs.r04 = func;                                            // void (*)(uint64_t events, uint64_t devices)
+
+    vmcall(&regs);
+
+    return regs.r01 == REG_SUCCESS;
+}
+
+inline bool
+vmcall__unregister_driver(uint64_t deviceid)
+{
+    struct vmcall_registers_t regs = struct_init;
+
+    regs.r00 = VMCALL_REGISTERS;
+    regs.r01 = VMCALL_MAGIC_NUMBER;
+    regs.r02 = hyperkernel_vmcall__unregister_driver;           // vmcall index
+    regs.r03 = deviceid;                                        // device id
+
+    vmcall(&regs);
+
+    return regs.r01 == REG_SUCCESS;
+}
+
+inline uint64_t
+vmcall__read_driver(uint64_t deviceid, char *buf, uint64_t size)
+{
+    struct vmcall_registers_t regs = struct_init;
+
+    regs.r00 = VMCALL_REGISTERS;
+    regs.r01 = VMCALL_MAGIC_NUMBER;
+    regs.r02 = hyperkernel_vmcall__read_driver;                 // vmcall index
+    regs.r03 = deviceid;                                        // device id
+    regs.r04 = rcast(uintptr_t, buf);                           // buffer to read into
+    regs.r05 = size;                                            // size of the buffer
+
+    vmcall(&regs);
+
+    if (regs.r01 != REG_SUCCESS)
+        return REG_INVALID;
+
+    return regs.r03;                                            // number of bytes read
+}
+
+inline bool
+vmcall__register_ttys0(uintptr_t func)
+{ return vmcall__register_driver(DEVICE_TTYS0, func); }
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,192 @@
+//
+// Bareflank Hyperkernel
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#ifndef VMCS_INTEL_X64_EXIT_STATS_H
+#define VMCS_INTEL_X64_EXIT_STATS_H
+
+#include <array>
+#include <mutex>
+#include <cstdint>
+
+#include <vcpuid.h>
+
+/// VMCS Exit Statistics
+///
+/// Per-vCPU counts of every VM exit by basic exit reason, and a histogram
+/// of the number of cycles from each exit to the next VM entry, in powers
+/// of 2 (i.e. bucket n counts exits that took [2^n, 2^(n+1)) cycles).
+///
+/// An exit is opened by begin_exit (at the start of handle_exit), and
+/// closed by end_exit, which is called when the VMCS is resumed, or when
+/// the vCPU gives up its core (e.g. on a yield). The latter keeps the time
+/// a vCPU spends parked out of its exit latency.
+///
+/// The statistics of every live vCPU can be looked up by vCPU ID (see
+/// attach), which is how they are reported to userspace.
+///
+class vmcs_intel_x64_exit_stats
+{
+public:
+
+    using value_type = uint64_t;
+
+    constexpr static const value_type num_reasons = 128;
+    constexpr static const value_type num_buckets = 32;
+
+    /// Default Constructor
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    vmcs_intel_x64_exit_stats() noexcept = default;
+
+    /// Destructor
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    virtual ~vmcs_intel_x64_exit_stats() = default;
+
+    /// Begin Exit
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param reason the basic exit reason of the exit
+    ///
+    virtual void begin_exit(value_type reason) noexcept
+    {
+        m_counts[reason < num_reasons ? reason : num_reasons - 1]++;
+        m_start = __builtin_ia32_rdtsc();
+    }
+
+    /// End Exit
+    ///
+    /// Records the latency of the current exit. Does nothing if there is
+    /// no exit in progress.
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    virtual void end_exit() noexcept;
+
+    /// Reset
+    ///
+    /// Clears the statistics (e.g. when a pooled vCPU is handed out again).
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    virtual void reset() noexcept
+    {
+        m_start = 0;
+        m_counts.fill(0);
+        m_histogram.fill(0);
+    }
+
+    /// Count
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param reason the basic exit reason
+    /// @return the number of exits with this reason (0 if reason is
+    ///     invalid). The last reason also counts reasons that are out of
+    ///     range.
+    ///
+    virtual value_type count(value_type reason) const noexcept
+    { return reason < num_reasons ? m_counts[reason] : 0; }
+
+    /// Histogram
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param bucket the histogram bucket
+    /// @return the number of exits that took [2^bucket, 2^(bucket+1))
+    ///     cycles (0 if bucket is invalid)
+    ///
+    virtual value_type histogram(value_type bucket) const noexcept
+    { return bucket < num_buckets ? m_histogram[bucket] : 0; }
+
+    /// Attach
+    ///
+    /// Makes these statistics visible to find() under vcpuid.
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param vcpuid the vCPU that owns these statistics
+    ///
+    virtual void attach(vcpuid::type vcpuid);
+
+    /// Detach
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param vcpuid the vCPU that owns these statistics
+    ///
+    virtual void detach(vcpuid::type vcpuid) noexcept;
+
+    /// Count (by vCPU)
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param vcpuid the vCPU to query
+    /// @param reason the basic exit reason
+    /// @param ret the result
+    /// @return false if vcpuid has no statistics attached, true otherwise
+    ///
+    static bool count(vcpuid::type vcpuid, value_type reason, value_type &ret);
+
+    /// Histogram (by vCPU)
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param vcpuid the vCPU to query
+    /// @param bucket the histogram bucket
+    /// @param ret the result
+    /// @return false if vcpuid has no statistics attached, true otherwise
+    ///
+    static bool histogram(vcpuid::type vcpuid, value_type bucket, value_type &ret);
+
+private:
+
+    value_type m_start{0};
+
+    std::array<value_type, num_reasons> m_counts{};
+    std::array<value_type, num_buckets> m_histogram{};
+
+public:
+
+    friend class hyperkernel_ut;
+
+    vmcs_intel_x64_exit_stats(vmcs_intel_x64_exit_stats &&) = delete;
+    vmcs_intel_x64_exit_stats &operator=(vmcs_intel_x64_exit_stats &&) = delete;
+
+    vmcs_intel_x64_exit_stats(const vmcs_intel_x64_exit_stats &) = delete;
+    vmcs_intel_x64_exit_stats &operator=(const vmcs_intel_x64_exit_stats &) = delete;
+};
+
+#endif
@@ -0,0 +1,201 @@
+//
+// Bareflank Hyperkernel
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#ifndef VMCS_INTEL_X64_FIELD_CACHE_H
+#define VMCS_INTEL_X64_FIELD_CACHE_H
+
+#include <cstdint>
+
+/// VMCS Field Cache
+///
+/// A per-vCPU shadow of the VMCS fields that the hyperkernel's exit and
+/// schedule paths touch the most. Reads are served from the shadow once a
+/// field has been read, and writes of a value the field already has are
+/// dropped, so each field costs at most one VMREAD and one VMWRITE per
+/// exit.
+///
+/// The shadow tracks three kinds of fields:
+///
+/// - exit information (e.g. the exit qualification), which is only valid
+///   for the exit it was read in
+/// - guest state (e.g. CR0), which the guest can change while it runs, and
+///   is therefore also invalidated on every exit
+/// - controls (e.g. the EPTP), which only the VMM writes, and therefore
+///   stay valid until the VMCS is launched again (write_fields writes them
+///   without going through the cache)
+///
+/// Note that the cache must only be used while its vCPU's VMCS is loaded.
+///
+class vmcs_intel_x64_field_cache
+{
+public:
+
+    using value_type = uint64_t;
+
+    /// Statistics
+    ///
+    /// Counts of the VMREADs / VMWRITEs that were issued, and the ones
+    /// that the cache saved.
+    ///
+    struct stats_type
+    {
+        uint64_t exits;
+        uint64_t vmreads;
+        uint64_t vmwrites;
+        uint64_t vmreads_saved;
+        uint64_t vmwrites_saved;
+    };
+
+    /// Default Constructor
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    vmcs_intel_x64_field_cache() noexcept = default;
+
+    /// Destructor
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    virtual ~vmcs_intel_x64_field_cache() = default;
+
+    /// Begin Exit
+    ///
+    /// Invalidates the exit information and guest state. Must be called
+    /// at the start of every exit.
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    virtual void begin_exit() noexcept;
+
+    /// Invalidate
+    ///
+    /// Invalidates everything, including the controls. Must be called
+    /// when the VMCS is (re)launched.
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    virtual void invalidate() noexcept;
+
+    virtual value_type exit_qualification();
+    virtual value_type guest_physical_address();
+    virtual value_type vm_exit_interruption_information();
+
+    virtual value_type guest_cr0();
+    virtual void set_guest_cr0(value_type val);
+
+    virtual value_type guest_cr3();
+    virtual void set_guest_cr3(value_type val);
+
+    /// Update EPTP
+    ///
+    /// The EPTP is written by vmcs_intel_x64_eapis::set_eptp, so the cache
+    /// only decides if the write is needed.
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param eptp the EPTP that is about to be written
+    /// @return true if eptp differs from the EPTP in the VMCS (and so the
+    ///     caller must write it), false otherwise
+    ///
+    virtual bool update_eptp(value_type eptp) noexcept;
+
+    /// Update VPID
+    ///
+    /// @see update_eptp
+    ///
+    virtual bool update_vpid(value_type vpid) noexcept;
+
+    /// Statistics
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @return the cache's statistics
+    ///
+    virtual const stats_type &stats() const noexcept
+    { return m_stats; }
+
+private:
+
+    struct field
+    {
+        bool m_valid;
+        value_type m_value;
+    };
+
+    template<class R>
+    value_type __read(field &f, R &&vmread)
+    {
+        if (f.m_valid)
+        {
+            m_stats.vmreads_saved++;
+            return f.m_value;
+        }
+
+        f.m_value = vmread();
+        f.m_valid = true;
+
+        m_stats.vmreads++;
+        return f.m_value;
+    }
+
+    template<class W>
+    void __write(field &f, value_type val, W &&vmwrite)
+    {
+        if (!__update(f, val))
+            return;
+
+        vmwrite(val);
+    }
+
+    bool __update(field &f, value_type val) noexcept;
+
+private:
+
+    field m_exit_qualification{};
+    field m_guest_physical_address{};
+    field m_vm_exit_interruption_information{};
+
+    field m_guest_cr0{};
+    field m_guest_cr3{};
+
+    field m_eptp{};
+    field m_vpid{};
+
+    stats_type m_stats{};
+
+public:
+
+    friend class hyperkernel_ut;
+
+    vmcs_intel_x64_field_cache(vmcs_intel_x64_field_cache &&) = default;
+    vmcs_intel_x64_field_cache &operator=(vmcs_intel_x64_field_cache &&) = default;
+
+    vmcs_intel_x64_field_cache(const vmcs_intel_x64_field_cache &) = delete;
+    vmcs_intel_x64_field_cache &operator=(const vmcs_intel_x64_field_cache &) = delete;
+};
+
+#endif
@@ -120,6 +120,15 @@ public:
     gsl::not_null<domain_intel_x64 *> get_domain() const
     { return m_domain; }
 
+    void rebind(
+        gsl::not_null<process_list *> proclt,
+        gsl::not_null<domain_intel_x64 *> domain)
+    {
+        m_proclt = proclt;
+        m_domain = domain;
+        m_cr3 = m_domain->cr3();
+    }
+
     void dump() const override
     {
         bfdebug << "----------------------------------------" << bfendl;
@@ -27,9 +27,12 @@
 #include <coreid.h>
 #include <vcpuid.h>
 #include <vmcs/vmcs_intel_x64_eapis.h>
+#include <vmcs/vmcs_intel_x64_exit_stats.h>
+#include <vmcs/vmcs_intel_x64_field_cache.h>
 
 class process_list;
 class domain_intel_x64;
+class thread_intel_x64;
 
 class vmcs_intel_x64_hyperkernel : public vmcs_intel_x64_eapis
 {
@@ -51,7 +54,18 @@ public:
     /// @expects
     /// @ensures
     ///
-    ~vmcs_intel_x64_hyperkernel() override  = default;
+    ~vmcs_intel_x64_hyperkernel() override;
+
+    /// Resume
+    ///
+    /// Closes the current exit in the exit statistics (see
+    /// vmcs_intel_x64_exit_stats), and delivers the current thread's
+    /// pending events (see thread_intel_x64::deliver_events) before
+    /// resuming the guest.
+    ///
+    /// @see vmcs_intel_x64::resume
+    ///
+    void resume() override;
 
     /// Get Core ID
     ///
@@ -93,6 +107,66 @@ public:
     virtual gsl::not_null<domain_intel_x64 *> get_domain() const
     { return m_domain; }
 
+    /// Get Field Cache
+    ///
+    /// @expects none
+    /// @ensures ret != nullptr
+    ///
+    /// @return returns the shadow of this vmcs's hot fields
+    ///
+    virtual gsl::not_null<vmcs_intel_x64_field_cache *> field_cache()
+    { return &m_field_cache; }
+
+    /// Get Exit Statistics
+    ///
+    /// @expects none
+    /// @ensures ret != nullptr
+    ///
+    /// @return returns the exit statistics of this vmcs's vCPU
+    ///
+    virtual gsl::not_null<vmcs_intel_x64_exit_stats *> exit_stats()
+    { return &m_exit_stats; }
+
+    /// Set VPID
+    ///
+    /// Changes the VPID that tags the guest's TLB entries. If the VMCS has
+    /// not been launched yet, the VPID is written when it is.
+    ///
+    /// @expects vpid != 0
+    /// @ensures none
+    ///
+    /// @param vpid the VPID of the process being scheduled
+    /// @param launched true if the VMCS is loaded and launched
+    ///
+    virtual void set_vpid(uint16_t vpid, bool launched);
+
+    /// Set Current Thread
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param thrd the thread that this vmcs is about to run, or nullptr
+    ///
+    virtual void set_current_thread(thread_intel_x64 *thrd)
+    { m_thread = thrd; }
+
+    /// Rebind
+    ///
+    /// Moves this vmcs to another process list / domain (see
+    /// vcpu_intel_x64_hyperkernel::rebind).
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    /// @param proclt the new process list
+    /// @param domain the new domain
+    /// @param vcpuid the vCPU's new id
+    ///
+    virtual void rebind(
+        gsl::not_null<process_list *> proclt,
+        gsl::not_null<domain_intel_x64 *> domain,
+        vcpuid::type vcpuid);
+
 protected:
 
     void write_fields(gsl::not_null<vmcs_intel_x64_state *> host_state,
@@ -105,6 +179,11 @@ private:
     gsl::not_null<process_list *> m_proclt;
     gsl::not_null<domain_intel_x64 *> m_domain;
 
+    uint16_t m_vpid;
+    thread_intel_x64 *m_thread;
+    vmcs_intel_x64_field_cache m_field_cache;
+    vmcs_intel_x64_exit_stats m_exit_stats;
+
 public:
 
     friend class hyperkernel_ut;
@@ -0,0 +1,222 @@
+//
+// Bareflank Hyperkernel
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#ifndef VPID_ALLOCATOR_H
+#define VPID_ALLOCATOR_H
+
+#include <map>
+#include <array>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <string>
+#include <stdexcept>
+
+#include <coreid.h>
+#include <intrinsics/vmx_intel_x64.h>
+
+/// VPID Allocator
+///
+/// Hands out the VPIDs that tag each process's TLB entries, so that
+/// switching a vCPU from one process to another does not mix (or require
+/// flushing) cached translations. Bareflank assigns the VPIDs of the
+/// vCPUs themselves from the bottom of the VPID space, so processes are
+/// given VPIDs from the top half.
+///
+/// Released VPIDs are invalidated (INVVPID single context) before they are
+/// recycled, so the next process to get the VPID never sees the previous
+/// process's translations. INVVPID only affects the core that executes it,
+/// and a process's translations can be cached on any core that ran it, so
+/// a released VPID is queued on every core that has run a process (see
+/// flush), and is only recycled once each of them has invalidated it.
+///
+class vpid_allocator
+{
+public:
+
+    using vpid_type = uint16_t;
+
+    constexpr static const vpid_type first = 0x8000;
+    constexpr static const vpid_type last = 0xFFFF;
+
+    constexpr static const coreid::type max_cores = 256;
+
+    /// Destructor
+    ///
+    /// @expects none
+    /// @ensures none
+    ///
+    virtual ~vpid_allocator() = default;
+
+    /// Get Singleton Instance
+    ///
+    /// @expects none
+    /// @ensures ret != nullptr
+    ///
+    /// Get an instance to the singleton class.
+    ///
+    static vpid_allocator *instance() noexcept
+    {
+        static vpid_allocator self;
+        return &self;
+    }
+
+    /// Acquire
+    ///
+    /// @expects none
+    /// @ensures ret >= first
+    ///
+    /// @return a VPID that is not used by any other process
+    ///
+    vpid_type acquire()
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        if (!m_free.empty())
+        {
+            auto vpid = m_free.back();
+            m_free.pop_back();
+
+            return vpid;
+        }
+
+        if (m_next == 0)
+            throw std::runtime_error("out of vpids: " + std::to_string(last - first + 1));
+
+        auto &&vpid = m_next;
+        m_next = (m_next == last) ? 0 : static_cast<vpid_type>(m_next + 1);
+
+        return vpid;
+    }
+
+    /// Release
+    ///
+    /// Queues the VPID to be invalidated on every core that has called
+    /// flush. The VPID is recycled once all of them have. If no core has
+    /// run a process yet, the VPID is recycled right away.
+    ///
+    /// @expects vpid was returned by acquire
+    /// @ensures none
+    ///
+    /// @param vpid the VPID to release
+    ///
+    void release(vpid_type vpid)
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        auto cores = 0UL;
+
+        for (auto coreid = 0UL; coreid < max_cores; coreid++)
+        {
+            if (!m_cores.at(coreid).m_registered.load(std::memory_order_relaxed))
+                continue;
+
+            m_cores.at(coreid).m_pending.push_back(vpid);
+            m_cores.at(coreid).m_has_pending.store(true, std::memory_order_release);
+
+            cores++;
+        }
+
+        if (cores == 0)
+            m_free.push_back(vpid);
+        else
+            m_remaining[vpid] = cores;
+    }
+
+    /// Flush
+    ///
+    /// Invalidates the VPIDs that were released since this core last
+    /// called flush. This must be called on a core before it runs a
+    /// process (i.e. before each VM entry into a process), as that is
+    /// what registers the core with this allocator. After the first call,
+    /// this is a single load unless a VPID was released.
+    ///
+    /// @expects coreid < max_cores, and coreid is the calling core
+    /// @ensures none
+    ///
+    /// @param coreid the core calling flush
+    ///
+    void flush(coreid::type coreid)
+    {
+        auto &&core = m_cores.at(coreid);
+
+        if (core.m_registered.load(std::memory_order_relaxed) &&
+            !core.m_has_pending.load(std::memory_order_acquire))
+        {
+            return;
+        }
+
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        core.m_registered.store(true, std::memory_order_relaxed);
+        core.m_has_pending.store(false, std::memory_order_relaxed);
+
+        for (const auto &vpid : core.m_pending)
+        {
+            intel_x64::vmx::invvpid_single_context(vpid);
+
+            auto &&iter = m_remaining.find(vpid);
+            if (--iter->second == 0)
+            {
+                m_free.push_back(vpid);
+                m_remaining.erase(iter);
+            }
+        }
+
+        core.m_pending.clear();
+    }
+
+private:
+
+    vpid_allocator() :
+        m_next(first)
+    { }
+
+private:
+
+    struct core_t
+    {
+        std::atomic<bool> m_registered{false};
+        std::atomic<bool> m_has_pending{false};
+
+        std::vector<vpid_type> m_pending;
+    };
+
+    std::mutex m_mutex;
+
+    vpid_type m_next;
+    std::vector<vpid_type> m_free;
+
+    std::map<vpid_type, std::size_t> m_remaining;
+    std::array<core_t, max_cores> m_cores;
+
+public:
+
+    friend class hyperkernel_ut;
+
+    vpid_allocator(vpid_allocator &&) = delete;
+    vpid_allocator &operator=(vpid_allocator &&) = delete;
+
+    vpid_allocator(const vpid_allocator &) = delete;
+    vpid_allocator &operator=(const vpid_allocator &) = delete;
+};
+
+#endif
@@ -25,14 +25,17 @@
 
 PARENT_SUBDIRS += domain
 PARENT_SUBDIRS += domain_factory
+PARENT_SUBDIRS += driver
 PARENT_SUBDIRS += entry
 PARENT_SUBDIRS += exit_handler
+PARENT_SUBDIRS += frame_allocator
 PARENT_SUBDIRS += process
 PARENT_SUBDIRS += process_factory
 PARENT_SUBDIRS += process_list
 PARENT_SUBDIRS += process_list_factory
 PARENT_SUBDIRS += scheduler
 PARENT_SUBDIRS += scheduler_factory
+PARENT_SUBDIRS += shared_memory
 PARENT_SUBDIRS += task
 PARENT_SUBDIRS += thread
 PARENT_SUBDIRS += thread_factory
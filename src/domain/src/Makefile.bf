@@ -67,6 +67,7 @@ NATIVE_OUTDIR+=%BUILD_REL%/../bin
 SOURCES+=domain.cpp
 SOURCES+=domain_intel_x64.cpp
 SOURCES+=domain_manager.cpp
+SOURCES+=exception_stub_x64.asm
 
 INCLUDE_PATHS+=../../../include
 INCLUDE_PATHS+=%HYPER_ABS%/include/
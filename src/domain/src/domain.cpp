@@ -26,7 +26,11 @@
 
 domain::domain(domainid::type id) :
     m_id(id),
-    m_is_initialized(false)
+    m_is_initialized(false),
+    m_max_process_lists(0),
+    m_max_vcpus(0),
+    m_num_process_lists(0),
+    m_num_vcpus(0)
 {
     if ((id & domainid::reserved) != 0)
         throw std::invalid_argument("invalid domainid");
@@ -47,3 +51,71 @@ domain::fini(user_data *data)
 
     m_is_initialized = false;
 }
+
+void
+domain::set_quotas(
+    std::size_t max_process_lists,
+    std::size_t max_vcpus,
+    memory_account::size_type max_memory)
+{
+    std::lock_guard<std::mutex> guard(m_quota_mutex);
+
+    m_max_process_lists = max_process_lists;
+    m_max_vcpus = max_vcpus;
+
+    m_account.set_limits(0, max_memory);
+}
+
+void
+domain::acquire_process_list()
+{
+    std::lock_guard<std::mutex> guard(m_quota_mutex);
+
+    if (m_max_process_lists != 0 && m_num_process_lists >= m_max_process_lists)
+        throw std::runtime_error("domain process list quota reached: " + std::to_string(m_max_process_lists));
+
+    m_num_process_lists++;
+}
+
+void
+domain::release_process_list()
+{
+    std::lock_guard<std::mutex> guard(m_quota_mutex);
+
+    expects(m_num_process_lists != 0);
+    m_num_process_lists--;
+}
+
+void
+domain::acquire_vcpu()
+{
+    std::lock_guard<std::mutex> guard(m_quota_mutex);
+
+    if (m_max_vcpus != 0 && m_num_vcpus >= m_max_vcpus)
+        throw std::runtime_error("domain vcpu quota reached: " + std::to_string(m_max_vcpus));
+
+    m_num_vcpus++;
+}
+
+void
+domain::release_vcpu()
+{
+    std::lock_guard<std::mutex> guard(m_quota_mutex);
+
+    expects(m_num_vcpus != 0);
+    m_num_vcpus--;
+}
+
+std::size_t
+domain::num_process_lists() const
+{
+    std::lock_guard<std::mutex> guard(m_quota_mutex);
+    return m_num_process_lists;
+}
+
+std::size_t
+domain::num_vcpus() const
+{
+    std::lock_guard<std::mutex> guard(m_quota_mutex);
+    return m_num_vcpus;
+}
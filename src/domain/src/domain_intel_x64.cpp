@@ -22,6 +22,10 @@
 #include <debug.h>
 #include <upper_lower.h>
 
+#include <gsl/gsl>
+
+#include <cstring>
+
 #include <domain/domain_intel_x64.h>
 #include <memory_manager/memory_manager_x64.h>
 
@@ -29,6 +33,93 @@
 
 using namespace x64;
 
+// -----------------------------------------------------------------------------
+// Shared Page Tables
+// -----------------------------------------------------------------------------
+
+constexpr const auto gdt_base_virt = 0x0000000100001000UL;
+constexpr const auto idt_base_virt = 0x0000000100002000UL;
+constexpr const auto tss_base_virt = 0x0000000100003000UL;
+constexpr const auto exception_stub_base_virt = 0x0000000100004000UL;
+
+extern "C" char exception_stub_begin[];
+extern "C" char exception_stub_end[];
+
+// Note:
+//
+// The guest page tables only contain a 4G identity map, and the GDT, IDT
+// and TSS are mapped virt -> virt (it is the EPT of each process that maps
+// the virt address to a domain's physical pages). This means the page
+// tables are the same for every domain, so they are built once, and shared
+// by all domains.
+//
+// Since the tables are shared, the EPT of each process maps them read-only.
+// The accessed and dirty bits of every entry are set up front so that the
+// CPU never has to write to the tables during a page walk.
+//
+
+struct shared_page_tables
+{
+    std::unique_ptr<root_page_table_x64> m_root_pt;
+    domain_intel_x64::memory_descriptor_list m_cr3_mdl;
+};
+
+static void
+set_accessed_and_dirty(const domain_intel_x64::memory_descriptor_list &mdl)
+{
+    for (const auto &md : mdl)
+    {
+        auto &&entries = gsl::span<uint64_t>(reinterpret_cast<uint64_t *>(md.virt), 512);
+
+        for (auto &entry : entries)
+        {
+            if ((entry & 0x1UL) != 0)
+                entry |= 0x60UL;
+        }
+    }
+}
+
+static shared_page_tables &
+get_shared_page_tables()
+{
+    static shared_page_tables self = []
+    {
+        shared_page_tables spt;
+
+        spt.m_root_pt = std::make_unique<root_page_table_x64>();
+        spt.m_root_pt->setup_identity_map_1g(0x0, 0x100000000);
+
+        /// TODO: Need to change the permissions of each entry such that they are
+        /// set to U/S
+        ///
+        spt.m_root_pt->map_4k(gdt_base_virt, gdt_base_virt, x64::memory_attr::rw_wb);
+        spt.m_root_pt->map_4k(idt_base_virt, idt_base_virt, x64::memory_attr::rw_wb);
+        spt.m_root_pt->map_4k(tss_base_virt, tss_base_virt, x64::memory_attr::rw_wb);
+        spt.m_root_pt->map_4k(exception_stub_base_virt, exception_stub_base_virt, x64::memory_attr::re_wb);
+
+        // Note:
+        //
+        // The exception info page and the exception stack are private to
+        // each process, but the addresses are the same, so they are mapped
+        // here as well (see domain_intel_x64::exception_info_virt).
+        //
+
+        for (auto page = 0x0000000100005000UL; page < 0x0000000100008000UL; page += 0x1000)
+            spt.m_root_pt->map_4k(page, page, x64::memory_attr::rw_wb);
+
+        spt.m_cr3_mdl = spt.m_root_pt->pt_to_mdl();
+        set_accessed_and_dirty(spt.m_cr3_mdl);
+
+        return spt;
+    }();
+
+    return self;
+}
+
+// -----------------------------------------------------------------------------
+// Implementation
+// -----------------------------------------------------------------------------
+
 domain_intel_x64::domain_intel_x64(domainid::type id) :
     domain(id),
     m_vmapp_gdt{512},
@@ -40,7 +131,9 @@ domain_intel_x64::domain_intel_x64(domainid::type id) :
     m_tss_base_virt{0},
     m_gdt_base_virt{0},
     m_idt_base_virt{0},
-    m_root_pt{std::make_unique<root_page_table_x64>()}
+    m_exception_stub{std::make_unique<char[]>(0x1000)},
+    m_exception_stub_base_phys{0},
+    m_exception_stub_base_virt{0}
 { }
 
 void
@@ -52,9 +145,9 @@ domain_intel_x64::init(user_data *data)
     m_idt_base_phys = g_mm->virtint_to_physint(m_vmapp_idt.base());
     m_tss_base_phys = g_mm->virtptr_to_physint(m_vmapp_tss.get());
 
-    m_gdt_base_virt = 0x0000000100001000UL;
-    m_idt_base_virt = 0x0000000100002000UL;
-    m_tss_base_virt = 0x0000000100003000UL;
+    m_gdt_base_virt = gdt_base_virt;
+    m_idt_base_virt = idt_base_virt;
+    m_tss_base_virt = tss_base_virt;
 
     expects(bfn::lower(m_gdt_base_phys) == 0);
     expects(bfn::lower(m_idt_base_phys) == 0);
@@ -78,18 +171,10 @@ domain_intel_x64::init(user_data *data)
     m_vmapp_gdt.set_limit(4, 0xFFFFFFFF);
     m_vmapp_gdt.set_limit(5, 0x1000);
 
-    m_root_pt->setup_identity_map_1g(0x0, 0x100000000);
+    this->init_exception_stub();
+    this->init_idt();
 
-    /// TODO: Need to change the permissions of each entry such that they are
-    /// set to U/S
-    ///
-    /// Can we use read-only?
-    ///
-    m_root_pt->map_4k(m_gdt_base_virt, m_gdt_base_virt, x64::memory_attr::rw_wb);
-    m_root_pt->map_4k(m_idt_base_virt, m_idt_base_virt, x64::memory_attr::rw_wb);
-    m_root_pt->map_4k(m_tss_base_virt, m_tss_base_virt, x64::memory_attr::rw_wb);
-
-    m_cr3_mdl = m_root_pt->pt_to_mdl();
+    get_shared_page_tables();
 
     bfdebug << "domain init: " << id() << '\n';
     domain::init(data);
@@ -101,3 +186,68 @@ domain_intel_x64::fini(user_data *data)
     bfdebug << "domain fini: " << id() << '\n';
     domain::fini(data);
 }
+
+void
+domain_intel_x64::init_exception_stub()
+{
+    auto &&stub = gsl::span<char>(exception_stub_begin, exception_stub_end - exception_stub_begin);
+    auto &&page = gsl::span<char>(m_exception_stub.get(), 0x1000);
+
+    expects(stub.size() <= page.size());
+    memcpy(page.data(), stub.data(), static_cast<std::size_t>(stub.size()));
+
+    m_exception_stub_base_phys = g_mm->virtptr_to_physint(m_exception_stub.get());
+    m_exception_stub_base_virt = exception_stub_base_virt;
+
+    expects(bfn::lower(m_exception_stub_base_phys) == 0);
+}
+
+void
+domain_intel_x64::init_idt()
+{
+    // Note:
+    //
+    // Each of the first 32 vectors (the exceptions) gets a 64bit interrupt
+    // gate (present, DPL 0, type 0xE) that points to the vector's entry in
+    // the exception stub, and uses IST1 so that the stub always runs on a
+    // good stack. The rest of the vectors are left not present.
+    //
+
+    constexpr const auto num_exceptions = 32UL;
+    constexpr const auto stub_entry_size = 16UL;
+    constexpr const auto cs_selector = 1UL << 3;
+    constexpr const auto ist = 1UL;
+    constexpr const auto type_attr = 0x8EUL;
+
+    auto &&idt = gsl::span<uint64_t>(
+                     reinterpret_cast<uint64_t *>(m_vmapp_idt.base()),
+                     gsl::narrow_cast<std::ptrdiff_t>((m_vmapp_idt.limit() + 1) / sizeof(uint64_t)));
+
+    for (auto vector = 0UL; vector < num_exceptions; vector++)
+    {
+        auto &&offset = m_exception_stub_base_virt + (vector * stub_entry_size);
+
+        auto &&low = (offset & 0xFFFFUL) |
+                     (cs_selector << 16) |
+                     (ist << 32) |
+                     (type_attr << 40) |
+                     (((offset >> 16) & 0xFFFFUL) << 48);
+
+        idt.at(gsl::narrow_cast<std::ptrdiff_t>(vector * 2) + 0) = low;
+        idt.at(gsl::narrow_cast<std::ptrdiff_t>(vector * 2) + 1) = offset >> 32;
+    }
+
+    // IST1 lives at offset 0x24 of the 64bit TSS, which is not 8 byte
+    // aligned, hence the memcpy.
+
+    auto &&ist1 = exception_stack_virt() + exception_stack_size();
+    memcpy(reinterpret_cast<char *>(m_vmapp_tss.get()) + 0x24, &ist1, sizeof(ist1));
+}
+
+domain_intel_x64::integer_pointer
+domain_intel_x64::cr3() const
+{ return get_shared_page_tables().m_root_pt->cr3(); }
+
+domain_intel_x64::memory_descriptor_list &
+domain_intel_x64::cr3_mdl()
+{ return get_shared_page_tables().m_cr3_mdl; }
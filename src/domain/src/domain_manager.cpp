@@ -34,28 +34,67 @@ domain_manager::instance() noexcept
 domainid::type
 domain_manager::create_domain(user_data *data)
 {
+    // Note:
+    //
+    // Pooled domains are initialized without any user data, so they can
+    // only be used when the caller does not provide any.
+    //
+
+    if (data == nullptr)
+    {
+        if (auto &&domain = __acquire_pooled_domain())
+        {
+            auto &&domainid = domain->id();
+
+            std::lock_guard<std::mutex> guard(m_domian_mutex);
+            m_domains[domainid] = std::move(domain);
+
+            return domainid;
+        }
+    }
+
+    auto &&domainid = __next_domainid();
+
     auto ___ = gsl::on_failure([&]
     {
         std::lock_guard<std::mutex> guard(m_domian_mutex);
-        m_domains.erase(m_domian_next_id);
+        m_domains.erase(domainid);
     });
 
-    if (auto && domain = __add_domain(m_domian_next_id, data))
+    if (auto && domain = __add_domain(domainid, data))
         domain->init(data);
 
-    return m_domian_next_id++;
+    return domainid;
 }
 
 void
 domain_manager::delete_domain(domainid::type domainid, user_data *data)
 {
-    auto ___ = gsl::finally([&]
+    // Process lists hold a pointer to their domain (and charge their
+    // memory to its account), so a domain cannot be deleted until all of
+    // its process lists (and therefore vCPUs) have been. The lock is held
+    // from the check until the domain is removed, and process lists are
+    // only created from a domain acquired under the same lock (see
+    // acquire_domain), so a new process list cannot show up in between.
+
+    std::lock_guard<std::mutex> guard(m_domian_mutex);
+
+    auto &&iter = m_domains.find(domainid);
+    if (iter == m_domains.end())
+        return;
+
+    auto &&domain = iter->second;
+
+    if (domain)
     {
-        std::lock_guard<std::mutex> guard(m_domian_mutex);
-        m_domains.erase(domainid);
-    });
+        if (domain->num_process_lists() != 0 || domain->num_vcpus() != 0)
+            throw std::runtime_error("domain still in use: " + std::to_string(domainid));
+    }
 
-    if (auto && domain = __get_domain(domainid))
+    auto ___ = gsl::finally([&]
+    { m_domains.erase(iter); });
+
+    if (domain)
         domain->fini(data);
 }
 
@@ -63,11 +102,119 @@ gsl::not_null<domain *>
 domain_manager::get_domain(domainid::type domainid)
 { return __get_domain(domainid).get(); }
 
+gsl::not_null<domain *>
+domain_manager::acquire_domain(domainid::type domainid)
+{
+    std::lock_guard<std::mutex> guard(m_domian_mutex);
+
+    auto &&iter = m_domains.find(domainid);
+    if (iter == m_domains.end() || !iter->second)
+        throw std::invalid_argument("unknown domain: " + std::to_string(domainid));
+
+    iter->second->acquire_process_list();
+    return iter->second.get();
+}
+
+void
+domain_manager::set_domain_pool_size(std::size_t size)
+{
+    std::list<std::unique_ptr<domain>> extra;
+
+    {
+        std::lock_guard<std::mutex> guard(m_pool_mutex);
+
+        m_pool_size = size;
+        while (m_pool.size() > m_pool_size)
+        {
+            extra.push_back(std::move(m_pool.back()));
+            m_pool.pop_back();
+        }
+    }
+
+    for (const auto &domain : extra)
+        domain->fini();
+}
+
+std::size_t
+domain_manager::refill_domain_pool(std::size_t max)
+{
+    auto &&added = 0UL;
+
+    for (; added < max; added++)
+    {
+        {
+            std::lock_guard<std::mutex> guard(m_pool_mutex);
+
+            if (m_pool.size() >= m_pool_size)
+                break;
+        }
+
+        // The domain is initialized without holding the lock so that a
+        // create_domain on another core is never blocked by a refill.
+
+        auto &&domain = __make_domain(nullptr);
+        domain->init();
+
+        std::lock_guard<std::mutex> guard(m_pool_mutex);
+        m_pool.push_back(std::move(domain));
+    }
+
+    return added;
+}
+
+std::size_t
+domain_manager::domain_pool_size() const
+{
+    std::lock_guard<std::mutex> guard(m_pool_mutex);
+    return m_pool_size;
+}
+
+std::size_t
+domain_manager::pooled_domains() const
+{
+    std::lock_guard<std::mutex> guard(m_pool_mutex);
+    return m_pool.size();
+}
+
 domain_manager::domain_manager() noexcept :
     m_domian_next_id(0),
+    m_pool_size(0),
     m_domain_factory(std::make_unique<domain_factory>())
 { }
 
+domainid::type
+domain_manager::__next_domainid()
+{
+    std::lock_guard<std::mutex> guard(m_domian_mutex);
+    return m_domian_next_id++;
+}
+
+std::unique_ptr<domain>
+domain_manager::__make_domain(user_data *data)
+{
+    if (!m_domain_factory)
+        throw std::runtime_error("invalid domain factory");
+
+    if (auto && domain = m_domain_factory->make_domain(__next_domainid(), data))
+        return std::move(domain);
+
+    throw std::runtime_error("make_domain returned a nullptr domain");
+}
+
+std::unique_ptr<domain>
+domain_manager::__acquire_pooled_domain()
+{
+    std::lock_guard<std::mutex> guard(m_pool_mutex);
+
+    if (m_pool.empty())
+        return nullptr;
+
+    auto domain = std::move(m_pool.front());
+    m_pool.pop_front();
+
+    return domain;
+}
+
 std::unique_ptr<domain> &
 domain_manager::__add_domain(domainid::type domainid, user_data *data)
 {
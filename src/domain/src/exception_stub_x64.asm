@@ -0,0 +1,154 @@
+;
+; Bareflank Hyperkernel
+;
+; Copyright (C) 2015 Assured Information Security, Inc.
+; Author: Rian Quinn        <quinnr@ainfosec.com>
+; Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+;
+; This library is free software; you can redistribute it and/or
+; modify it under the terms of the GNU Lesser General Public
+; License as published by the Free Software Foundation; either
+; version 2.1 of the License, or (at your option) any later version.
+;
+; This library is distributed in the hope that it will be useful,
+; but WITHOUT ANY WARRANTY; without even the implied warranty of
+; MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+; Lesser General Public License for more details.
+;
+; You should have received a copy of the GNU Lesser General Public
+; License along with this library; if not, write to the Free Software
+; Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+bits 64
+default rel
+
+%define EXCEPTION_INFO_HANDLER 0x0000000100005000
+%define EXCEPTION_INFO_ACTIVE 0x0000000100005010
+
+section .text
+
+; Exception Stub
+;
+; This code is copied into a page of each domain, and the domain's IDT
+; points each of the 32 exception vectors to an entry in this stub (each
+; entry is 16 bytes). Every entry pushes an error code (0 if the CPU does
+; not push one), and the vector, so that the stack always has the same
+; layout (see exception_frame_t), saves the general purpose registers and
+; calls the handler that the VM app registered. When the handler returns,
+; the (possibly modified) state is restored and the exception returns.
+;
+; The stub runs on IST1, which is a per-process stack (mapped by the
+; process's EPT), so it is safe to take an exception on a bad stack. If the
+; VM app has not registered a handler, the handler page is not mapped, and
+; the read of the handler results in an EPT violation, which is reported
+; by the VMM the same way the triple fault was before.
+;
+;
+; The x87 and SSE state is saved (using FXSAVE) around the call, so the
+; handler is free to use SSE, but the upper halves of the AVX registers
+; are not, so the handler must not use AVX.
+;
+; Every vector shares IST1, so an exception taken while the handler is
+; running would overwrite the frame of the first one. Such an exception
+; cannot be recovered from, so instead the stub loads an empty IDT, which
+; turns it into a triple fault, which the VMM reports as a failure. For
+; the same reason, the handler must return (i.e. it cannot longjmp out of
+; the stub).
+;
+; Note that this code must be position independent as it is executed from
+; a different address than it is linked to.
+;
+
+align 16
+
+global exception_stub_begin
+exception_stub_begin:
+
+%assign vector 0
+%rep 32
+
+    align 16, db 0xCC
+
+%if vector == 8 || vector == 10 || vector == 11 || vector == 12 || vector == 13 || vector == 14 || vector == 17 || vector == 21 || vector == 29 || vector == 30
+    push vector
+%else
+    push 0
+    push vector
+%endif
+
+    jmp exception_stub_common
+
+%assign vector vector + 1
+%endrep
+
+exception_stub_common:
+
+    push rax
+
+    mov rax, [abs qword EXCEPTION_INFO_ACTIVE]
+    test rax, rax
+    jnz exception_stub_nested
+    mov rax, 1
+    mov [abs qword EXCEPTION_INFO_ACTIVE], rax
+
+    push rbx
+    push rcx
+    push rdx
+    push rsi
+    push rdi
+    push rbp
+    push r8
+    push r9
+    push r10
+    push r11
+    push r12
+    push r13
+    push r14
+    push r15
+
+    cld
+
+    ; The CPU aligns IST1 to 16 bytes, and the frame is 22 qwords, so the
+    ; FXSAVE area (and the stack at the call) is 16 byte aligned.
+
+    mov rdi, rsp
+    sub rsp, 512
+    fxsave64 [rsp]
+
+    mov rax, [abs qword EXCEPTION_INFO_HANDLER]
+    call rax
+
+    fxrstor64 [rsp]
+    add rsp, 512
+
+    pop r15
+    pop r14
+    pop r13
+    pop r12
+    pop r11
+    pop r10
+    pop r9
+    pop r8
+    pop rbp
+    pop rdi
+    pop rsi
+    pop rdx
+    pop rcx
+    pop rbx
+
+    xor rax, rax
+    mov [abs qword EXCEPTION_INFO_ACTIVE], rax
+    pop rax
+
+    add rsp, 16
+    iretq
+
+exception_stub_nested:
+
+    push 0
+    push 0
+    lidt [rsp]
+    ud2
+
+global exception_stub_end
+exception_stub_end:
@@ -0,0 +1,164 @@
+//
+// Bareflank Hyperkernel
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#include <gsl/gsl>
+#include <algorithm>
+
+#include <debug.h>
+#include <exception.h>
+
+#include <driver/driver_manager.h>
+#include <thread/thread_intel_x64.h>
+#include <process_list/process_list.h>
+
+// -----------------------------------------------------------------------------
+// Implementation
+// -----------------------------------------------------------------------------
+
+driver_manager *
+driver_manager::instance() noexcept
+{
+    static driver_manager self;
+    return &self;
+}
+
+void
+driver_manager::register_driver(deviceid::type deviceid, gsl::not_null<driver_data_intel_x64 *> dd)
+{
+    expects(deviceid < deviceid::max);
+    expects(dd->m_thread != nullptr);
+    expects(dd->m_proclt != nullptr);
+
+    std::lock_guard<std::mutex> guard(m_driver_mutex);
+
+    if (m_drivers.count(deviceid) != 0)
+        throw std::runtime_error("driver already registered: " + std::to_string(deviceid));
+
+    auto &&drv = m_drivers[deviceid];
+
+    drv.m_data.m_entry = dd->m_entry;
+    drv.m_data.m_domain = dd->m_domain;
+    drv.m_data.m_thread = dd->m_thread;
+    drv.m_data.m_proclt = dd->m_proclt;
+
+    dd->m_thread->set_event_handler(dd->m_entry);
+    dd->m_proclt->detach_process(dd->m_thread->proc()->id());
+}
+
+void
+driver_manager::unregister_driver(deviceid::type deviceid)
+{
+    std::lock_guard<std::mutex> guard(m_driver_mutex);
+    m_drivers.erase(deviceid);
+}
+
+void
+driver_manager::unregister_process(gsl::not_null<process *> proc)
+{
+    std::lock_guard<std::mutex> guard(m_driver_mutex);
+
+    for (auto iter = m_drivers.begin(); iter != m_drivers.end();)
+    {
+        if (iter->second.m_data.m_thread->proc().get() == proc)
+            iter = m_drivers.erase(iter);
+        else
+            ++iter;
+    }
+}
+
+void
+driver_manager::unregister_process_list(gsl::not_null<process_list *> proclt)
+{
+    std::lock_guard<std::mutex> guard(m_driver_mutex);
+
+    for (auto iter = m_drivers.begin(); iter != m_drivers.end();)
+    {
+        if (iter->second.m_data.m_proclt == proclt)
+            iter = m_drivers.erase(iter);
+        else
+            ++iter;
+    }
+}
+
+bool
+driver_manager::is_registered(deviceid::type deviceid) const
+{
+    std::lock_guard<std::mutex> guard(m_driver_mutex);
+    return m_drivers.count(deviceid) != 0;
+}
+
+bool
+driver_manager::write(deviceid::type deviceid, gsl::span<const char> data)
+{
+    std::lock_guard<std::mutex> guard(m_driver_mutex);
+
+    auto &&drv = __get_driver(deviceid);
+    auto &&size = gsl::narrow_cast<size_type>(data.size());
+
+    if (size > max_queue_size - drv.m_requests.size())
+        return false;
+
+    auto &&was_idle = drv.m_requests.empty();
+    drv.m_requests.insert(drv.m_requests.end(), data.begin(), data.end());
+
+    // Note:
+    //
+    // The driver is only notified when its queue goes from empty to not
+    // empty. Until it drains the queue, it either already has the event
+    // pending, or is running its handler, and will see the new data when
+    // it reads.
+    //
+
+    if (was_idle && size != 0)
+    {
+        auto &&thrd = drv.m_data.m_thread;
+
+        thrd->post_device_events(1UL << deviceid);
+        drv.m_data.m_proclt->wake_process(thrd->proc()->id());
+    }
+
+    return true;
+}
+
+driver_manager::size_type
+driver_manager::read(deviceid::type deviceid, gsl::span<char> data)
+{
+    std::lock_guard<std::mutex> guard(m_driver_mutex);
+
+    auto &&drv = __get_driver(deviceid);
+    auto size = std::min(gsl::narrow_cast<size_type>(data.size()), drv.m_requests.size());
+
+    std::copy_n(drv.m_requests.begin(), size, data.begin());
+    drv.m_requests.erase(drv.m_requests.begin(), drv.m_requests.begin() + gsl::narrow_cast<std::ptrdiff_t>(size));
+
+    return size;
+}
+
+driver_manager::driver_t &
+driver_manager::__get_driver(deviceid::type deviceid)
+{
+    auto &&iter = m_drivers.find(deviceid);
+
+    if (iter == m_drivers.end())
+        throw std::runtime_error("no driver registered: " + std::to_string(deviceid));
+
+    return iter->second;
+}
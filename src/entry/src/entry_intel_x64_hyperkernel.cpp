@@ -42,7 +42,7 @@ pre_create_vcpu(vcpuid::type id)
     if (!initialized)
     {
         auto &&domainid = g_dmm->create_domain();
-        g_pld.m_domain = g_dmm->get_domain(domainid).get();
+        g_pld.m_domain = g_dmm->acquire_domain(domainid).get();
 
         auto &&procltid = g_plm->create_process_list(&g_pld);
         g_vd.m_proclt = g_plm->get_process_list(procltid).get();
@@ -65,6 +65,7 @@ NATIVE_OUTDIR+=%BUILD_REL%/../bin
 ################################################################################
 
 SOURCES+=exit_handler_intel_x64_hyperkernel.cpp
+SOURCES+=vmcall_dispatch_table.cpp
 
 INCLUDE_PATHS+=../../../include
 INCLUDE_PATHS+=%HYPER_ABS%/include/
@@ -19,8 +19,14 @@
 // License along with this library; if not, write to the Free Software
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
 
+#include <vector>
+#include <cstring>
+#include <algorithm>
+
+#include <exit_handler/vmcall_dispatch_table.h>
 #include <exit_handler/exit_handler_intel_x64_hyperkernel.h>
 
+#include <vmcs/vmcs_intel_x64_32bit_control_fields.h>
 #include <vmcs/vmcs_intel_x64_32bit_guest_state_fields.h>
 #include <vmcs/vmcs_intel_x64_32bit_read_only_data_fields.h>
 #include <vmcs/vmcs_intel_x64_64bit_guest_state_fields.h>
@@ -31,7 +37,10 @@
 #include <domain/domain_manager.h>
 #include <domain/domain_intel_x64.h>
 
+#include <deviceid.h>
+#include <upper_lower.h>
 #include <process_list_data.h>
+#include <driver_data_intel_x64.h>
 #include <vcpu_data_intel_x64.h>
 #include <process_data_intel_x64.h>
 #include <vmcall_hyperkernel_interface.h>
@@ -41,6 +50,8 @@
 
 #include <thread/thread.h>
 #include <thread/thread_intel_x64.h>
+#include <thread/xsave_intel_x64.h>
+#include <thread/syscall_page_intel_x64.h>
 
 #include <process_list/process_list.h>
 #include <process_list/process_list_manager.h>
@@ -48,15 +59,48 @@
 #include <scheduler/scheduler.h>
 #include <scheduler/scheduler_manager.h>
 
+#include <driver/driver_manager.h>
+#include <shared_memory/shared_memory_manager.h>
+#include <frame_allocator/frame_allocator.h>
+
+#include <vcpu/vcpu_pool.h>
 #include <vcpu/vcpu_manager.h>
+#include <vcpu/vcpuid_allocator.h>
 #include <vcpu/vcpu_intel_x64_hyperkernel.h>
 
 #include <intrinsics/crs_intel_x64.h>
+#include <memory_manager/map_ptr_x64.h>
 
 using namespace x64;
 using namespace intel_x64;
 using namespace vmcs;
 
+// Note:
+//
+// An IPC message is handed to a thread that is blocked in a vmcall, so it
+// is written directly into the registers that the thread's vmcall returns
+// in (r03, r04 and r05 of vmcall_registers_t, which are rbx, rsi and r08).
+//
+
+// Note:
+//
+// CR2 is not part of the VMCS (it is neither saved nor loaded on a VM
+// exit / entry), so the guest sees whatever the register holds when the
+// VMM resumes it.
+//
+
+static void
+set_guest_cr2(uintptr_t val) noexcept
+{ __asm__ __volatile__("mov %0, %%cr2" : : "r"(val)); }
+
+static void
+set_ipc_msg(state_save_intel_x64 &state_save, uint64_t w0, uint64_t w1, uint64_t w2)
+{
+    state_save.rbx = w0;
+    state_save.rsi = w1;
+    state_save.r08 = w2;
+}
+
 exit_handler_intel_x64_hyperkernel::exit_handler_intel_x64_hyperkernel(
     coreid::type coreid,
     vcpuid::type vcpuid,
@@ -67,44 +111,42 @@ exit_handler_intel_x64_hyperkernel::exit_handler_intel_x64_hyperkernel(
     m_vcpuid(vcpuid),
     m_proclt(proclt),
     m_domain(domain),
-    m_thread(nullptr)
-{ }
+    m_thread(nullptr),
+    m_field_cache(nullptr),
+    m_exit_stats(nullptr)
+{
+    static auto registered = (register_vmcalls(), true);
+    (void) registered;
+}
 
 void
 exit_handler_intel_x64_hyperkernel::handle_exit(vmcs::value_type reason)
 {
+    m_exit_stats->begin_exit(reason);
+    m_field_cache->begin_exit();
+
     switch (reason)
     {
-        case exit_reason::basic_exit_reason::vm_entry_failure_invalid_guest_state:
         case exit_reason::basic_exit_reason::ept_violation:
+            handle_ept_violation();
+            break;
+
+        case exit_reason::basic_exit_reason::exception_or_non_maskable_interrupt:
+            handle_exception();
+            break;
+
+        case exit_reason::basic_exit_reason::control_register_accesses:
+            handle_cr_access();
+            break;
+
+        case exit_reason::basic_exit_reason::vm_entry_failure_invalid_guest_state:
         case exit_reason::basic_exit_reason::triple_fault:
-        {
-            bferror << "guest exited: failure\n";
-            bferror << "----------------------------------------------------" << bfendl;
-            bferror << "- rip: "
-                    << view_as_pointer(m_state_save->rip) << bfendl;
-            bferror << "- rsp: "
-                    << view_as_pointer(m_state_save->rsp) << bfendl;
-            bferror << "- exit reason: "
-                    << view_as_pointer(vmcs::exit_reason::get()) << bfendl;
-            bferror << "- exit reason string: "
-                    << vmcs::exit_reason::basic_exit_reason::description() << bfendl;
-            bferror << "- exit qualification: "
-                    << view_as_pointer(vmcs::exit_qualification::get()) << bfendl;
-            bferror << "- exit interrupt information: "
-                    << view_as_pointer(vmcs::vm_exit_interruption_information::get()) << bfendl;
-            bferror << "- instruction length: "
-                    << view_as_pointer(vmcs::vm_exit_instruction_length::get()) << bfendl;
-            bferror << "- instruction information: "
-                    << view_as_pointer(vmcs::vm_exit_instruction_information::get()) << bfendl;
-            bferror << "- guest linear address: "
-                    << view_as_pointer(vmcs::guest_linear_address::get()) << bfendl;
-            bferror << "- guest physical address: "
-                    << view_as_pointer(vmcs::guest_physical_address::get()) << bfendl;
-
-            g_shm->get_scheduler(m_coreid)->yield();
+            handle_guest_failure();
+            break;
+
+        case exit_reason::basic_exit_reason::hlt:
+            handle_hlt();
             break;
-        }
 
         default:
             exit_handler_intel_x64::handle_exit(reason);
@@ -112,15 +154,252 @@ exit_handler_intel_x64_hyperkernel::handle_exit(vmcs::value_type reason)
     }
 }
 
+void
+exit_handler_intel_x64_hyperkernel::handle_ept_violation()
+{
+    // Note:
+    //
+    // An EPT violation on a page that belongs to a lazy range is the first
+    // touch of that page, so the page is mapped, and the guest is resumed
+    // so that it can retry the instruction that faulted. Since the page was
+    // not present, no TLB flush is needed.
+    //
+
+    if (m_thread != nullptr)
+    {
+        auto &&proc = dynamic_cast<process_intel_x64 *>(m_thread->proc().get());
+
+        auto &&gpa = m_field_cache->guest_physical_address();
+
+        if (proc != nullptr && proc->vm_map_fault(gpa))
+            m_vmcs->resume();
+
+        // Note:
+        //
+        // Any other EPT violation is reflected to the VM app as a #PF, so
+        // that its exception handler can deal with it. If the violation
+        // happened while the CPU was delivering an event (e.g. the IST
+        // stack itself is not mapped), reflecting it would just fault
+        // again, so it is treated as a failure instead.
+        //
+        // FUTURE:
+        //
+        // Native exceptions (#PF, #GP, #UD, etc...) are delivered through
+        // the domain's IDT without a VM exit. EPT violations could be
+        // delivered the same way using #VE, which would remove this exit
+        // entirely.
+        //
+
+        if (proc != nullptr && proc->has_exception_handler() &&
+            vmcs::idt_vectoring_information::valid_bit::is_disabled())
+        {
+            inject_page_fault(gpa);
+            m_vmcs->resume();
+        }
+    }
+
+    handle_guest_failure();
+}
+
+void
+exit_handler_intel_x64_hyperkernel::switch_extended_state()
+{
+    g_xsm->switch_to_thread(m_coreid, m_thread);
+    m_field_cache->set_guest_cr0(m_field_cache->guest_cr0() & ~cr0::task_switched::mask);
+}
+
+void
+exit_handler_intel_x64_hyperkernel::inject_page_fault(uintptr_t gpa)
+{
+    constexpr const auto vector = 14UL;
+    constexpr const auto type_hardware_exception = 3UL << 8;
+    constexpr const auto deliver_error_code = 1UL << 11;
+    constexpr const auto valid = 1UL << 31;
+
+    auto &&qual = m_field_cache->exit_qualification();
+    auto &&error_code = 0UL;
+
+    if ((qual & (1UL << 1)) != 0)
+        error_code |= 1UL << 1;
+
+    if ((qual & (1UL << 2)) != 0)
+        error_code |= 1UL << 4;
+
+    // The VM app's page tables are an identity map, so the faulting
+    // linear address is gpa. It is loaded into CR2, as a native #PF
+    // would, and also recorded in the exception info page.
+
+    auto &&proc = dynamic_cast<process_intel_x64 *>(m_thread->proc().get());
+    proc->set_exception_fault_addr(gpa);
+
+    set_guest_cr2(gpa);
+
+    vmcs::vm_entry_exception_error_code::set(error_code);
+    vmcs::vm_entry_interruption_information::set(
+        vector | type_hardware_exception | deliver_error_code | valid);
+}
+
+void
+exit_handler_intel_x64_hyperkernel::handle_exception()
+{
+    constexpr const auto device_not_available = 7UL;
+
+    auto &&vector = m_field_cache->vm_exit_interruption_information() & 0xFFUL;
+
+    // Note:
+    //
+    // The only exception that is trapped is #NM, which means the VM app
+    // used SIMD while CR0.TS was set. The thread is given this core's
+    // extended state, CR0.TS is cleared, and the instruction is retried.
+    //
+
+    if (vector == device_not_available && m_thread != nullptr)
+    {
+        this->switch_extended_state();
+        m_vmcs->resume();
+    }
+
+    handle_guest_failure();
+}
+
+void
+exit_handler_intel_x64_hyperkernel::handle_cr_access()
+{
+    constexpr const auto access_mov_to_cr = 0UL;
+    constexpr const auto access_clts = 2UL;
+    constexpr const auto access_lmsw = 3UL;
+
+    auto &&qual = m_field_cache->exit_qualification();
+
+    auto &&cr = qual & 0xFUL;
+    auto &&access = (qual >> 4) & 0x3UL;
+
+    // Note:
+    //
+    // Only CR0.TS is in the CR0 guest/host mask, so this exit means that
+    // a VM app tried to clear TS (see
+    // vmcs_intel_x64_hyperkernel::write_fields). Rather than letting it,
+    // which would expose the extended state of the core's previous owner,
+    // the thread is given its own extended state, exactly as if it had
+    // taken the #NM. Any other CR0 bits that a MOV or LMSW changes are
+    // applied as well.
+    //
+
+    if (m_thread == nullptr || cr != 0)
+        handle_guest_failure();
+
+    auto &&val = m_field_cache->guest_cr0();
+
+    switch (access)
+    {
+        case access_clts:
+            break;
+
+        case access_mov_to_cr:
+            val = guest_gpr((qual >> 8) & 0xFUL);
+            break;
+
+        case access_lmsw:
+            // LMSW can set, but never clear, CR0.PE
+            val = (val & ~0xEUL) | ((qual >> 16) & 0xFUL);
+            break;
+
+        default:
+            handle_guest_failure();
+    }
+
+    m_field_cache->set_guest_cr0(val | cr0::task_switched::mask);
+    this->switch_extended_state();
+
+    m_state_save->rip += vmcs::vm_exit_instruction_length::get();
+    m_vmcs->resume();
+}
+
+void
+exit_handler_intel_x64_hyperkernel::handle_hlt()
+{
+    // Note:
+    //
+    // A VM app that executes HLT has nothing to do until an event arrives,
+    // so its process is parked (taken off of the run list), and the core
+    // is given to whatever else is ready to run. The process is resumed
+    // after the HLT once it is woken by run_process (or by an IPC, timer
+    // or driver event that calls process_list::wake_process, see
+    // inject_event).
+    //
+
+    if (m_thread == nullptr)
+        return exit_handler_intel_x64::handle_exit(exit_reason::basic_exit_reason::hlt);
+
+    m_state_save->rip += vmcs::vm_exit_instruction_length::get();
+
+    this->process_syscalls();
+
+    // Like a pending interrupt on real hardware, a pending event ends the
+    // HLT right away.
+
+    if (m_thread->has_deliverable_events())
+        m_vmcs->resume();
+
+    this->save_thread_state();
+
+    m_proclt->park_process(m_thread->proc()->id());
+
+    if (m_thread->consume_notification())
+    {
+        m_proclt->wake_process(m_thread->proc()->id());
+        m_vmcs->resume();
+    }
+
+    m_exit_stats->end_exit();
+    g_shm->get_scheduler(m_coreid)->yield();
+}
+
+void
+exit_handler_intel_x64_hyperkernel::handle_guest_failure()
+{
+    bferror << "guest exited: failure\n";
+    bferror << "----------------------------------------------------" << bfendl;
+    bferror << "- rip: "
+            << view_as_pointer(m_state_save->rip) << bfendl;
+    bferror << "- rsp: "
+            << view_as_pointer(m_state_save->rsp) << bfendl;
+    bferror << "- exit reason: "
+            << view_as_pointer(vmcs::exit_reason::get()) << bfendl;
+    bferror << "- exit reason string: "
+            << vmcs::exit_reason::basic_exit_reason::description() << bfendl;
+    bferror << "- exit qualification: "
+            << view_as_pointer(vmcs::exit_qualification::get()) << bfendl;
+    bferror << "- exit interrupt information: "
+            << view_as_pointer(vmcs::vm_exit_interruption_information::get()) << bfendl;
+    bferror << "- instruction length: "
+            << view_as_pointer(vmcs::vm_exit_instruction_length::get()) << bfendl;
+    bferror << "- instruction information: "
+            << view_as_pointer(vmcs::vm_exit_instruction_information::get()) << bfendl;
+    bferror << "- guest linear address: "
+            << view_as_pointer(vmcs::guest_linear_address::get()) << bfendl;
+    bferror << "- guest physical address: "
+            << view_as_pointer(vmcs::guest_physical_address::get()) << bfendl;
+
+    // The process cannot make forward progress, so it is removed from the
+    // process list. Otherwise the scheduler would just run it again, and
+    // it would fail again, forever.
+
+    if (m_thread != nullptr)
+        m_proclt->remove_process(m_thread->proc()->id());
+
+    g_shm->get_scheduler(m_coreid)->yield();
+}
+
 void
 exit_handler_intel_x64_hyperkernel::create_process_list(vmcall_registers_t &regs)
 {
     process_list_data pld;
 
     if (regs.r03 == domainid::current)
-        pld.m_domain = m_domain;
+        pld.m_domain = g_dmm->acquire_domain(m_domain->id()).get();
     else
-        pld.m_domain = g_dmm->get_domain(regs.r03).get();
+        pld.m_domain = g_dmm->acquire_domain(regs.r03).get();
 
     regs.r03 = g_plm->create_process_list(&pld);
 }
@@ -131,6 +410,7 @@ exit_handler_intel_x64_hyperkernel::delete_process_list(vmcall_registers_t &regs
     if (m_proclt->id() == regs.r03)
         throw std::runtime_error("deleting current proclt is not supported");
 
+    g_drm->unregister_process_list(g_plm->get_process_list(regs.r03).get());
     g_plm->delete_process_list(regs.r03);
 }
 
@@ -147,9 +427,7 @@ exit_handler_intel_x64_hyperkernel::create_vcpu(vmcall_registers_t &regs)
     vd.m_coreid = m_coreid;
     vd.m_domain = dynamic_cast<domain_intel_x64 *>(vd.m_proclt->get_domain().get());
 
-    regs.r03 = vcpu_intel_x64_hyperkernel::next_vcpuid();
-
-    g_vcm->create_vcpu(regs.r03, &vd);
+    regs.r03 = g_vpl->create_vcpu(&vd);
 }
 
 void
@@ -158,7 +436,24 @@ exit_handler_intel_x64_hyperkernel::delete_vcpu(vmcall_registers_t &regs)
     if (m_vcpuid == regs.r03)
         throw std::runtime_error("deleting current vcpu is not supported");
 
-    g_vcm->delete_vcpu(regs.r03);
+    if (!g_vpl->delete_vcpu(regs.r03))
+    {
+        this->complete_vmcall(BF_VMCALL_FAILURE, regs);
+        m_vmcs->resume();
+    }
+}
+
+void
+exit_handler_intel_x64_hyperkernel::set_vcpu_pool_size(vmcall_registers_t &regs)
+{
+    vcpu_data_intel_x64 vd;
+
+    vd.m_coreid = m_coreid;
+    vd.m_proclt = m_proclt;
+    vd.m_domain = m_domain;
+
+    g_vpl->set_pool_size(regs.r03);
+    g_vpl->refill(&vd);
 }
 
 void
@@ -172,7 +467,7 @@ exit_handler_intel_x64_hyperkernel::create_process(vmcall_registers_t &regs)
     else
         proclt = g_plm->get_process_list(regs.r03).get();
 
-    pd.m_domain = m_domain;
+    pd.m_domain = dynamic_cast<domain_intel_x64 *>(proclt->get_domain().get());
 
     regs.r03 = proclt->create_process(&pd);
 }
@@ -193,16 +488,58 @@ exit_handler_intel_x64_hyperkernel::delete_process(vmcall_registers_t &regs)
     // could end up dangling. Who owns it?
     //
 
-    // FUTURE:
+    g_drm->unregister_process(proclt->get_process(regs.r04));
+    proclt->delete_process(regs.r04);
+}
+
+void
+exit_handler_intel_x64_hyperkernel::run_process(vmcall_registers_t &regs)
+{
+    process_list *proclt;
+
+    if (regs.r03 == processlistid::current)
+        proclt = m_proclt;
+    else
+        proclt = g_plm->get_process_list(regs.r03).get();
+
+    proclt->wake_process(regs.r04);
+}
+
+void
+exit_handler_intel_x64_hyperkernel::hlt_process(vmcall_registers_t &regs)
+{
+    expects(m_thread != nullptr);
+
+    auto &&deadline = 0UL;
+
+    if (regs.r03 != 0)
+        deadline = __builtin_ia32_rdtsc() + regs.r03;
+
+    this->process_syscalls();
+    this->complete_vmcall(BF_VMCALL_SUCCESS, regs);
+
+    if (m_thread->has_deliverable_events())
+        m_vmcs->resume();
+
+    this->save_thread_state();
+
+    m_proclt->park_process(m_thread->proc()->id(), deadline);
+
+    // Note:
     //
-    // Need a generic way to register a driver so that this code has a
-    // generic way to cleanup
+    // A pending notification (see notify_channel) ends the hlt right away.
+    // It is checked after the process is parked, so that a notification
+    // that arrives in between is either seen here, or wakes the process.
     //
 
-    if (m_ttys0.m_thread != nullptr && m_ttys0.m_thread->proc()->id() == regs.r04)
-        m_ttys0 = {};
+    if (m_thread->consume_notification())
+    {
+        m_proclt->wake_process(m_thread->proc()->id());
+        m_vmcs->resume();
+    }
 
-    proclt->delete_process(regs.r04);
+    m_exit_stats->end_exit();
+    g_shm->get_scheduler(m_coreid)->yield();
 }
 
 void
@@ -249,12 +586,28 @@ exit_handler_intel_x64_hyperkernel::vm_map_lookup(vmcall_registers_t &regs)
     else
         proclt = g_plm->get_process_list(regs.r03).get();
 
-    auto &&cr3 = vmcs::guest_cr3::get();
+    auto &&cr3 = m_field_cache->guest_cr3();
     auto &&proc = proclt->get_process(regs.r04);
 
     proc->vm_map_lookup(regs.r05, cr3, regs.r06, regs.r07, regs.r08);
 }
 
+void
+exit_handler_intel_x64_hyperkernel::vm_map_lazy(vmcall_registers_t &regs)
+{
+    process_list *proclt;
+
+    if (regs.r03 == processlistid::current)
+        proclt = m_proclt;
+    else
+        proclt = g_plm->get_process_list(regs.r03).get();
+
+    auto &&cr3 = m_field_cache->guest_cr3();
+    auto &&proc = proclt->get_process(regs.r04);
+
+    proc->vm_map_lazy(regs.r05, cr3, regs.r06, regs.r07, regs.r08);
+}
+
 void
 exit_handler_intel_x64_hyperkernel::set_thread_info(vmcall_registers_t &regs)
 {
@@ -282,167 +635,1098 @@ exit_handler_intel_x64_hyperkernel::set_thread_info(vmcall_registers_t &regs)
 }
 
 void
-exit_handler_intel_x64_hyperkernel::sched_yield(vmcall_registers_t &regs)
+exit_handler_intel_x64_hyperkernel::batch(vmcall_registers_t &regs)
 {
-    this->complete_vmcall(BF_VMCALL_SUCCESS, regs);
+    if (regs.r04 > BATCH_MAX_OPS)
+        throw std::invalid_argument("too many batch ops: " + std::to_string(regs.r04));
 
-    if (m_thread != nullptr)
-        m_thread->m_state_save = *m_state_save;
+    // Note:
+    //
+    // The operations are copied in, run in order, and their results are
+    // copied back out, all in a single exit. The first operation that
+    // fails stops the batch, as later operations usually depend on the
+    // earlier ones (e.g. setting a thread's info once its stack has been
+    // mapped), and the number of operations that succeeded is returned.
+    //
 
-    g_shm->get_scheduler(m_coreid)->yield();
-}
+    std::vector<batch_op_t> ops(regs.r04);
 
-void
-exit_handler_intel_x64_hyperkernel::sched_yield_and_remove(vmcall_registers_t &regs)
-{
-    expects(m_thread != nullptr);
+    auto &&size = gsl::narrow_cast<std::ptrdiff_t>(ops.size() * sizeof(batch_op_t));
+    auto &&buffer = gsl::make_span(reinterpret_cast<char *>(ops.data()), size);
 
-    m_proclt->remove_process(m_thread->proc()->id());
-    sched_yield(regs);
-}
+    copy_caller_memory(regs.r03, buffer, false);
 
-void
-exit_handler_intel_x64_hyperkernel::set_program_break(vmcall_registers_t &regs)
-{
-    expects(m_thread != nullptr);
+    for (auto &op : ops)
+    {
+        op.status = BATCH_STATUS_NOT_RUN;
+        op.ret = 0;
+    }
 
-    // TODO
-    //
-    // Need to implement the foreign calls. This will have to get the proclist
-    // and the process to do this
-    //
+    auto num = 0UL;
 
-    m_thread->proc()->clear_set_program_break(regs.r05);
-}
+    for (auto &op : ops)
+    {
+        if (!run_batch_op(op))
+        {
+            op.status = BATCH_STATUS_FAILURE;
+            break;
+        }
 
-void
-exit_handler_intel_x64_hyperkernel::increase_program_break(vmcall_registers_t &regs)
-{
-    expects(m_thread != nullptr);
+        op.status = BATCH_STATUS_SUCCESS;
+        num++;
+    }
 
-    (void) regs;
+    copy_caller_memory(regs.r03, buffer, true);
+    regs.r03 = num;
+}
 
-    // TODO
-    //
-    // Need to implement the foreign calls. This will have to get the proclist
-    // and the process to do this
-    //
+void
+exit_handler_intel_x64_hyperkernel::create_shm(vmcall_registers_t &regs)
+{ g_smm->create_shared_memory(regs.r03, regs.r04); }
 
-    m_thread->proc()->increase_program_break_4k();
+void
+exit_handler_intel_x64_hyperkernel::map_shm(vmcall_registers_t &regs)
+{
+    auto &&proc = get_process(regs.r03, regs.r04);
+    proc->vm_map_shared(regs.r06, regs.r05, regs.r07);
 }
 
 void
-exit_handler_intel_x64_hyperkernel::decrease_program_break(vmcall_registers_t &regs)
+exit_handler_intel_x64_hyperkernel::unmap_shm(vmcall_registers_t &regs)
 {
-    expects(m_thread != nullptr);
+    auto &&proc = get_process(regs.r03, regs.r04);
+    proc->vm_unmap_shared(regs.r05);
+}
 
-    (void) regs;
+void
+exit_handler_intel_x64_hyperkernel::destroy_shm(vmcall_registers_t &regs)
+{ g_smm->destroy_shared_memory(regs.r03); }
 
-    // TODO
+void
+exit_handler_intel_x64_hyperkernel::get_memory_usage(vmcall_registers_t &regs)
+{ regs.r03 = get_account(regs.r03, regs.r04).usage(regs.r05); }
+
+void
+exit_handler_intel_x64_hyperkernel::set_memory_limits(vmcall_registers_t &regs)
+{
+    // FUTURE:
     //
-    // Need to implement the foreign calls. This will have to get the proclist
-    // and the process to do this
+    // There is currently no notion of privilege between VM apps, which
+    // means any VM app can change the limits of any process list,
+    // including its own. Once domains have an owner, this should be
+    // restricted to the owner of the process list.
     //
 
-    m_thread->proc()->decrease_program_break_4k();
+    get_account(regs.r03, regs.r04).set_limits(regs.r05, regs.r06);
 }
 
 void
-exit_handler_intel_x64_hyperkernel::handle_ttys0(vmcall_registers_t &regs)
+exit_handler_intel_x64_hyperkernel::set_numa_node(vmcall_registers_t &regs)
 {
-    if (m_ttys0.m_thread == nullptr)
-        return handle_ttys1(regs);
+    if (regs.r03 == coreid::current)
+        regs.r03 = m_coreid;
 
-    this->complete_vmcall(BF_VMCALL_SUCCESS, regs);
-    m_thread->m_state_save = *m_state_save;
-    g_shm->get_scheduler(m_coreid)->schedule(m_ttys0.m_thread, m_ttys0.m_entry, regs.r03, 0);
+    g_fa->set_core_node(regs.r03, regs.r04);
 }
 
 void
-exit_handler_intel_x64_hyperkernel::handle_ttys1(vmcall_registers_t &regs)
+exit_handler_intel_x64_hyperkernel::add_numa_frames(vmcall_registers_t &regs)
 {
-    std::cout << gsl::narrow_cast<char>(regs.r03);
+    // The frames that are donated are owned by the VMM from this point on,
+    // which means the VM that donated them must never free them. Only the
+    // host pins its memory for the life of the VMM, so a VM app is not
+    // allowed to donate frames.
+
+    expects(m_thread == nullptr);
+
+    auto &&cr3 = m_field_cache->guest_cr3();
+
+    for (auto page = 0UL; page < regs.r05; page += 0x1000)
+        g_fa->add_frame(regs.r03, bfn::virt_to_phys_with_cr3(regs.r04 + page, cr3));
 }
 
 void
-exit_handler_intel_x64_hyperkernel::register_ttys0(vmcall_registers_t &regs)
+exit_handler_intel_x64_hyperkernel::set_numa_policy(vmcall_registers_t &regs)
 {
-    m_ttys0.m_entry = regs.r03;
-    m_ttys0.m_domain = m_domain;
-    m_ttys0.m_thread = m_thread;
-    m_ttys0.m_proclt = m_proclt.get();
+    auto &&proc = get_process(regs.r03, regs.r04);
+    proc->set_numa_policy(regs.r05, regs.r06);
 }
 
 void
-exit_handler_intel_x64_hyperkernel::handle_vmcall_registers(vmcall_registers_t &regs)
+exit_handler_intel_x64_hyperkernel::get_numa_stats(vmcall_registers_t &regs)
 {
-    switch (regs.r02)
+    auto &&proc = get_process(regs.r03, regs.r04);
+
+    switch (regs.r05)
     {
-        case hyperkernel_vmcall__create_process_list:
-            create_process_list(regs);
+        case NUMA_STAT_LOCAL:
+            regs.r03 = proc->numa_local_allocs();
             break;
 
-        case hyperkernel_vmcall__delete_process_list:
-            delete_process_list(regs);
+        case NUMA_STAT_REMOTE:
+            regs.r03 = proc->numa_remote_allocs();
             break;
 
-        case hyperkernel_vmcall__create_vcpu:
-            create_vcpu(regs);
+        case NUMA_STAT_FALLBACK:
+            regs.r03 = proc->numa_fallback_allocs();
             break;
 
-        case hyperkernel_vmcall__delete_vcpu:
-            delete_vcpu(regs);
-            break;
+        default:
+            this->complete_vmcall(BF_VMCALL_FAILURE, regs);
+            m_vmcs->resume();
+    };
+}
 
-        case hyperkernel_vmcall__create_process:
-            create_process(regs);
-            break;
+void
+exit_handler_intel_x64_hyperkernel::set_exception_handler(vmcall_registers_t &regs)
+{
+    auto &&proc = get_process(regs.r03, regs.r04);
+    proc->set_exception_handler(regs.r05);
+}
 
-        case hyperkernel_vmcall__delete_process:
-            delete_process(regs);
-            break;
+void
+exit_handler_intel_x64_hyperkernel::set_event_handler(vmcall_registers_t &regs)
+{
+    auto &&proc = get_process(regs.r03, regs.r04);
+    auto &&thrd = get_thread(proc, regs.r06);
 
-        case hyperkernel_vmcall__vm_map_lookup:
-            vm_map_lookup(regs);
-            break;
+    thrd->set_event_handler(regs.r05);
+}
 
-        case hyperkernel_vmcall__set_thread_info:
-            set_thread_info(regs);
-            break;
+void
+exit_handler_intel_x64_hyperkernel::inject_event(vmcall_registers_t &regs)
+{
+    process_list *proclt;
 
-        case hyperkernel_vmcall__sched_yield:
-            sched_yield(regs);
-            break;
+    if (regs.r03 == processlistid::current)
+        proclt = m_proclt;
+    else
+        proclt = g_plm->get_process_list(regs.r03).get();
 
-        case hyperkernel_vmcall__sched_yield_and_remove:
-            sched_yield_and_remove(regs);
-            break;
+    auto &&proc = get_process(regs.r03, regs.r04);
+    auto &&thrd = get_thread(proc, regs.r06);
 
-        case hyperkernel_vmcall__set_program_break:
-            set_program_break(regs);
-            break;
+    // Note:
+    //
+    // The event is only marked as pending here. It is delivered the next
+    // time the target enters the guest (see
+    // thread_intel_x64::deliver_events), so a burst of events that arrives
+    // before then costs a single delivery. A target that is halted is
+    // woken so that it can take the event.
+    //
+
+    thrd->post_events(regs.r05);
+    proclt->wake_process(proc->id());
+}
+
+void
+exit_handler_intel_x64_hyperkernel::event_return(vmcall_registers_t &regs)
+{
+    expects(m_thread != nullptr);
+
+    (void) regs;
+
+    // The state that the event interrupted is restored as is, so the
+    // vmcall is not completed. Events that were posted while the handler
+    // was running are delivered by the resume.
+
+    m_thread->event_return(*m_state_save);
+    m_vmcs->resume();
+}
+
+void
+exit_handler_intel_x64_hyperkernel::ipc_call(vmcall_registers_t &regs)
+{
+    expects(m_thread != nullptr);
+
+    // Note:
+    //
+    // The server is looked up in the caller's process list only, which is
+    // what keeps a VM app from calling into another process list's VM
+    // apps.
+    //
+
+    auto &&proc = dynamic_cast<process_intel_x64 *>(m_proclt->get_process(regs.r03).get());
+    auto &&server = get_thread(proc, regs.r07);
+    auto &&vcpu = g_vid->lookup(m_vcpuid);
+
+    // Note:
+    //
+    // The server has to be blocked in ipc_reply_wait for the call to be
+    // taken. Otherwise the call fails, and the client is expected to retry
+    // (or fall back to a slower path). The exchange makes sure that only
+    // one client can take a server that is waiting.
+    //
+
+    if (vcpu == nullptr || !server->m_ipc_waiting.exchange(false))
+    {
+        this->complete_vmcall(BF_VMCALL_FAILURE, regs);
+        m_vmcs->resume();
+    }
+
+    set_ipc_msg(server->m_state_save, regs.r04, regs.r05, regs.r06);
+
+    server->m_ipc_caller = m_thread;
+    m_thread->m_ipc_callee = server;
+
+    this->complete_vmcall(BF_VMCALL_SUCCESS, regs);
+    this->save_thread_state();
+
+    m_proclt->park_process(m_thread->proc()->id());
+    m_proclt->wake_process(proc->id());
+
+    // The client's time slice is donated to the server, so instead of
+    // going through the scheduler, this vCPU is switched directly to the
+    // server's state (and EPT).
+
+    m_exit_stats->end_exit();
+    vcpu->schedule(proc, server, &server->m_state_save);
+}
+
+void
+exit_handler_intel_x64_hyperkernel::ipc_reply_wait(vmcall_registers_t &regs)
+{
+    expects(m_thread != nullptr);
+
+    auto &&client = m_thread->m_ipc_caller;
+    auto &&vcpu = g_vid->lookup(m_vcpuid);
+
+    this->complete_vmcall(BF_VMCALL_SUCCESS, regs);
+    this->save_thread_state();
+    m_thread->m_ipc_caller = nullptr;
+
+    // Note:
+    //
+    // A server only runs on demand, so while it is waiting, it does not
+    // keep the process list alive (see process_list::detach_process). The
+    // waiting flag is only set once the server's state has been saved, as
+    // a client on another core may take the server as soon as it is set.
+    //
+
+    m_proclt->detach_process(m_thread->proc()->id());
+    m_proclt->park_process(m_thread->proc()->id());
+
+    m_thread->m_ipc_waiting = true;
+    m_exit_stats->end_exit();
+
+    if (client != nullptr)
+    {
+        auto &&proc = dynamic_cast<process_intel_x64 *>(client->proc().get());
+
+        set_ipc_msg(client->m_state_save, regs.r03, regs.r04, regs.r05);
+        client->m_ipc_callee = nullptr;
+
+        m_proclt->wake_process(proc->id());
+
+        if (vcpu != nullptr)
+            vcpu->schedule(proc, client, &client->m_state_save);
+    }
+
+    g_shm->get_scheduler(m_coreid)->yield();
+}
+
+void
+exit_handler_intel_x64_hyperkernel::bind_channel(vmcall_registers_t &regs)
+{
+    expects(m_thread != nullptr);
+
+    // Note:
+    //
+    // Only a process that has the region mapped can receive its
+    // notifications, and the binding is dropped when the process unmaps
+    // the region (including when the process is deleted), so a channel
+    // never names a receiver that is gone. The calling thread is the one
+    // that is notified.
+    //
+
+    auto &&proc = dynamic_cast<process_intel_x64 *>(m_thread->proc().get());
+
+    if (!proc->maps_shared(regs.r03))
+    {
+        this->complete_vmcall(BF_VMCALL_FAILURE, regs);
+        m_vmcs->resume();
+    }
+
+    channel_receiver receiver;
+
+    receiver.procltid = m_proclt->id();
+    receiver.processid = proc->id();
+    receiver.threadid = m_thread->id();
+    receiver.proc = proc;
+
+    g_smm->bind_receiver(regs.r03, receiver);
+}
+
+void
+exit_handler_intel_x64_hyperkernel::notify_channel(vmcall_registers_t &regs)
+{
+    auto &&receiver = g_smm->get_receiver(regs.r03);
+
+    if (receiver.proc == nullptr)
+    {
+        this->complete_vmcall(BF_VMCALL_FAILURE, regs);
+        m_vmcs->resume();
+    }
+
+    auto &&proclt = g_plm->get_process_list(receiver.procltid);
+    auto &&proc = proclt->get_process(receiver.processid);
+    auto &&thrd = dynamic_cast<thread_intel_x64 *>(proc->get_thread(receiver.threadid).get());
+
+    // Note:
+    //
+    // The receiver is only woken if it is parked. Otherwise, the
+    // notification is left pending, so that the receiver's next
+    // hlt_process returns right away. Producers are expected to only
+    // notify once the receiver has said that it is about to block (see
+    // channel.h), so a stream of messages costs one notification per
+    // time the receiver runs dry, not one per message.
+    //
+
+    thrd->notify();
+    proclt->wake_process(proc->id());
+}
+
+void
+exit_handler_intel_x64_hyperkernel::set_domain_pool_size(vmcall_registers_t &regs)
+{
+    g_dmm->set_domain_pool_size(regs.r03);
+    g_dmm->refill_domain_pool();
+}
+
+void
+exit_handler_intel_x64_hyperkernel::create_domain(vmcall_registers_t &regs)
+{
+    auto &&domainid = g_dmm->create_domain();
+    auto ___ = gsl::on_failure([&]
+    { g_dmm->delete_domain(domainid); });
+
+    g_dmm->get_domain(domainid)->set_quotas(regs.r03, regs.r04, regs.r05);
+    regs.r03 = domainid;
+}
+
+void
+exit_handler_intel_x64_hyperkernel::delete_domain(vmcall_registers_t &regs)
+{
+    if (m_domain->id() == regs.r03)
+        throw std::runtime_error("deleting current domain is not supported");
 
-        case hyperkernel_vmcall__increase_program_break:
-            increase_program_break(regs);
+    g_dmm->delete_domain(regs.r03);
+}
+
+void
+exit_handler_intel_x64_hyperkernel::get_vmcs_stats(vmcall_registers_t &regs)
+{
+    auto &&stats = m_field_cache->stats();
+
+    switch (regs.r03)
+    {
+        case VMCS_STAT_EXITS:
+            regs.r03 = stats.exits;
             break;
 
-        case hyperkernel_vmcall__decrease_program_break:
-            decrease_program_break(regs);
+        case VMCS_STAT_VMREADS:
+            regs.r03 = stats.vmreads;
             break;
 
-        case hyperkernel_vmcall__ttys0:
-            handle_ttys0(regs);
+        case VMCS_STAT_VMWRITES:
+            regs.r03 = stats.vmwrites;
             break;
 
-        case hyperkernel_vmcall__ttys1:
-            handle_ttys1(regs);
+        case VMCS_STAT_VMREADS_SAVED:
+            regs.r03 = stats.vmreads_saved;
             break;
 
-        case hyperkernel_vmcall__register_ttys0:
-            register_ttys0(regs);
+        case VMCS_STAT_VMWRITES_SAVED:
+            regs.r03 = stats.vmwrites_saved;
             break;
 
         default:
-            throw std::runtime_error("unknown vmcall: " + std::to_string(regs.r02));
+            this->complete_vmcall(BF_VMCALL_FAILURE, regs);
+            m_vmcs->resume();
+    };
+}
+
+void
+exit_handler_intel_x64_hyperkernel::get_vmcall_count(vmcall_registers_t &regs)
+{ regs.r03 = g_vdt->count(regs.r03); }
+
+void
+exit_handler_intel_x64_hyperkernel::get_vmcall_histogram(vmcall_registers_t &regs)
+{ regs.r03 = g_vdt->histogram(regs.r03, regs.r04); }
+
+void
+exit_handler_intel_x64_hyperkernel::get_exit_count(vmcall_registers_t &regs)
+{
+    auto &&vcpuid = regs.r03 == REG_CURRENT ? m_vcpuid : regs.r03;
+
+    if (!vmcs_intel_x64_exit_stats::count(vcpuid, regs.r04, regs.r03))
+    {
+        this->complete_vmcall(BF_VMCALL_FAILURE, regs);
+        m_vmcs->resume();
+    }
+}
+
+void
+exit_handler_intel_x64_hyperkernel::get_exit_histogram(vmcall_registers_t &regs)
+{
+    auto &&vcpuid = regs.r03 == REG_CURRENT ? m_vcpuid : regs.r03;
+
+    if (!vmcs_intel_x64_exit_stats::histogram(vcpuid, regs.r04, regs.r03))
+    {
+        this->complete_vmcall(BF_VMCALL_FAILURE, regs);
+        m_vmcs->resume();
+    }
+}
+
+void
+exit_handler_intel_x64_hyperkernel::sched_yield(vmcall_registers_t &regs)
+{
+    // Note:
+    //
+    // A yield is the closest thing the VMM has to an idle point, so the
+    // domain pool is topped off here, one domain at a time, keeping the
+    // cost of a refill off of the create_domain path.
+    //
+
+    g_dmm->refill_domain_pool(1);
+
+    if ((m_vcpuid >> vcpuid::guest_from) == 0)
+    {
+        vcpu_data_intel_x64 vd;
+
+        vd.m_coreid = m_coreid;
+        vd.m_proclt = m_proclt;
+        vd.m_domain = m_domain;
+
+        g_vpl->refill(&vd, 1);
+    }
+
+    this->process_syscalls();
+    this->complete_vmcall(BF_VMCALL_SUCCESS, regs);
+
+    if (m_thread != nullptr)
+        this->save_thread_state();
+
+    m_exit_stats->end_exit();
+    g_shm->get_scheduler(m_coreid)->yield();
+}
+
+void
+exit_handler_intel_x64_hyperkernel::sched_num_jobs(vmcall_registers_t &regs)
+{
+    process_list *proclt;
+
+    if (regs.r03 == processlistid::current)
+        proclt = m_proclt;
+    else
+        proclt = g_plm->get_process_list(regs.r03).get();
+
+    regs.r03 = proclt->num_pending_jobs();
+}
+
+void
+exit_handler_intel_x64_hyperkernel::sched_yield_and_remove(vmcall_registers_t &regs)
+{
+    expects(m_thread != nullptr);
+
+    m_proclt->remove_process(m_thread->proc()->id());
+    sched_yield(regs);
+}
+
+void
+exit_handler_intel_x64_hyperkernel::set_program_break(vmcall_registers_t &regs)
+{
+    expects(m_thread != nullptr);
+
+    // TODO
+    //
+    // Need to implement the foreign calls. This will have to get the proclist
+    // and the process to do this
+    //
+
+    m_thread->proc()->clear_set_program_break(regs.r05);
+}
+
+void
+exit_handler_intel_x64_hyperkernel::increase_program_break(vmcall_registers_t &regs)
+{
+    expects(m_thread != nullptr);
+
+    (void) regs;
+
+    // TODO
+    //
+    // Need to implement the foreign calls. This will have to get the proclist
+    // and the process to do this
+    //
+
+    m_thread->proc()->increase_program_break_4k();
+}
+
+void
+exit_handler_intel_x64_hyperkernel::decrease_program_break(vmcall_registers_t &regs)
+{
+    expects(m_thread != nullptr);
+
+    (void) regs;
+
+    // TODO
+    //
+    // Need to implement the foreign calls. This will have to get the proclist
+    // and the process to do this
+    //
+
+    m_thread->proc()->decrease_program_break_4k();
+}
+
+void
+exit_handler_intel_x64_hyperkernel::handle_ttys0(vmcall_registers_t &regs)
+{
+    if (!g_drm->is_registered(deviceid::ttys0))
+        return handle_ttys1(regs);
+
+    // Note:
+    //
+    // The byte is only queued for the driver, which drains its queue in
+    // batches (see driver_manager), so the caller keeps the core. A full
+    // queue fails the vmcall, and the caller should yield to let the
+    // driver catch up.
+    //
+
+    auto &&val = gsl::narrow_cast<char>(regs.r03);
+
+    if (!g_drm->write(deviceid::ttys0, gsl::make_span(&val, 1)))
+    {
+        this->complete_vmcall(BF_VMCALL_FAILURE, regs);
+        m_vmcs->resume();
+    }
+}
+
+void
+exit_handler_intel_x64_hyperkernel::handle_ttys1(vmcall_registers_t &regs)
+{
+    std::cout << gsl::narrow_cast<char>(regs.r03);
+}
+
+void
+exit_handler_intel_x64_hyperkernel::handle_write(vmcall_registers_t &regs)
+{
+    expects(m_thread != nullptr);
+
+    auto &&proc = dynamic_cast<process_intel_x64 *>(m_thread->proc().get());
+    regs.r03 = write_guest(proc, regs.r03, regs.r04);
+}
+
+void
+exit_handler_intel_x64_hyperkernel::handle_write_ttys1(vmcall_registers_t &regs)
+{
+    expects(m_thread != nullptr);
+
+    auto &&proc = dynamic_cast<process_intel_x64 *>(m_thread->proc().get());
+    regs.r03 = write_guest(proc, regs.r03, regs.r04, true);
+}
+
+void
+exit_handler_intel_x64_hyperkernel::set_syscall_page(vmcall_registers_t &regs)
+{
+    expects(m_thread != nullptr);
+
+    if (regs.r03 == 0)
+        return g_spm->release(m_thread);
+
+    if (bfn::lower(regs.r03) != 0)
+        throw std::invalid_argument("syscall page must be page aligned");
+
+    auto &&proc = dynamic_cast<process_intel_x64 *>(m_thread->proc().get());
+
+    // The VMM keeps writing completions to the page until the thread is
+    // deleted, so the page cannot be one that the VM app is able to free
+    // in the meantime (i.e. program break and shared memory pages). The
+    // rest of the VM app's memory is mapped for the life of the process.
+
+    if (proc->in_program_break(regs.r03) || proc->in_shared_map(regs.r03))
+        throw std::invalid_argument("syscall page must be in the VM app's image");
+
+    g_spm->set_page(m_thread, proc->gva_to_hpa(regs.r03));
+}
+
+void
+exit_handler_intel_x64_hyperkernel::register_driver(vmcall_registers_t &regs)
+{
+    expects(m_thread != nullptr);
+
+    driver_data_intel_x64 dd;
+
+    dd.m_entry = regs.r04;
+    dd.m_domain = m_domain;
+    dd.m_thread = m_thread;
+    dd.m_proclt = m_proclt.get();
+
+    g_drm->register_driver(regs.r03, &dd);
+}
+
+void
+exit_handler_intel_x64_hyperkernel::unregister_driver(vmcall_registers_t &regs)
+{ g_drm->unregister_driver(regs.r03); }
+
+void
+exit_handler_intel_x64_hyperkernel::read_driver(vmcall_registers_t &regs)
+{
+    expects(m_thread != nullptr);
+
+    // Note:
+    //
+    // As with handle_write, the driver's whole queue (up to the size of
+    // the caller's buffer) is handed over in one exit, and copied into
+    // the VM app one page at a time. The data is removed from the queue
+    // before it is copied, so if the caller's buffer is not mapped, the
+    // data is lost.
+    //
+
+    constexpr const auto max_read_size = driver_manager::max_queue_size;
+
+    auto &&size = std::min<uint64_t>(regs.r05, max_read_size);
+
+    if (!m_write_buffer)
+        m_write_buffer = std::make_unique<char[]>(max_read_size);
+
+    auto &&buffer = gsl::make_span(m_write_buffer.get(), gsl::narrow_cast<std::ptrdiff_t>(size));
+    auto &&num = g_drm->read(regs.r03, buffer);
+
+    auto &&proc = dynamic_cast<process_intel_x64 *>(m_thread->proc().get());
+    proc->copy_to_guest(regs.r04, buffer.first(gsl::narrow_cast<std::ptrdiff_t>(num)));
+
+    regs.r03 = num;
+}
+
+void
+exit_handler_intel_x64_hyperkernel::handle_vmcall_registers(vmcall_registers_t &regs)
+{
+    auto &&index = regs.r02;
+    auto &&handler = g_vdt->handler(index);
+
+    // Note:
+    //
+    // An unknown vmcall is an error of the caller, not the VMM, so rather
+    // than throwing (which allocates, and unwinds), the vmcall is failed,
+    // and the caller is resumed directly.
+    //
+
+    if (handler == nullptr)
+    {
+        this->complete_vmcall(BF_VMCALL_FAILURE, regs);
+        m_vmcs->resume();
+    }
+
+    g_vdt->record_call(index);
+
+    auto &&start = __builtin_ia32_rdtsc();
+    handler(this, regs);
+    g_vdt->record_cycles(index, __builtin_ia32_rdtsc() - start);
+}
+
+void
+exit_handler_intel_x64_hyperkernel::register_vmcalls()
+{
+    using eh_type = exit_handler_intel_x64_hyperkernel;
+
+    // Handlers that an extension registered first are left alone, so an
+    // extension can replace any of the hyperkernel's vmcalls.
+
+    auto reg = [](vmcall_dispatch_table::index_type index, vmcall_dispatch_table::handler_type handler)
+    {
+        if (g_vdt->handler(index) == nullptr)
+            g_vdt->register_handler(index, handler);
+    };
+
+    reg(hyperkernel_vmcall__create_process_list, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->create_process_list(regs); });
+    reg(hyperkernel_vmcall__delete_process_list, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->delete_process_list(regs); });
+    reg(hyperkernel_vmcall__create_vcpu, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->create_vcpu(regs); });
+    reg(hyperkernel_vmcall__delete_vcpu, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->delete_vcpu(regs); });
+    reg(hyperkernel_vmcall__set_vcpu_pool_size, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->set_vcpu_pool_size(regs); });
+    reg(hyperkernel_vmcall__create_process, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->create_process(regs); });
+    reg(hyperkernel_vmcall__delete_process, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->delete_process(regs); });
+    reg(hyperkernel_vmcall__run_process, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->run_process(regs); });
+    reg(hyperkernel_vmcall__hlt_process, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->hlt_process(regs); });
+    reg(hyperkernel_vmcall__vm_map, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->vm_map(regs); });
+    reg(hyperkernel_vmcall__vm_map_lookup, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->vm_map_lookup(regs); });
+    reg(hyperkernel_vmcall__vm_map_lazy, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->vm_map_lazy(regs); });
+    reg(hyperkernel_vmcall__set_thread_info, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->set_thread_info(regs); });
+    reg(hyperkernel_vmcall__batch, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->batch(regs); });
+    reg(hyperkernel_vmcall__create_shm, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->create_shm(regs); });
+    reg(hyperkernel_vmcall__map_shm, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->map_shm(regs); });
+    reg(hyperkernel_vmcall__unmap_shm, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->unmap_shm(regs); });
+    reg(hyperkernel_vmcall__destroy_shm, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->destroy_shm(regs); });
+    reg(hyperkernel_vmcall__get_memory_usage, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->get_memory_usage(regs); });
+    reg(hyperkernel_vmcall__set_memory_limits, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->set_memory_limits(regs); });
+    reg(hyperkernel_vmcall__set_numa_node, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->set_numa_node(regs); });
+    reg(hyperkernel_vmcall__add_numa_frames, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->add_numa_frames(regs); });
+    reg(hyperkernel_vmcall__set_numa_policy, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->set_numa_policy(regs); });
+    reg(hyperkernel_vmcall__get_numa_stats, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->get_numa_stats(regs); });
+    reg(hyperkernel_vmcall__set_exception_handler, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->set_exception_handler(regs); });
+    reg(hyperkernel_vmcall__set_event_handler, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->set_event_handler(regs); });
+    reg(hyperkernel_vmcall__inject_event, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->inject_event(regs); });
+    reg(hyperkernel_vmcall__event_return, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->event_return(regs); });
+    reg(hyperkernel_vmcall__ipc_call, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->ipc_call(regs); });
+    reg(hyperkernel_vmcall__ipc_reply_wait, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->ipc_reply_wait(regs); });
+    reg(hyperkernel_vmcall__bind_channel, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->bind_channel(regs); });
+    reg(hyperkernel_vmcall__notify_channel, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->notify_channel(regs); });
+    reg(hyperkernel_vmcall__set_domain_pool_size, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->set_domain_pool_size(regs); });
+    reg(hyperkernel_vmcall__get_vmcs_stats, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->get_vmcs_stats(regs); });
+    reg(hyperkernel_vmcall__get_vmcall_count, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->get_vmcall_count(regs); });
+    reg(hyperkernel_vmcall__get_vmcall_histogram, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->get_vmcall_histogram(regs); });
+    reg(hyperkernel_vmcall__get_exit_count, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->get_exit_count(regs); });
+    reg(hyperkernel_vmcall__get_exit_histogram, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->get_exit_histogram(regs); });
+    reg(hyperkernel_vmcall__create_domain, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->create_domain(regs); });
+    reg(hyperkernel_vmcall__delete_domain, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->delete_domain(regs); });
+    reg(hyperkernel_vmcall__sched_yield, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->sched_yield(regs); });
+    reg(hyperkernel_vmcall__sched_yield_and_remove, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->sched_yield_and_remove(regs); });
+    reg(hyperkernel_vmcall__sched_num_jobs, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->sched_num_jobs(regs); });
+    reg(hyperkernel_vmcall__set_program_break, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->set_program_break(regs); });
+    reg(hyperkernel_vmcall__increase_program_break, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->increase_program_break(regs); });
+    reg(hyperkernel_vmcall__decrease_program_break, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->decrease_program_break(regs); });
+    reg(hyperkernel_vmcall__ttys0, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->handle_ttys0(regs); });
+    reg(hyperkernel_vmcall__ttys1, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->handle_ttys1(regs); });
+    reg(hyperkernel_vmcall__write, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->handle_write(regs); });
+    reg(hyperkernel_vmcall__write_ttys1, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->handle_write_ttys1(regs); });
+    reg(hyperkernel_vmcall__set_syscall_page, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->set_syscall_page(regs); });
+    reg(hyperkernel_vmcall__register_driver, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->register_driver(regs); });
+    reg(hyperkernel_vmcall__unregister_driver, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->unregister_driver(regs); });
+    reg(hyperkernel_vmcall__read_driver, [](eh_type * eh, vmcall_registers_t & regs)
+    { eh->read_driver(regs); });
+}
+
+bool
+exit_handler_intel_x64_hyperkernel::run_batch_op(batch_op_t &op)
+{
+    // Each operation is run by the same function as the matching vmcall,
+    // using the operation's arguments as the vmcall's registers.
+
+    vmcall_registers_t regs = {};
+
+    regs.r03 = op.args[0];
+    regs.r04 = op.args[1];
+    regs.r05 = op.args[2];
+    regs.r06 = op.args[3];
+    regs.r07 = op.args[4];
+    regs.r08 = op.args[5];
+    regs.r09 = op.args[6];
+
+    try
+    {
+        switch (op.op)
+        {
+            case BATCH_OP_VM_MAP:
+                vm_map(regs);
+                break;
+
+            case BATCH_OP_VM_MAP_LOOKUP:
+                vm_map_lookup(regs);
+                break;
+
+            case BATCH_OP_VM_MAP_LAZY:
+                vm_map_lazy(regs);
+                break;
+
+            case BATCH_OP_SET_THREAD_INFO:
+                set_thread_info(regs);
+                break;
+
+            case BATCH_OP_CREATE_THREAD:
+                op.ret = get_process(regs.r03, regs.r04)->create_thread();
+                break;
+
+            default:
+                return false;
+        };
+    }
+    catch (...)
+    {
+        return false;
+    }
+
+    return true;
+}
+
+void
+exit_handler_intel_x64_hyperkernel::copy_caller_memory(
+    uintptr_t virt, gsl::span<char> buffer, bool to_caller)
+{
+    // Note:
+    //
+    // The caller is usually the host (e.g. bfexec), whose memory is not
+    // an identity map like a VM app's, so each page is looked up using
+    // the caller's CR3, and mapped into the VMM once.
+    //
+
+    auto &&cr3 = m_field_cache->guest_cr3();
+    auto &&size = gsl::narrow_cast<uintptr_t>(buffer.size());
+
+    auto copied = 0UL;
+
+    while (copied < size)
+    {
+        auto &&addr = virt + copied;
+        auto &&offset = bfn::lower(addr);
+        auto num = std::min<uintptr_t>(size - copied, 0x1000 - offset);
+
+        auto &&map = bfn::make_unique_map_x64<char>(bfn::virt_to_phys_with_cr3(bfn::upper(addr), cr3));
+
+        if (to_caller)
+            memcpy(map.get() + offset, buffer.data() + copied, num);
+        else
+            memcpy(buffer.data() + copied, map.get() + offset, num);
+
+        copied += num;
+    }
+}
+
+uint64_t
+exit_handler_intel_x64_hyperkernel::write_guest(
+    process_intel_x64 *proc, uintptr_t gva, uint64_t size, bool bypass_driver)
+{
+    // Note:
+    //
+    // The buffer is copied out of the VM app in one pass (one map per
+    // page), and forwarded as a single chunk, instead of taking one exit
+    // per byte like ttys0. At most max_write_size bytes are taken per
+    // call, and the number of bytes taken is returned. If the driver's
+    // queue is full, nothing is taken, and the caller should yield to let
+    // the driver catch up. When bypass_driver is set (i.e. ttys1, which is
+    // what a ttys0 driver writes to), the buffer goes straight to the
+    // serial device.
+    //
+
+    constexpr const auto max_write_size = driver_manager::max_queue_size;
+
+    size = std::min<uint64_t>(size, max_write_size);
+
+    if (!m_write_buffer)
+        m_write_buffer = std::make_unique<char[]>(max_write_size);
+
+    auto &&buffer = gsl::make_span(m_write_buffer.get(), gsl::narrow_cast<std::ptrdiff_t>(size));
+    proc->copy_from_guest(gva, buffer);
+
+    if (!bypass_driver && g_drm->is_registered(deviceid::ttys0))
+    {
+        if (!g_drm->write(deviceid::ttys0, buffer))
+            size = 0;
+    }
+    else
+    {
+        std::cout.write(buffer.data(), gsl::narrow_cast<std::streamsize>(size));
+    }
+
+    return size;
+}
+
+uint64_t
+exit_handler_intel_x64_hyperkernel::process_syscall(
+    thread_intel_x64 *thrd, const syscall_entry_t &entry)
+{
+    auto &&proc = dynamic_cast<process_intel_x64 *>(thrd->proc().get());
+
+    switch (entry.op)
+    {
+        case SYSCALL_OP_INCREASE_PROGRAM_BREAK:
+        {
+            // Pages that were added before a failure stay added, so the
+            // number of pages that were added is returned.
+
+            auto num = 0UL;
+
+            try
+            {
+                for (; num < entry.args[0]; num++)
+                    proc->increase_program_break_4k();
+            }
+            catch (...)
+            { }
+
+            return num;
+        }
+
+        case SYSCALL_OP_MAP_SHM:
+            proc->vm_map_shared(entry.args[1], entry.args[0], entry.args[2]);
+            return 0;
+
+        case SYSCALL_OP_WRITE:
+        {
+            // If the driver's queue is full, the write is retried the next
+            // time the thread yields, rather than completing with 0 bytes
+            // written, as nobody waits for a write's result.
+
+            auto &&num = write_guest(proc, entry.args[0], entry.args[1]);
+
+            if (num == 0 && entry.args[1] != 0)
+                return syscall_page_manager::retry;
+
+            return num;
+        }
+
+        default:
+            return SYSCALL_RET_FAILURE;
     };
 }
+
+void
+exit_handler_intel_x64_hyperkernel::process_syscalls()
+{
+    auto &&handler = [&](thread_intel_x64 * thrd, const syscall_entry_t &entry)
+    { return this->process_syscall(thrd, entry); };
+
+    // Note:
+    //
+    // A VM app's requests are only processed by its own thread, when it
+    // yields or halts (i.e. before it gives up the core). A request changes
+    // the state of the process (e.g. its program break), which is not
+    // locked, so it can't be processed by another core while the process
+    // might be running there.
+    //
+
+    if (m_thread != nullptr)
+        g_spm->process(m_thread, handler);
+}
+
+void
+exit_handler_intel_x64_hyperkernel::save_thread_state()
+{
+    // Note:
+    //
+    // Once the thread gives up the core, it can be picked up by another
+    // core, so everything it needs to resume has to be saved first,
+    // including its extended state if it is loaded on this core (see
+    // xsave_manager::save).
+    //
+
+    m_thread->m_state_save = *m_state_save;
+    g_xsm->save(m_coreid, m_thread);
+}
+
+process_intel_x64 *
+exit_handler_intel_x64_hyperkernel::get_process(uint64_t procltid, uint64_t processid)
+{
+    process_list *proclt;
+
+    if (processid == processid::current)
+    {
+        expects(m_thread != nullptr);
+        return dynamic_cast<process_intel_x64 *>(m_thread->proc().get());
+    }
+
+    if (procltid == processlistid::current)
+        proclt = m_proclt;
+    else
+        proclt = g_plm->get_process_list(procltid).get();
+
+    return dynamic_cast<process_intel_x64 *>(proclt->get_process(processid).get());
+}
+
+thread_intel_x64 *
+exit_handler_intel_x64_hyperkernel::get_thread(process_intel_x64 *proc, uint64_t threadid)
+{
+    if (threadid == threadid::current)
+    {
+        expects(m_thread != nullptr);
+        expects(m_thread->proc().get() == proc);
+
+        return m_thread;
+    }
+
+    return dynamic_cast<thread_intel_x64 *>(proc->get_thread(threadid).get());
+}
+
+memory_account &
+exit_handler_intel_x64_hyperkernel::get_account(uint64_t procltid, uint64_t processid)
+{
+    if (processid != processid::invalid)
+        return get_process(procltid, processid)->account();
+
+    if (procltid == processlistid::current)
+        return m_proclt->account();
+
+    return g_plm->get_process_list(procltid)->account();
+}
+
+uint64_t
+exit_handler_intel_x64_hyperkernel::guest_gpr(uint64_t index)
+{
+    // Note:
+    //
+    // The index is the register encoding used by the exit qualification of
+    // control register accesses (Intel SDM, Vol. 3, Table 27-3).
+    //
+
+    switch (index)
+    {
+        case 0: return m_state_save->rax;
+        case 1: return m_state_save->rcx;
+        case 2: return m_state_save->rdx;
+        case 3: return m_state_save->rbx;
+        case 4: return m_state_save->rsp;
+        case 5: return m_state_save->rbp;
+        case 6: return m_state_save->rsi;
+        case 7: return m_state_save->rdi;
+        case 8: return m_state_save->r08;
+        case 9: return m_state_save->r09;
+        case 10: return m_state_save->r10;
+        case 11: return m_state_save->r11;
+        case 12: return m_state_save->r12;
+        case 13: return m_state_save->r13;
+        case 14: return m_state_save->r14;
+        default: return m_state_save->r15;
+    }
+}
@@ -0,0 +1,71 @@
+//
+// Bareflank Hyperkernel
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#include <exit_handler/vmcall_dispatch_table.h>
+
+vmcall_dispatch_table *
+vmcall_dispatch_table::instance() noexcept
+{
+    static vmcall_dispatch_table self;
+    return &self;
+}
+
+bool
+vmcall_dispatch_table::register_handler(index_type index, handler_type handler) noexcept
+{
+    if (!valid(index))
+        return false;
+
+    m_entries[slot(index)].m_handler = handler;
+    return true;
+}
+
+void
+vmcall_dispatch_table::record_cycles(index_type index, uint64_t cycles) noexcept
+{
+    auto &&bucket = 0UL;
+
+    if (cycles != 0)
+        bucket = 63UL - static_cast<index_type>(__builtin_clzl(cycles));
+
+    if (bucket >= num_buckets)
+        bucket = num_buckets - 1;
+
+    m_entries[slot(index)].m_histogram[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+uint64_t
+vmcall_dispatch_table::count(index_type index) const noexcept
+{
+    if (!valid(index))
+        return 0;
+
+    return m_entries[slot(index)].m_count.load(std::memory_order_relaxed);
+}
+
+uint64_t
+vmcall_dispatch_table::histogram(index_type index, index_type bucket) const noexcept
+{
+    if (!valid(index) || bucket >= num_buckets)
+        return 0;
+
+    return m_entries[slot(index)].m_histogram[bucket].load(std::memory_order_relaxed);
+}
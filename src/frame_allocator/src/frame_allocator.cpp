@@ -0,0 +1,154 @@
+//
+// Bareflank Hyperkernel
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#include <gsl/gsl>
+
+#include <cstring>
+#include <algorithm>
+
+#include <debug.h>
+#include <upper_lower.h>
+
+#include <frame_allocator/frame_allocator.h>
+#include <memory_manager/map_ptr_x64.h>
+
+// -----------------------------------------------------------------------------
+// Implementation
+// -----------------------------------------------------------------------------
+
+frame_allocator *
+frame_allocator::instance() noexcept
+{
+    static frame_allocator self;
+    return &self;
+}
+
+void
+frame_allocator::set_core_node(coreid::type coreid, numa::node_type node)
+{
+    if (node >= numa::max_nodes)
+        throw std::invalid_argument("invalid numa node: " + std::to_string(node));
+
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    m_core_nodes[coreid] = node;
+    m_num_nodes = std::max(m_num_nodes, node + 1);
+}
+
+numa::node_type
+frame_allocator::core_node(coreid::type coreid) const
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    auto &&iter = m_core_nodes.find(coreid);
+    if (iter == m_core_nodes.end())
+        return 0;
+
+    return iter->second;
+}
+
+void
+frame_allocator::add_frame(numa::node_type node, integer_pointer phys)
+{
+    if (node >= numa::max_nodes)
+        throw std::invalid_argument("invalid numa node: " + std::to_string(node));
+
+    if (bfn::lower(phys) != 0)
+        throw std::invalid_argument("frame must be page aligned: " + std::to_string(phys));
+
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    if (m_frame_nodes.count(phys) != 0)
+        throw std::runtime_error("frame already added: " + std::to_string(phys));
+
+    m_frame_nodes[phys] = node;
+    gsl::at(m_free_frames, gsl::narrow_cast<std::ptrdiff_t>(node)).push_back(phys);
+
+    m_num_nodes = std::max(m_num_nodes, node + 1);
+}
+
+frame_allocator::integer_pointer
+frame_allocator::allocate(numa::node_type node)
+{
+    integer_pointer phys = 0;
+
+    if (node >= numa::max_nodes)
+        throw std::invalid_argument("invalid numa node: " + std::to_string(node));
+
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        auto &&list = gsl::at(m_free_frames, gsl::narrow_cast<std::ptrdiff_t>(node));
+
+        if (list.empty())
+            return 0;
+
+        phys = list.front();
+        list.pop_front();
+    }
+
+    // Note:
+    //
+    // Frames are zeroed when they are handed out, and not when they are
+    // donated or freed, so that a frame never leaks data between two VM
+    // apps (or between the host and a VM app).
+    //
+
+    auto &&map = bfn::make_unique_map_x64<char>(phys);
+    memset(map.get(), 0, 0x1000);
+
+    return phys;
+}
+
+void
+frame_allocator::free(integer_pointer phys)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    auto &&iter = m_frame_nodes.find(phys);
+    if (iter == m_frame_nodes.end())
+        throw std::runtime_error("unknown frame: " + std::to_string(phys));
+
+    gsl::at(m_free_frames, gsl::narrow_cast<std::ptrdiff_t>(iter->second)).push_back(phys);
+}
+
+numa::node_type
+frame_allocator::frame_node(integer_pointer phys) const
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    auto &&iter = m_frame_nodes.find(phys);
+    if (iter == m_frame_nodes.end())
+        throw std::runtime_error("unknown frame: " + std::to_string(phys));
+
+    return iter->second;
+}
+
+frame_allocator::size_type
+frame_allocator::free_frames(numa::node_type node) const
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    return gsl::at(m_free_frames, gsl::narrow_cast<std::ptrdiff_t>(node)).size();
+}
+
+frame_allocator::frame_allocator() noexcept :
+    m_num_nodes(1),
+    m_free_frames(numa::max_nodes)
+{ }
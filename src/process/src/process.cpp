@@ -24,10 +24,25 @@
 #include <process/process.h>
 #include <memory_manager/memory_manager_x64.h>
 
+// FUTURE:
+//
+// Threads are allocated by a factory, so their real size is not known here.
+// For now, every thread is charged as a single page, which is a (generous)
+// upper bound on the size of thread_intel_x64.
+//
+constexpr const auto thread_charge = 0x1000UL;
+
 process::process(processid::type id) :
     m_id(id),
     m_is_initialized(false),
     m_program_break(0),
+    m_home_core(coreid::invalid),
+    m_numa_policy(numa::policy::local),
+    m_numa_node(0),
+    m_numa_next_node(0),
+    m_numa_local_allocs(0),
+    m_numa_remote_allocs(0),
+    m_numa_fallback_allocs(0),
     m_thread_next_id(0),
     m_thread_factory(std::make_unique<thread_factory>())
 {
@@ -48,6 +63,8 @@ void
 process::fini(user_data *data)
 {
     (void) data;
+
+    this->clear_set_program_break(0);
     m_is_initialized = false;
 }
 
@@ -81,13 +98,43 @@ process::vm_map_lookup(uintptr_t virt,
     throw std::logic_error("vm_map not implemented!!!");
 }
 
+void
+process::vm_map_lazy(uintptr_t virt,
+                     uintptr_t rtpt,
+                     uintptr_t addr,
+                     uintptr_t size,
+                     uintptr_t perm)
+{
+    (void) virt;
+    (void) rtpt;
+    (void) addr;
+    (void) size;
+    (void) perm;
+
+    throw std::logic_error("vm_map not implemented!!!");
+}
+
+void
+process::vm_unmap(uintptr_t virt,
+                  uintptr_t size)
+{
+    (void) virt;
+    (void) size;
+
+    throw std::logic_error("vm_unmap not implemented!!!");
+}
+
 threadid::type
 process::create_thread(user_data *data)
 {
+    m_account.charge(memory_category::thread, thread_charge);
+
     auto ___ = gsl::on_failure([&]
     {
         std::lock_guard<std::mutex> guard(m_thread_mutex);
         m_threads.erase(m_thread_next_id);
+
+        m_account.uncharge(memory_category::thread, thread_charge);
     });
 
     if (auto && thread = __add_thread(m_thread_next_id, data))
@@ -102,6 +149,10 @@ process::delete_thread(threadid::type threadid, user_data *data)
     auto ___ = gsl::finally([&]
     {
         std::lock_guard<std::mutex> guard(m_thread_mutex);
+
+        if (m_threads[threadid] != nullptr)
+            m_account.uncharge(memory_category::thread, thread_charge);
+
         m_threads.erase(threadid);
     });
 
@@ -116,17 +167,79 @@ process::get_thread(threadid::type threadid)
 void
 process::clear_set_program_break(integer_pointer pb)
 {
+    auto &&size = m_pages.size() * 0x1000;
+
+    // The pages must be removed from the process's memory map before the
+    // frames are freed. Otherwise the process would still be able to
+    // access a frame after it has been handed out to someone else.
+
+    if (size != 0)
+        this->vm_unmap(m_program_break - size, size);
+
+    m_account.uncharge(memory_category::program_break, size);
+
+    for (auto &page : m_pages)
+        __free_page(page);
+
     m_program_break = pb;
     m_pages.clear();
 }
 
+void
+process::set_numa_policy(numa::policy::type policy, numa::node_type node)
+{
+    switch (policy)
+    {
+        case numa::policy::local:
+        case numa::policy::interleave:
+            break;
+
+        case numa::policy::explicit_node:
+            if (node >= numa::max_nodes)
+                throw std::invalid_argument("invalid numa node: " + std::to_string(node));
+            break;
+
+        default:
+            throw std::invalid_argument("invalid numa policy: " + std::to_string(policy));
+    }
+
+    m_numa_policy = policy;
+    m_numa_node = node;
+}
+
 void
 process::increase_program_break_4k()
 {
-    auto &&page = std::make_unique<char[]>(4096);
+    m_account.charge(memory_category::program_break, 0x1000);
+    auto __ = gsl::on_failure([&]
+    { m_account.uncharge(memory_category::program_break, 0x1000); });
+
+    std::unique_ptr<char[]> page;
 
     auto &&virt = m_program_break;
-    auto &&phys = g_mm->virtptr_to_physint(page.get());
+    auto &&node = __next_numa_node();
+    auto &&phys = g_fa->allocate(node);
+
+    auto ___ = gsl::on_failure([&]
+    {
+        if (!page && phys != 0)
+            g_fa->free(phys);
+    });
+
+    if (phys != 0)
+    {
+        if (node == g_fa->core_node(m_home_core))
+            m_numa_local_allocs++;
+        else
+            m_numa_remote_allocs++;
+    }
+    else
+    {
+        page = std::make_unique<char[]>(4096);
+        phys = g_mm->virtptr_to_physint(page.get());
+
+        m_numa_fallback_allocs++;
+    }
 
     // TODO:
     //
@@ -137,14 +250,49 @@ process::increase_program_break_4k()
     this->vm_map(virt, phys, 0x1000, 0);
 
     m_program_break += 0x1000;
-    m_pages.push_back(std::move(page));
+    m_pages.push_back({std::move(page), phys});
 }
 
 void
 process::decrease_program_break_4k()
 {
+    if (m_pages.empty())
+        throw std::runtime_error("program break cannot be decreased");
+
+    this->vm_unmap(m_program_break - 0x1000, 0x1000);
+    __free_page(m_pages.back());
+
     m_program_break -= 0x1000;
     m_pages.pop_back();
+
+    m_account.uncharge(memory_category::program_break, 0x1000);
+}
+
+numa::node_type
+process::__next_numa_node()
+{
+    switch (m_numa_policy)
+    {
+        case numa::policy::interleave:
+            return m_numa_next_node++ % g_fa->num_nodes();
+
+        case numa::policy::explicit_node:
+            return m_numa_node;
+
+        default:
+            return g_fa->core_node(m_home_core);
+    }
+}
+
+void
+process::__free_page(std::pair<std::unique_ptr<char[]>, integer_pointer> &page)
+{
+    // Pages that came from the VMM's heap are freed when the unique_ptr is
+    // destroyed. Otherwise the page is a frame from the frame allocator,
+    // and needs to be given back to its node.
+
+    if (!page.first)
+        g_fa->free(page.second);
 }
 
 std::unique_ptr<thread> &
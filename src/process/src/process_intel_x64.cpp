@@ -19,11 +19,21 @@
 // License along with this library; if not, write to the Free Software
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
 
+#include <iterator>
+#include <algorithm>
+
 #include <debug.h>
 #include <upper_lower.h>
 
+#include <page_table_pool.h>
+#include <vpid_allocator.h>
+#include <vmcall_hyperkernel_interface.h>
+
 #include <domain/domain_intel_x64.h>
 #include <process/process_intel_x64.h>
+#include <shared_memory/shared_memory_manager.h>
+
+#include <intrinsics/vmx_intel_x64.h>
 
 #include <memory_manager/map_ptr_x64.h>
 #include <memory_manager/memory_manager_x64.h>
@@ -31,6 +41,8 @@
 using namespace x64;
 using namespace intel_x64;
 
+using ept_pool = page_table_pool<root_ept_intel_x64>;
+
 process_intel_x64::process_intel_x64(
     processid::type id,
     gsl::not_null<domain_intel_x64 *> domain) :
@@ -38,26 +50,77 @@ process_intel_x64::process_intel_x64(
     process(id),
 
     m_domain(domain),
-    m_root_ept(std::make_unique<root_ept_intel_x64>())
+    m_root_ept(ept_pool::instance()->acquire()),
+    m_vpid(vpid_allocator::instance()->acquire())
 { }
 
 void
 process_intel_x64::init(user_data *data)
 {
-    m_root_ept->map_4k(m_domain->tss_base_virt(), m_domain->tss_base_phys(), ept::memory_attr::rw_wb);
-    m_root_ept->map_4k(m_domain->gdt_base_virt(), m_domain->gdt_base_phys(), ept::memory_attr::ro_wb);
-    m_root_ept->map_4k(m_domain->idt_base_virt(), m_domain->idt_base_phys(), ept::memory_attr::ro_wb);
+    this->account().charge(memory_category::ept, ept::pt::size_bytes);
+
+    __charge_ept(m_domain->tss_base_virt(), ept::pt::size_bytes);
+    __charge_ept(m_domain->gdt_base_virt(), ept::pt::size_bytes);
+    __charge_ept(m_domain->idt_base_virt(), ept::pt::size_bytes);
+
+    __map_4k_attr(m_domain->tss_base_virt(), m_domain->tss_base_phys(), ept::memory_attr::rw_wb);
+    __map_4k_attr(m_domain->gdt_base_virt(), m_domain->gdt_base_phys(), ept::memory_attr::ro_wb);
+    __map_4k_attr(m_domain->idt_base_virt(), m_domain->idt_base_phys(), ept::memory_attr::ro_wb);
+
+    // The exception stub is shared by every process in the domain, so it
+    // is mapped execute-only (the stub never reads itself), which keeps a
+    // VM app from patching the code that every other VM app's exceptions
+    // run through.
+
+    __charge_ept(m_domain->exception_stub_base_virt(), ept::pt::size_bytes);
+    __map_4k_attr(m_domain->exception_stub_base_virt(), m_domain->exception_stub_base_phys(), ept::memory_attr::eo_wb);
 
     auto &&list = m_domain->cr3_mdl();
     for (auto md : list)
-        m_root_ept->map_4k(md.phys, md.phys, ept::memory_attr::rw_wb);
+    {
+        __charge_ept(md.phys, ept::pt::size_bytes);
+        __map_4k_attr(md.phys, md.phys, ept::memory_attr::ro_wb);
+    }
 
     process::init(data);
 }
 
 void
 process_intel_x64::fini(user_data *data)
-{ process::fini(data); }
+{
+    while (!m_shared_maps.empty())
+        this->vm_unmap_shared(m_shared_maps.begin()->first);
+
+    // The program break is cleared here, rather than by process::fini, as
+    // its pages have to be unmapped before the EPT is handed back.
+
+    this->clear_set_program_break(0);
+
+    // Rather than freeing the EPT (and every table page it allocated), the
+    // mappings that belong to this process are removed, and the EPT is
+    // handed back to the pool so that the next process can reuse its
+    // table pages.
+
+    for (const auto &pair : m_mapped_gpas)
+        m_root_ept->unmap(pair.first);
+
+    vmx::invept_single_context(m_root_ept->eptp());
+
+    // Shared memory and the program break are uncharged as they are
+    // unmapped. Everything else that was charged as mapped (vm_map,
+    // vm_map_lookup and pages that were faulted into a lazy range) is
+    // only unmapped here.
+
+    this->account().uncharge(memory_category::mapped, this->account().usage(memory_category::mapped));
+
+    m_mapped_gpas.clear();
+    m_lazy_ranges.clear();
+
+    ept_pool::instance()->release(std::move(m_root_ept));
+    vpid_allocator::instance()->release(m_vpid);
+
+    process::fini(data);
+}
 
 void
 process_intel_x64::vm_map(
@@ -80,8 +143,15 @@ process_intel_x64::vm_map(
     //
     size += bfn::lower(virt);
 
-    for (auto page = 0UL; page < size; page += ept::pt::size_bytes)
-        this->vm_map_page(virt + page, phys + page, perm);
+    auto &&tables = __charge_ept(virt, size);
+    this->account().charge(memory_category::mapped, size);
+
+    auto page = 0UL;
+    auto ___ = gsl::on_failure([&]
+    { this->__rollback_map(virt, size, page, tables); });
+
+    for (; page < size; page += ept::pt::size_bytes)
+        this->__map_4k(virt + page, phys + page, perm);
 }
 
 void
@@ -107,23 +177,441 @@ process_intel_x64::vm_map_lookup(
     //
     size += bfn::lower(virt);
 
-    for (auto page = 0UL; page < size; page += ept::pt::size_bytes)
+    auto &&tables = __charge_ept(virt, size);
+    this->account().charge(memory_category::mapped, size);
+
+    auto page = 0UL;
+    auto ___ = gsl::on_failure([&]
+    { this->__rollback_map(virt, size, page, tables); });
+
+    for (; page < size; page += ept::pt::size_bytes)
     {
         auto &&phys = bfn::virt_to_phys_with_cr3(addr + page, rtpt);
-        this->vm_map_page(virt + page, phys, perm);
+        this->__map_4k(virt + page, phys, perm);
     }
 }
 
+void
+process_intel_x64::vm_unmap(
+    uintptr_t virt,
+    uintptr_t size)
+{
+    expects(bfn::lower(virt) == 0);
+    expects(bfn::lower(size) == 0);
+
+    for (auto page = 0UL; page < size; page += ept::pt::size_bytes)
+    {
+        m_root_ept->unmap(virt + page);
+        m_mapped_gpas.erase(virt + page);
+    }
+
+    // FUTURE:
+    //
+    // Like vm_unmap_shared, this only flushes the TLB of the core that is
+    // performing the unmap.
+    //
+
+    vmx::invept_single_context(m_root_ept->eptp());
+
+    this->account().uncharge(memory_category::mapped, size);
+}
+
+void
+process_intel_x64::vm_map_lazy(
+    uintptr_t virt,
+    uintptr_t rtpt,
+    uintptr_t addr,
+    uintptr_t size,
+    uintptr_t perm)
+{
+    if (bfn::lower(virt) != bfn::lower(addr))
+        throw std::invalid_argument("vm_map_lazy: virt and addr must have the same page offset");
+
+    if (size == 0)
+        throw std::invalid_argument("vm_map_lazy: size cannot be 0");
+
+    auto &&start = bfn::upper(virt);
+    auto &&end = virt + size;
+
+    // Lazy ranges cannot overlap, as a fault would be ambiguous, and they
+    // cannot overlap shared memory, as a fault would replace the shared
+    // pages.
+
+    if (__overlaps_lazy(start, end - start))
+        throw std::runtime_error("vm_map_lazy: range overlaps an existing lazy range");
+
+    if (__overlaps_shared(start, end - start))
+        throw std::runtime_error("vm_map_lazy: range overlaps shared memory");
+
+    m_lazy_ranges[start] = {start, rtpt, bfn::upper(addr), end - start, perm};
+}
+
+bool
+process_intel_x64::vm_map_fault(uintptr_t gpa)
+{
+    auto &&iter = m_lazy_ranges.upper_bound(gpa);
+    if (iter == m_lazy_ranges.begin())
+        return false;
+
+    auto &&range = std::prev(iter)->second;
+    if (gpa >= range.virt + range.size)
+        return false;
+
+    auto &&page = bfn::upper(gpa);
+
+    if (m_mapped_gpas.count(page) != 0)
+        return false;
+
+    auto &&phys = bfn::virt_to_phys_with_cr3(range.addr + (page - range.virt), range.rtpt);
+    this->vm_map_page(page, phys, range.perm);
+
+    return true;
+}
+
 void
 process_intel_x64::vm_map_page(
     uintptr_t virt,
     uintptr_t phys,
     uintptr_t perm)
+{
+    auto &&tables = __charge_ept(virt, ept::pt::size_bytes);
+    this->account().charge(memory_category::mapped, ept::pt::size_bytes);
+
+    auto ___ = gsl::on_failure([&]
+    { this->__rollback_map(virt, ept::pt::size_bytes, 0, tables); });
+
+    this->__map_4k(virt, phys, perm);
+}
+
+void
+process_intel_x64::vm_map_shared(
+    uintptr_t virt,
+    shmid::type shmid,
+    uintptr_t perm)
+{
+    if (bfn::lower(virt) != 0)
+        throw std::invalid_argument("shared memory virt must be page aligned");
+
+    auto &&shm = g_smm->acquire_shared_memory(shmid);
+    auto ___ = gsl::on_failure([&]
+    { g_smm->release_shared_memory(shm); });
+
+    if (__overlaps_shared(virt, shm->size()))
+        throw std::runtime_error("shared memory already mapped at: " + std::to_string(virt));
+
+    if (__overlaps_lazy(virt, shm->size()))
+        throw std::runtime_error("shared memory overlaps a lazy range at: " + std::to_string(virt));
+
+    auto &&attr = (perm & VM_PERM_W) != 0 ? ept::memory_attr::rw_wb : ept::memory_attr::ro_wb;
+
+    auto &&tables = __charge_ept(virt, shm->size());
+    this->account().charge(memory_category::mapped, shm->size());
+
+    auto mapped = 0UL;
+    auto ____ = gsl::on_failure([&]
+    { this->__rollback_map(virt, shm->size(), mapped * ept::pt::size_bytes, tables); });
+
+    for (; mapped < shm->num_pages(); mapped++)
+        __map_4k_attr(virt + (mapped * ept::pt::size_bytes), shm->phys(mapped), attr);
+
+    m_shared_maps[virt] = shm.get();
+}
+
+void
+process_intel_x64::vm_unmap_shared(uintptr_t virt)
+{
+    auto &&iter = m_shared_maps.find(virt);
+
+    if (iter == m_shared_maps.end())
+        throw std::runtime_error("shared memory not mapped at: " + std::to_string(virt));
+
+    auto &&shm = iter->second;
+
+    for (auto i = 0UL; i < shm->num_pages(); i++)
+    {
+        m_root_ept->unmap(virt + (i * ept::pt::size_bytes));
+        m_mapped_gpas.erase(virt + (i * ept::pt::size_bytes));
+    }
+
+    // FUTURE:
+    //
+    // This only flushes the TLB of the core that is performing the unmap.
+    // Once processes can be scheduled on more than one core, the other
+    // cores will need to be told to flush this EPTP as well.
+    //
+
+    vmx::invept_single_context(m_root_ept->eptp());
+
+    this->account().uncharge(memory_category::mapped, shm->size());
+
+    g_smm->unbind_receiver(shm, this);
+    g_smm->release_shared_memory(shm);
+    m_shared_maps.erase(iter);
+}
+
+bool
+process_intel_x64::in_shared_map(uintptr_t virt) const
+{ return __overlaps_shared(virt, 1); }
+
+bool
+process_intel_x64::maps_shared(shmid::type shmid) const
+{
+    for (const auto &map : m_shared_maps)
+    {
+        if (map.second->id() == shmid)
+            return true;
+    }
+
+    return false;
+}
+
+void
+process_intel_x64::copy_from_guest(uintptr_t gva, gsl::span<char> buffer)
+{
+    constexpr const auto max_gva = 0x100000000UL;
+
+    auto &&size = gsl::narrow_cast<uintptr_t>(buffer.size());
+
+    expects(gva < max_gva);
+    expects(size <= max_gva - gva);
+
+    auto copied = 0UL;
+
+    while (copied < size)
+    {
+        auto &&addr = gva + copied;
+        auto &&offset = bfn::lower(addr);
+        auto num = std::min<uintptr_t>(size - copied, ept::pt::size_bytes - offset);
+
+        auto &&map = bfn::make_unique_map_x64<char>(__gpa_to_hpa(addr));
+        memcpy(buffer.data() + copied, map.get() + offset, num);
+
+        copied += num;
+    }
+}
+
+void
+process_intel_x64::copy_to_guest(uintptr_t gva, gsl::span<const char> buffer)
+{
+    constexpr const auto max_gva = 0x100000000UL;
+
+    auto &&size = gsl::narrow_cast<uintptr_t>(buffer.size());
+
+    expects(gva < max_gva);
+    expects(size <= max_gva - gva);
+
+    auto copied = 0UL;
+
+    while (copied < size)
+    {
+        auto &&addr = gva + copied;
+        auto &&offset = bfn::lower(addr);
+        auto num = std::min<uintptr_t>(size - copied, ept::pt::size_bytes - offset);
+
+        auto &&map = bfn::make_unique_map_x64<char>(__gpa_to_hpa(addr));
+        memcpy(map.get() + offset, buffer.data() + copied, num);
+
+        copied += num;
+    }
+}
+
+uintptr_t
+process_intel_x64::gva_to_hpa(uintptr_t gva)
+{
+    expects(gva < 0x100000000UL);
+    return __gpa_to_hpa(gva);
+}
+
+void
+process_intel_x64::set_exception_handler(uintptr_t handler)
+{
+    if (!m_exception_info)
+    {
+        auto &&info_virt = m_domain->exception_info_virt();
+        auto &&stack_virt = m_domain->exception_stack_virt();
+        auto &&stack_size = m_domain->exception_stack_size();
+
+        __charge_ept(info_virt, ept::pt::size_bytes);
+        __charge_ept(stack_virt, stack_size);
+
+        // The exception info page and stack come from the VMM's heap, just
+        // like a thread's stack, so they are charged the same way. They
+        // are freed with the process, along with its account.
+
+        auto &&charge = ept::pt::size_bytes + stack_size;
+        this->account().charge(memory_category::thread, charge);
+
+        auto ___ = gsl::on_failure([&]
+        { this->account().uncharge(memory_category::thread, charge); });
+
+        auto &&info = std::make_unique<uintptr_t[]>(ept::pt::size_bytes / sizeof(uintptr_t));
+        __map_4k_attr(info_virt, g_mm->virtptr_to_physint(info.get()), ept::memory_attr::rw_wb);
+
+        for (auto page = 0UL; page < stack_size; page += ept::pt::size_bytes)
+        {
+            auto &&stack = std::make_unique<char[]>(ept::pt::size_bytes);
+            __map_4k_attr(stack_virt + page, g_mm->virtptr_to_physint(stack.get()), ept::memory_attr::rw_wb);
+
+            m_exception_stack.push_back(std::move(stack));
+        }
+
+        m_exception_info = std::move(info);
+    }
+
+    m_exception_info[0] = handler;
+}
+
+bool
+process_intel_x64::has_exception_handler() const
+{ return m_exception_info && m_exception_info[0] != 0; }
+
+void
+process_intel_x64::set_exception_fault_addr(uintptr_t gpa)
+{
+    expects(this->has_exception_handler());
+    m_exception_info[1] = gpa;
+}
+
+uintptr_t
+process_intel_x64::__gpa_to_hpa(uintptr_t gpa)
+{
+    auto &&page = bfn::upper(gpa);
+    auto &&iter = m_mapped_gpas.find(page);
+
+    if (iter == m_mapped_gpas.end())
+    {
+        if (!this->vm_map_fault(gpa))
+            throw std::runtime_error("gpa not mapped: " + std::to_string(gpa));
+
+        iter = m_mapped_gpas.find(page);
+    }
+
+    return iter->second;
+}
+
+std::set<uintptr_t>
+process_intel_x64::__charge_ept(uintptr_t virt, uintptr_t size)
+{
+    std::set<uintptr_t> tables;
+
+    // The EPT allocates its tables on demand, so a map may need a new PT
+    // (per 2M), PD (per 1G) and PDPT (per 512G) for each page. The tables
+    // are charged up front so that a map that would cross the hard limit
+    // fails before anything is allocated. Tables are never freed until the
+    // EPT is, so they stay charged for the life of the process.
+
+    for (auto page = bfn::upper(virt); page < virt + size; page += ept::pt::size_bytes)
+    {
+        auto &&keys =
+        {
+            (1UL << 62) | (page >> 21),
+            (2UL << 62) | (page >> 30),
+            (3UL << 62) | (page >> 39)
+        };
+
+        for (auto key : keys)
+        {
+            if (m_ept_tables.count(key) == 0)
+                tables.insert(key);
+        }
+    }
+
+    this->account().charge(memory_category::ept, tables.size() * ept::pt::size_bytes);
+    m_ept_tables.insert(tables.begin(), tables.end());
+
+    return tables;
+}
+
+void
+process_intel_x64::__rollback_map(
+    uintptr_t virt, uintptr_t size, uintptr_t mapped, const std::set<uintptr_t> &tables)
+{
+    // Undoes a map that threw after mapping the first "mapped" bytes of
+    // [virt, virt + size). Those pages are unmapped, and everything the
+    // map charged up front is uncharged, except for the tables that the
+    // EPT might already have allocated (i.e. the ones that cover a page
+    // that was mapped, or the page that failed), as those are not freed
+    // until the EPT is.
+
+    for (auto page = 0UL; page < mapped; page += ept::pt::size_bytes)
+    {
+        m_root_ept->unmap(virt + page);
+        m_mapped_gpas.erase(bfn::upper(virt + page));
+    }
+
+    vmx::invept_single_context(m_root_ept->eptp());
+    this->account().uncharge(memory_category::mapped, size);
+
+    auto &&touched_end = bfn::upper(virt) + std::min(mapped + ept::pt::size_bytes, size);
+    auto unused = 0UL;
+
+    for (auto key : tables)
+    {
+        auto &&shift = 21UL + (((key >> 62) - 1) * 9UL);
+        auto &&start = (key & ~(3UL << 62)) << shift;
+        auto &&end = start + (1UL << shift);
+
+        if (end > bfn::upper(virt) && start < touched_end)
+            continue;
+
+        m_ept_tables.erase(key);
+        unused++;
+    }
+
+    this->account().uncharge(memory_category::ept, unused * ept::pt::size_bytes);
+}
+
+bool
+process_intel_x64::__overlaps_shared(uintptr_t virt, uintptr_t size) const
+{
+    // The maps are ordered by where each region starts, so only the
+    // regions on either side of virt need to be checked.
+
+    auto &&next = m_shared_maps.lower_bound(virt);
+    if (next != m_shared_maps.end() && next->first < virt + size)
+        return true;
+
+    if (next == m_shared_maps.begin())
+        return false;
+
+    auto &&prev = std::prev(next);
+    return prev->first + prev->second->size() > virt;
+}
+
+bool
+process_intel_x64::__overlaps_lazy(uintptr_t virt, uintptr_t size) const
+{
+    auto &&next = m_lazy_ranges.lower_bound(virt);
+    if (next != m_lazy_ranges.end() && next->first < virt + size)
+        return true;
+
+    if (next == m_lazy_ranges.begin())
+        return false;
+
+    auto &&prev = std::prev(next);
+    return prev->second.virt + prev->second.size > virt;
+}
+
+void
+process_intel_x64::__map_4k(
+    uintptr_t virt,
+    uintptr_t phys,
+    uintptr_t perm)
 {
     // TODO: We need to use the permission flags to determine how to
     // actually map memory
 
     (void) perm;
 
-    m_root_ept->map_4k(virt, phys, ept::memory_attr::pt_wb);
+    __map_4k_attr(virt, phys, ept::memory_attr::pt_wb);
+}
+
+void
+process_intel_x64::__map_4k_attr(
+    uintptr_t virt,
+    uintptr_t phys,
+    uint64_t attr)
+{
+    m_root_ept->map_4k(virt, phys, attr);
+    m_mapped_gpas[bfn::upper(virt)] = bfn::upper(phys);
 }
@@ -22,7 +22,7 @@
 #include <debug.h>
 #include <exception.h>
 
-#include <vcpu/vcpu_manager.h>
+#include <vcpu/vcpu_pool.h>
 #include <process_list/process_list.h>
 
 process_list::process_list(
@@ -33,16 +33,25 @@ process_list::process_list(
     m_domain(domain),
     m_is_initialized(false),
     m_process_next_id(0),
+    m_next_deadline(0),
     m_process_factory(std::make_unique<process_factory>())
 {
     if ((id & processlistid::reserved) != 0)
         throw std::invalid_argument("invalid processlistid");
+
+    m_account.set_parent(&m_domain->account());
 }
 
 process_list::~process_list()
 {
-    for (auto vcpuid : m_vcpuids)
-        g_vcm->delete_vcpu(vcpuid);
+    // Deleting a vCPU removes it from m_vcpuids, so a copy is walked
+    // instead.
+
+    auto vcpuids = m_vcpuids;
+    for (auto vcpuid : vcpuids)
+        g_vpl->delete_vcpu(vcpuid);
+
+    m_domain->release_process_list();
 }
 
 void
@@ -64,6 +73,8 @@ process_list::fini(user_data *data)
 void
 process_list::add_vcpu(vcpuid::type id)
 {
+    m_domain->acquire_vcpu();
+
     std::lock_guard<std::mutex> guard(m_vcpu_mutex);
     m_vcpuids.insert(id);
 }
@@ -79,7 +90,9 @@ process_list::remove_vcpu(vcpuid::type id)
     //
 
     std::lock_guard<std::mutex> guard(m_vcpu_mutex);
-    m_vcpuids.erase(id);
+
+    if (m_vcpuids.erase(id) != 0)
+        m_domain->release_vcpu();
 }
 
 std::size_t
@@ -109,6 +122,8 @@ process_list::delete_process(processid::type processid, user_data *data)
         std::lock_guard<std::mutex> guard(m_process_mutex);
 
         m_process_list.remove(m_process_next_id);
+        m_parked.erase(processid);
+        m_detached.erase(processid);
         m_processes.erase(processid);
     });
 
@@ -122,7 +137,43 @@ process_list::get_process(processid::type processid)
 
 void
 process_list::remove_process(processid::type processid)
-{ m_process_list.remove(processid); }
+{
+    std::lock_guard<std::mutex> guard(m_process_mutex);
+
+    m_process_list.remove(processid);
+    m_parked.erase(processid);
+}
+
+void
+process_list::park_process(processid::type processid, uint64_t deadline)
+{
+    std::lock_guard<std::mutex> guard(m_process_mutex);
+
+    m_process_list.remove(processid);
+    m_parked[processid] = deadline;
+
+    if (deadline != 0 && (m_next_deadline == 0 || deadline < m_next_deadline))
+        m_next_deadline = deadline;
+}
+
+void
+process_list::detach_process(processid::type processid)
+{
+    std::lock_guard<std::mutex> guard(m_process_mutex);
+    m_detached.insert(processid);
+}
+
+bool
+process_list::wake_process(processid::type processid)
+{
+    std::lock_guard<std::mutex> guard(m_process_mutex);
+
+    if (m_parked.erase(processid) == 0)
+        return false;
+
+    m_process_list.push_back(processid);
+    return true;
+}
 
 std::pair<thread *, process *>
 process_list::next_job()
@@ -133,6 +184,10 @@ process_list::next_job()
     // - We need to figure out which thread to execute and not just #0
     //
 
+    std::lock_guard<std::mutex> guard(m_process_mutex);
+
+    __wake_expired();
+
     if (m_process_list.empty())
         return {};
 
@@ -159,6 +214,8 @@ process_list::__add_process(processid::type processid, user_data *data)
 
     if (auto && process = m_process_factory->make_process(processid, data))
     {
+        process->account().set_parent(&m_account);
+
         std::lock_guard<std::mutex> guard(m_process_mutex);
 
         m_process_list.push_back(processid);
@@ -168,6 +225,45 @@ process_list::__add_process(processid::type processid, user_data *data)
     throw std::runtime_error("make_process returned a nullptr process");
 }
 
+void
+process_list::__wake_expired()
+{
+    // Note:
+    //
+    // There is no timer yet, so deadlines are checked whenever the
+    // scheduler looks at this process list. m_next_deadline keeps this
+    // down to a single compare unless a deadline has actually passed.
+    //
+
+    if (m_next_deadline == 0)
+        return;
+
+    auto &&now = __builtin_ia32_rdtsc();
+
+    if (now < m_next_deadline)
+        return;
+
+    m_next_deadline = 0;
+
+    for (auto iter = m_parked.begin(); iter != m_parked.end();)
+    {
+        auto &&deadline = iter->second;
+
+        if (deadline != 0 && deadline <= now)
+        {
+            m_process_list.push_back(iter->first);
+            iter = m_parked.erase(iter);
+
+            continue;
+        }
+
+        if (deadline != 0 && (m_next_deadline == 0 || deadline < m_next_deadline))
+            m_next_deadline = deadline;
+
+        ++iter;
+    }
+}
+
 std::unique_ptr<process> &
 process_list::__get_process(processid::type processid)
 {
@@ -19,6 +19,9 @@
 // License along with this library; if not, write to the Free Software
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
 
+#include <gsl/gsl>
+
+#include <domain/domain.h>
 #include <process_list_data.h>
 #include <process_list/process_list.h>
 #include <process_list/process_list_factory.h>
@@ -29,5 +32,16 @@ process_list_factory::make_process_list(processlistid::type processlistid, user_
     auto &&pld = dynamic_cast<process_list_data *>(data);
     expects(pld != nullptr);
 
+    // Note:
+    //
+    // The domain was acquired by the caller (see
+    // domain_manager::acquire_domain), and the process list takes over
+    // that reference, releasing it when it is destroyed. If the process
+    // list is never constructed, the reference is given back here.
+    //
+
+    auto ___ = gsl::on_failure([&]
+    { pld->m_domain->release_process_list(); });
+
     return std::make_unique<process_list>(processlistid, pld->m_domain);
 }
@@ -55,7 +55,6 @@ scheduler::yield()
     // - We need to setup the preemption timer so that we can preempt a task
     //   and move onto another
     // - We need a better algorithm than FCFS
-    // - We will need to be able to handle tasks sleeping
     // - We will need to be able to handle task total time, vs thread total
     //   time. Tasks should get 100ms, while a thread should only get 1-10ms.
     //
@@ -69,6 +68,22 @@ scheduler::yield()
         m_tasks.pop_front();
     }
 
+    // Note:
+    //
+    // A task with no jobs (e.g. all of its threads are parked in HLT) has
+    // nothing to run, so it is skipped in favor of the next task that
+    // does, or the host, which can always run.
+    //
+
+    for (auto i = 1UL; i < m_tasks.size(); i++)
+    {
+        if (m_tasks.front()->num_jobs() != 0 || m_tasks.front()->is_host())
+            break;
+
+        m_tasks.push_back(m_tasks.front());
+        m_tasks.pop_front();
+    }
+
     m_tasks.front()->schedule();
 }
 
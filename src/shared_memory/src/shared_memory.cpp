@@ -0,0 +1,68 @@
+//
+// Bareflank Hyperkernel
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#include <debug.h>
+#include <upper_lower.h>
+
+#include <shared_memory/shared_memory.h>
+#include <memory_manager/memory_manager_x64.h>
+
+shared_memory::shared_memory(shmid::type id, size_type size) :
+    m_id(id),
+    m_refs(0),
+    m_destroyed(false)
+{
+    if (size == 0)
+        throw std::invalid_argument("invalid shared memory size: " + std::to_string(size));
+
+    if (bfn::lower(size) != 0)
+        size = bfn::upper(size) + 0x1000;
+
+    for (auto i = 0UL; i < size; i += 0x1000)
+    {
+        auto &&page = std::make_unique<char[]>(0x1000);
+
+        m_phys.push_back(g_mm->virtptr_to_physint(page.get()));
+        m_pages.push_back(std::move(page));
+    }
+}
+
+shared_memory::integer_pointer
+shared_memory::phys(size_type index) const
+{ return m_phys.at(index); }
+
+void
+shared_memory::acquire()
+{
+    if (m_destroyed)
+        throw std::runtime_error("shared memory destroyed: " + std::to_string(m_id));
+
+    m_refs++;
+}
+
+void
+shared_memory::release()
+{
+    if (m_refs == 0)
+        throw std::runtime_error("shared memory not acquired: " + std::to_string(m_id));
+
+    m_refs--;
+}
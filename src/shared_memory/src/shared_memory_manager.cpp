@@ -0,0 +1,130 @@
+//
+// Bareflank Hyperkernel
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#include <gsl/gsl>
+
+#include <debug.h>
+#include <shared_memory/shared_memory_manager.h>
+
+// -----------------------------------------------------------------------------
+// Implementation
+// -----------------------------------------------------------------------------
+
+shared_memory_manager *
+shared_memory_manager::instance() noexcept
+{
+    static shared_memory_manager self;
+    return &self;
+}
+
+void
+shared_memory_manager::create_shared_memory(shmid::type shmid, size_type size)
+{
+    if (shmid == shmid::invalid)
+        throw std::invalid_argument("invalid shmid: " + std::to_string(shmid));
+
+    auto &&shm = std::make_unique<shared_memory>(shmid, size);
+
+    std::lock_guard<std::mutex> guard(m_shared_memory_mutex);
+
+    if (m_shared_memory.count(shmid) != 0)
+        throw std::runtime_error("shared memory already exists: " + std::to_string(shmid));
+
+    m_shared_memory[shmid] = std::move(shm);
+}
+
+void
+shared_memory_manager::destroy_shared_memory(shmid::type shmid)
+{
+    std::lock_guard<std::mutex> guard(m_shared_memory_mutex);
+
+    auto &&shm = __get_shared_memory(shmid);
+    shm->destroy();
+
+    // The name is removed right away. If the region is still mapped, the
+    // region itself is kept until the last reference is released.
+
+    if (shm->refs() != 0)
+        m_destroyed_shared_memory.push_back(std::move(shm));
+
+    m_shared_memory.erase(shmid);
+}
+
+gsl::not_null<shared_memory *>
+shared_memory_manager::acquire_shared_memory(shmid::type shmid)
+{
+    std::lock_guard<std::mutex> guard(m_shared_memory_mutex);
+
+    auto &&shm = __get_shared_memory(shmid);
+    shm->acquire();
+
+    return shm.get();
+}
+
+void
+shared_memory_manager::release_shared_memory(gsl::not_null<shared_memory *> shm)
+{
+    std::lock_guard<std::mutex> guard(m_shared_memory_mutex);
+
+    shm->release();
+
+    if (shm->is_destroyed() && shm->refs() == 0)
+    {
+        m_destroyed_shared_memory.remove_if([&](const auto & destroyed)
+        { return destroyed.get() == shm.get(); });
+    }
+}
+
+void
+shared_memory_manager::bind_receiver(shmid::type shmid, const channel_receiver &receiver)
+{
+    expects(receiver.proc != nullptr);
+
+    std::lock_guard<std::mutex> guard(m_shared_memory_mutex);
+    __get_shared_memory(shmid)->set_receiver(receiver);
+}
+
+void
+shared_memory_manager::unbind_receiver(gsl::not_null<shared_memory *> shm, const process *proc)
+{
+    std::lock_guard<std::mutex> guard(m_shared_memory_mutex);
+
+    if (shm->receiver().proc == proc)
+        shm->set_receiver({});
+}
+
+channel_receiver
+shared_memory_manager::get_receiver(shmid::type shmid)
+{
+    std::lock_guard<std::mutex> guard(m_shared_memory_mutex);
+    return __get_shared_memory(shmid)->receiver();
+}
+
+std::unique_ptr<shared_memory> &
+shared_memory_manager::__get_shared_memory(shmid::type shmid)
+{
+    auto &&iter = m_shared_memory.find(shmid);
+
+    if (iter == m_shared_memory.end())
+        throw std::runtime_error("unknown shared memory: " + std::to_string(shmid));
+
+    return iter->second;
+}
@@ -19,6 +19,8 @@
 // License along with this library; if not, write to the Free Software
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
 
+#include <exception.h>
+
 #include <task/task.h>
 #include <process_list/process_list.h>
 #include <scheduler/scheduler_manager.h>
@@ -32,20 +34,45 @@ task::task(
     m_coreid(coreid),
     m_vcpuid(vcpuid),
     m_proclt(proclt),
-    m_domain(domain)
+    m_domain(domain),
+    m_is_bound(false)
+{ this->bind(proclt, domain, vcpuid); }
+
+task::~task()
+{ this->unbind(); }
+
+void
+task::bind(
+    gsl::not_null<process_list *> proclt,
+    gsl::not_null<domain *> domain,
+    vcpuid::type vcpuid)
 {
+    expects(!m_is_bound);
+
     // TODO:
     //
     // Get rid of the need to talk to the scheduler manager. To do this, we
     // will need to be given the scheduler for this task.
     //
 
+    proclt->add_vcpu(vcpuid);
+    auto ___ = gsl::on_failure([&]
+    { proclt->remove_vcpu(vcpuid); });
+
     g_shm->add_task(m_coreid, this);
-    m_proclt->add_vcpu(m_vcpuid);
+
+    m_vcpuid = vcpuid;
+    m_proclt = proclt;
+    m_domain = domain;
+    m_is_bound = true;
 }
 
-task::~task()
+void
+task::unbind()
 {
+    if (!m_is_bound)
+        return;
+
     // TODO:
     //
     // Get rid of the need to talk to the scheduler manager. To do this, we
@@ -54,6 +81,8 @@ task::~task()
 
     m_proclt->remove_vcpu(m_vcpuid);
     g_shm->remove_task(m_coreid, this);
+
+    m_is_bound = false;
 }
 
 size_t task::num_jobs()
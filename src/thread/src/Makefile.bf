@@ -66,6 +66,9 @@ NATIVE_OUTDIR+=%BUILD_REL%/../bin
 
 SOURCES+=thread.cpp
 SOURCES+=thread_intel_x64.cpp
+SOURCES+=syscall_page_intel_x64.cpp
+SOURCES+=xsave_intel_x64.cpp
+SOURCES+=xsave_x64.asm
 
 INCLUDE_PATHS+=../../../include
 INCLUDE_PATHS+=%HYPER_ABS%/include/
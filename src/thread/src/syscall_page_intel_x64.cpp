@@ -0,0 +1,109 @@
+//
+// Bareflank Hyperkernel
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+
+#include <debug.h>
+#include <thread/thread_intel_x64.h>
+#include <thread/syscall_page_intel_x64.h>
+
+// -----------------------------------------------------------------------------
+// Implementation
+// -----------------------------------------------------------------------------
+
+syscall_page_manager *
+syscall_page_manager::instance() noexcept
+{
+    static syscall_page_manager self;
+    return &self;
+}
+
+void
+syscall_page_manager::set_page(gsl::not_null<thread_intel_x64 *> thrd, uintptr_t hpa)
+{
+    auto &&page = bfn::make_unique_map_x64<syscall_page_t>(hpa);
+    auto completed = page->completed;
+
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_pages[thrd.get()] = {std::move(page), completed};
+}
+
+void
+syscall_page_manager::release(thread_intel_x64 *thrd)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    m_pages.erase(thrd);
+}
+
+void
+syscall_page_manager::process(thread_intel_x64 *thrd, const handler_type &handler)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    auto &&iter = m_pages.find(thrd);
+    if (iter == m_pages.end())
+        return;
+
+    __process(thrd, iter->second, handler);
+}
+
+void
+syscall_page_manager::__process(
+    thread_intel_x64 *thrd, page_t &page, const handler_type &handler)
+{
+    // Note:
+    //
+    // The page is shared with a VM app that may be running on another
+    // core, so nothing in it is trusted. The position in the ring is kept
+    // by the VMM (page->completed is only a copy for the VM app), and an
+    // entry is only processed once the VM app has marked it as submitted.
+    // A request that fails (including one that throws) completes with
+    // SYSCALL_RET_FAILURE, so that a bad request can't stall the ring. A
+    // request that has to be retried stalls the ring on purpose, but only
+    // until the resource it is waiting for frees up.
+    //
+
+    auto &&shared = page.m_page.get();
+
+    while (true)
+    {
+        auto &&entry = shared->entries[page.m_completed % SYSCALL_PAGE_ENTRIES];
+
+        if (__atomic_load_n(&entry.status, __ATOMIC_ACQUIRE) != SYSCALL_STATUS_SUBMITTED)
+            break;
+
+        auto ret = SYSCALL_RET_FAILURE;
+
+        try
+        {
+            ret = handler(thrd, entry);
+        }
+        catch (...)
+        { }
+
+        if (ret == retry)
+            break;
+
+        entry.ret = ret;
+        __atomic_store_n(&entry.status, SYSCALL_STATUS_DONE, __ATOMIC_RELEASE);
+
+        __atomic_store_n(&shared->completed, ++page.m_completed, __ATOMIC_RELEASE);
+    }
+}
@@ -20,14 +20,46 @@
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
 
 #include <debug.h>
+#include <exception.h>
 #include <thread/thread_intel_x64.h>
+#include <thread/syscall_page_intel_x64.h>
 
 thread_intel_x64::thread_intel_x64(threadid::type id, gsl::not_null<process *> proc) :
     thread(id, proc),
     m_stack{},
-    m_state_save{}
+    m_state_save{},
+    m_xsave{},
+    m_ipc_waiting{false},
+    m_ipc_caller{nullptr},
+    m_ipc_callee{nullptr},
+    m_pending_events{0},
+    m_pending_device_events{0},
+    m_pending_notification{false},
+    m_event_entry{0},
+    m_in_event{false},
+    m_event_state_save{}
 { }
 
+thread_intel_x64::~thread_intel_x64()
+{
+    // Note:
+    //
+    // A thread that is deleted in the middle of an IPC is unlinked from
+    // the other side, so that a reply is not written into a thread that
+    // no longer exists. A caller whose server is deleted stays blocked
+    // until its own process is deleted.
+    //
+
+    if (m_ipc_callee != nullptr && m_ipc_callee->m_ipc_caller == this)
+        m_ipc_callee->m_ipc_caller = nullptr;
+
+    if (m_ipc_caller != nullptr && m_ipc_caller->m_ipc_callee == this)
+        m_ipc_caller->m_ipc_callee = nullptr;
+
+    g_spm->release(this);
+    g_xsm->release(this);
+}
+
 void
 thread_intel_x64::set_info(
     uintptr_t entry,
@@ -42,3 +74,81 @@ thread_intel_x64::set_info(
 
     m_stack = stack;
 }
+
+void
+thread_intel_x64::set_event_handler(uintptr_t entry)
+{ m_event_entry = entry; }
+
+void
+thread_intel_x64::post_events(uint64_t events)
+{ m_pending_events.fetch_or(events); }
+
+void
+thread_intel_x64::post_device_events(uint64_t devices)
+{ m_pending_device_events.fetch_or(devices); }
+
+bool
+thread_intel_x64::has_deliverable_events() const
+{
+    if (m_event_entry == 0 || m_in_event)
+        return false;
+
+    return m_pending_events.load() != 0 || m_pending_device_events.load() != 0;
+}
+
+void
+thread_intel_x64::notify()
+{ m_pending_notification = true; }
+
+bool
+thread_intel_x64::consume_notification()
+{ return m_pending_notification.exchange(false); }
+
+void
+thread_intel_x64::deliver_events(state_save_intel_x64 &state_save)
+{
+    if (!this->has_deliverable_events())
+        return;
+
+    // Note:
+    //
+    // The handler runs on the thread's own stack, below the red zone of
+    // the code that it interrupted, and is entered as if it was called
+    // (i.e. rsp + 8 is 16 byte aligned). Only the general purpose state
+    // is saved, so like a signal handler, an event handler should not
+    // touch the extended (SIMD) state.
+    //
+
+    constexpr const auto red_zone_size = 128UL;
+
+    m_in_event = true;
+    m_event_state_save = state_save;
+
+    state_save.rip = m_event_entry;
+    state_save.rsp = ((state_save.rsp - red_zone_size) & ~0xFUL) - sizeof(uintptr_t);
+    state_save.rdi = m_pending_events.exchange(0);
+    state_save.rsi = m_pending_device_events.exchange(0);
+}
+
+void
+thread_intel_x64::event_return(state_save_intel_x64 &state_save)
+{
+    expects(m_in_event);
+
+    // The thread might have been moved to another vCPU while it was in
+    // its handler, so the vCPU's own fields are kept.
+
+    auto old_vcpuid = state_save.vcpuid;
+    auto old_vmxon_ptr = state_save.vmxon_ptr;
+    auto old_vmcs_ptr = state_save.vmcs_ptr;
+    auto old_exit_handler_ptr = state_save.exit_handler_ptr;
+
+    state_save = m_event_state_save;
+
+    state_save.vcpuid = old_vcpuid;
+    state_save.vmxon_ptr = old_vmxon_ptr;
+    state_save.vmcs_ptr = old_vmcs_ptr;
+    state_save.exit_handler_ptr = old_exit_handler_ptr;
+
+    m_in_event = false;
+}
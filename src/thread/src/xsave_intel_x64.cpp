@@ -0,0 +1,189 @@
+//
+// Bareflank Hyperkernel
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#include <array>
+#include <cstring>
+
+#include <debug.h>
+#include <thread/thread_intel_x64.h>
+#include <thread/xsave_intel_x64.h>
+
+// -----------------------------------------------------------------------------
+// Implementation
+// -----------------------------------------------------------------------------
+
+xsave_manager *
+xsave_manager::instance() noexcept
+{
+    static xsave_manager self;
+    return &self;
+}
+
+xsave_manager::xsave_manager() :
+    m_area_size(0),
+    m_vm_xcr0(xcr0::x87 | xcr0::sse)
+{
+    std::array<uint32_t, 4> regs = {};
+    __cpuid_xsave(0, regs.data());
+
+    // CPUID.(EAX=0xD, ECX=0).ECX is the size of the XSAVE area needed
+    // for every feature the CPU supports, which covers both the host's
+    // XCR0 and the VM app's, so a single size works for every area.
+
+    auto &&supported = (static_cast<uint64_t>(regs.at(3)) << 32) | regs.at(0);
+    m_area_size = regs.at(2);
+
+    if ((supported & xcr0::avx) != 0)
+        m_vm_xcr0 |= xcr0::avx;
+
+    if ((supported & xcr0::avx512) == xcr0::avx512 && (m_vm_xcr0 & xcr0::avx) != 0)
+        m_vm_xcr0 |= xcr0::avx512;
+}
+
+thread_intel_x64 *
+xsave_manager::owner(coreid::type coreid) const
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    auto &&iter = m_cores.find(coreid);
+    if (iter == m_cores.end())
+        return nullptr;
+
+    return iter->second.m_owner;
+}
+
+void
+xsave_manager::switch_to_thread(coreid::type coreid, gsl::not_null<thread_intel_x64 *> thrd)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    auto &&core = m_cores[coreid];
+
+    if (core.m_owner == thrd.get())
+        return;
+
+    if (core.m_host_loaded)
+    {
+        if (!core.m_host_area)
+            core.m_host_area = __make_area();
+
+        core.m_host_xcr0 = __xgetbv(0);
+        __xsaveopt(core.m_host_area.m_area, core.m_host_xcr0);
+
+        if (core.m_host_xcr0 != m_vm_xcr0)
+            __xsetbv(0, m_vm_xcr0);
+
+        core.m_host_loaded = false;
+    }
+    else if (core.m_owner != nullptr)
+    {
+        __xsaveopt(core.m_owner->m_xsave.m_area, m_vm_xcr0);
+    }
+
+    if (!thrd->m_xsave)
+        thrd->m_xsave = __make_area();
+
+    for (auto &pair : m_cores)
+    {
+        if (pair.second.m_owner == thrd.get())
+            pair.second.m_owner = nullptr;
+    }
+
+    __xrstor(thrd->m_xsave.m_area, m_vm_xcr0);
+    core.m_owner = thrd;
+}
+
+void
+xsave_manager::save(coreid::type coreid, gsl::not_null<thread_intel_x64 *> thrd)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    auto &&iter = m_cores.find(coreid);
+    if (iter == m_cores.end())
+        return;
+
+    if (iter->second.m_owner == thrd.get())
+        __xsaveopt(thrd->m_xsave.m_area, m_vm_xcr0);
+}
+
+void
+xsave_manager::switch_to_host(coreid::type coreid)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    auto &&iter = m_cores.find(coreid);
+    if (iter == m_cores.end())
+        return;
+
+    auto &&core = iter->second;
+
+    if (core.m_host_loaded)
+        return;
+
+    if (core.m_owner != nullptr)
+        __xsaveopt(core.m_owner->m_xsave.m_area, m_vm_xcr0);
+
+    if (core.m_host_xcr0 != m_vm_xcr0)
+        __xsetbv(0, core.m_host_xcr0);
+
+    __xrstor(core.m_host_area.m_area, core.m_host_xcr0);
+
+    core.m_owner = nullptr;
+    core.m_host_loaded = true;
+}
+
+void
+xsave_manager::release(thread_intel_x64 *thrd)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    for (auto &pair : m_cores)
+    {
+        if (pair.second.m_owner == thrd)
+            pair.second.m_owner = nullptr;
+    }
+}
+
+xsave_area
+xsave_manager::__make_area() const
+{
+    constexpr const auto alignment = 64UL;
+    constexpr const auto mxcsr_offset = 24UL;
+    constexpr const auto mxcsr_default = 0x1F80U;
+
+    xsave_area area;
+
+    area.m_mem = std::make_unique<char[]>(m_area_size + alignment);
+    area.m_area = reinterpret_cast<char *>(
+                      (reinterpret_cast<uintptr_t>(area.m_mem.get()) + alignment - 1) & ~(alignment - 1));
+
+    // Note:
+    //
+    // A zeroed XSAVE header (XSTATE_BV == 0) tells XRSTOR to put every
+    // component in its init state. MXCSR is the exception, as XRSTOR
+    // always loads it from the legacy region, so it is given its
+    // default value (all exceptions masked).
+    //
+
+    memcpy(area.m_area + mxcsr_offset, &mxcsr_default, sizeof(mxcsr_default));
+
+    return area;
+}
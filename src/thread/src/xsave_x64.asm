@@ -0,0 +1,85 @@
+;
+; Bareflank Hyperkernel
+;
+; Copyright (C) 2015 Assured Information Security, Inc.
+; Author: Rian Quinn        <quinnr@ainfosec.com>
+; Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+;
+; This library is free software; you can redistribute it and/or
+; modify it under the terms of the GNU Lesser General Public
+; License as published by the Free Software Foundation; either
+; version 2.1 of the License, or (at your option) any later version.
+;
+; This library is distributed in the hope that it will be useful,
+; but WITHOUT ANY WARRANTY; without even the implied warranty of
+; MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+; Lesser General Public License for more details.
+;
+; You should have received a copy of the GNU Lesser General Public
+; License along with this library; if not, write to the Free Software
+; Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+bits 64
+default rel
+
+section .text
+
+; uint64_t __xgetbv(uint64_t xcr)
+;
+global __xgetbv
+__xgetbv:
+    mov ecx, edi
+    xgetbv
+    shl rdx, 32
+    or rax, rdx
+    ret
+
+; void __xsetbv(uint64_t xcr, uint64_t value)
+;
+global __xsetbv
+__xsetbv:
+    mov ecx, edi
+    mov rax, rsi
+    mov rdx, rsi
+    shr rdx, 32
+    xsetbv
+    ret
+
+; void __xsaveopt(void *area, uint64_t rfbm)
+;
+global __xsaveopt
+__xsaveopt:
+    mov rax, rsi
+    mov rdx, rsi
+    shr rdx, 32
+    xsaveopt64 [rdi]
+    ret
+
+; void __xrstor(void *area, uint64_t rfbm)
+;
+global __xrstor
+__xrstor:
+    mov rax, rsi
+    mov rdx, rsi
+    shr rdx, 32
+    xrstor64 [rdi]
+    ret
+
+; void __cpuid_xsave(uint64_t subleaf, uint32_t regs[4])
+;
+; Executes CPUID leaf 0xD (processor extended state enumeration) and
+; stores eax, ebx, ecx and edx into regs.
+;
+global __cpuid_xsave
+__cpuid_xsave:
+    push rbx
+    mov r8, rsi
+    mov eax, 0xD
+    mov ecx, edi
+    cpuid
+    mov [r8 + 0x0], eax
+    mov [r8 + 0x4], ebx
+    mov [r8 + 0x8], ecx
+    mov [r8 + 0xC], edx
+    pop rbx
+    ret
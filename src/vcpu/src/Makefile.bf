@@ -65,6 +65,8 @@ NATIVE_OUTDIR+=%BUILD_REL%/../bin
 ################################################################################
 
 SOURCES+=vcpu_intel_x64_hyperkernel.cpp
+SOURCES+=vcpu_pool.cpp
+SOURCES+=vcpuid_allocator.cpp
 
 INCLUDE_PATHS+=../../../include
 INCLUDE_PATHS+=%HYPER_ABS%/include/
@@ -20,6 +20,7 @@
 // Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
 
 #include <gsl/gsl>
+#include <debug.h>
 
 #include <vcpu/vcpu_intel_x64_hyperkernel.h>
 #include <vmcs/vmcs_intel_x64_hyperkernel.h>
@@ -36,9 +37,15 @@
 
 #include <thread/thread.h>
 #include <thread/thread_intel_x64.h>
+#include <thread/xsave_intel_x64.h>
 
 #include <process_list/process_list.h>
 
+#include <vcpu/vcpu_pool.h>
+#include <vcpu/vcpuid_allocator.h>
+
+#include <vpid_allocator.h>
+
 vcpu_intel_x64_hyperkernel::vcpu_intel_x64_hyperkernel(
     coreid::type coreid,
     vcpuid::type vcpuid,
@@ -67,11 +74,30 @@ vcpu_intel_x64_hyperkernel::vcpu_intel_x64_hyperkernel(
         domain),
 
     m_coreid(coreid),
+    m_is_host((vcpuid >> vcpuid::guest_from) == 0),
+    m_pending_cr3(0),
     m_proclt(proclt),
     m_domain(domain),
     m_vmcs_hyperkernel(dynamic_cast<vmcs_intel_x64_hyperkernel *>(m_vmcs.get())),
     m_exit_handler_hyperkernel(dynamic_cast<exit_handler_intel_x64_hyperkernel *>(m_exit_handler.get()))
-{ }
+{
+    m_exit_handler_hyperkernel->set_field_cache(m_vmcs_hyperkernel->field_cache());
+    m_exit_handler_hyperkernel->set_exit_stats(m_vmcs_hyperkernel->exit_stats());
+
+    if (!m_is_host)
+        g_vid->set(this->id(), this);
+}
+
+vcpu_intel_x64_hyperkernel::~vcpu_intel_x64_hyperkernel()
+{
+    if (!m_is_host)
+    {
+        g_vpl->remove(this);
+
+        if (this->is_bound())
+            g_vid->release(this->bound_vcpuid());
+    }
+}
 
 void
 vcpu_intel_x64_hyperkernel::init(user_data *data)
@@ -79,7 +105,23 @@ vcpu_intel_x64_hyperkernel::init(user_data *data)
 
 void
 vcpu_intel_x64_hyperkernel::fini(user_data *data)
-{ vcpu_intel_x64::fini(data); }
+{
+    auto &&stats = m_vmcs_hyperkernel->field_cache()->stats();
+
+    if (stats.exits != 0)
+    {
+        bfdebug << "vcpu " << this->id() << " vmcs field cache:" << bfendl;
+        bfdebug << "    - exits: " << stats.exits << bfendl;
+        bfdebug << "    - vmreads: " << stats.vmreads
+                << " (saved " << stats.vmreads_saved << ")" << bfendl;
+        bfdebug << "    - vmwrites: " << stats.vmwrites
+                << " (saved " << stats.vmwrites_saved << ")" << bfendl;
+        bfdebug << "    - saved per 1000 exits: "
+                << ((stats.vmreads_saved + stats.vmwrites_saved) * 1000) / stats.exits << bfendl;
+    }
+
+    vcpu_intel_x64::fini(data);
+}
 
 void
 vcpu_intel_x64_hyperkernel::run(user_data *data)
@@ -139,19 +181,80 @@ vcpu_intel_x64_hyperkernel::schedule(process_intel_x64 *proc, thread_intel_x64 *
         m_state_save->vmcs_ptr = old_vmcs_ptr;
         m_state_save->exit_handler_ptr = old_exit_handler_ptr;
 
+        proc->set_home_core(m_coreid);
+
+        // VPIDs that were released (on any core) are invalidated on this
+        // core before it runs a process that may have been given one.
+
+        vpid_allocator::instance()->flush(m_coreid);
+        m_vmcs_hyperkernel->set_vpid(proc->vpid(), this->is_running());
+
         if (this->is_running())
-            m_vmcs_hyperkernel->set_eptp(proc->eptp());
+        {
+            auto &&cache = m_vmcs_hyperkernel->field_cache();
+
+            if (cache->update_eptp(proc->eptp()))
+                m_vmcs_hyperkernel->set_eptp(proc->eptp());
+
+            if (m_pending_cr3 != 0)
+            {
+                cache->set_guest_cr3(m_pending_cr3);
+                m_pending_cr3 = 0;
+            }
+
+            // Unless the thread already owns this core's extended state,
+            // CR0.TS is set so that its first use of SIMD traps (#NM), and
+            // the state is switched then (see xsave_manager).
+
+            auto &&cr0 = cache->guest_cr0();
+
+            if (g_xsm->owner(m_coreid) == thrd)
+                cache->set_guest_cr0(cr0 & ~intel_x64::cr0::task_switched::mask);
+            else
+                cache->set_guest_cr0(cr0 | intel_x64::cr0::task_switched::mask);
+        }
         else
+        {
             m_state_save->user1 = proc->eptp();
+
+            // A launch does not go through vmcs_intel_x64_hyperkernel::resume,
+            // so events that were posted before the first run are
+            // delivered here.
+
+            thrd->deliver_events(*m_state_save);
+        }
+    }
+    else if (m_is_host)
+    {
+        g_xsm->switch_to_host(m_coreid);
     }
 
+    m_vmcs_hyperkernel->set_current_thread(thrd);
     m_exit_handler_hyperkernel->set_current_thread(thrd);
     run();
 }
 
-vcpuid::type
-vcpu_intel_x64_hyperkernel::next_vcpuid()
+void
+vcpu_intel_x64_hyperkernel::rebind(
+    gsl::not_null<process_list *> proclt,
+    gsl::not_null<domain_intel_x64 *> domain,
+    vcpuid::type vcpuid)
 {
-    static vcpuid::type g_guest_vcpuids = (1UL << vcpuid::guest_from);
-    return g_guest_vcpuids++;
+    task::bind(proclt, domain, vcpuid);
+
+    m_proclt = proclt;
+    m_domain = domain;
+
+    m_vmcs_hyperkernel->rebind(proclt, domain, vcpuid);
+    m_exit_handler_hyperkernel->rebind(proclt, domain, vcpuid);
+
+    if (auto &&guest_state = dynamic_cast<vmcs_intel_x64_guest_vm_state *>(m_guest_state.get()))
+        guest_state->rebind(proclt, domain);
+
+    if (this->is_running())
+        m_pending_cr3 = domain->cr3();
 }
+
+vcpuid::type
+vcpu_intel_x64_hyperkernel::next_vcpuid(coreid::type coreid)
+{ return g_vid->acquire(coreid); }
@@ -0,0 +1,215 @@
+//
+// Bareflank Hyperkernel
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#include <gsl/gsl>
+
+#include <debug.h>
+#include <exception.h>
+#include <vcpu_data_intel_x64.h>
+
+#include <vcpu/vcpu_pool.h>
+#include <vcpu/vcpu_manager.h>
+#include <vcpu/vcpuid_allocator.h>
+#include <vcpu/vcpu_intel_x64_hyperkernel.h>
+
+vcpu_pool *
+vcpu_pool::instance() noexcept
+{
+    static vcpu_pool self;
+    return &self;
+}
+
+vcpuid::type
+vcpu_pool::create_vcpu(gsl::not_null<vcpu_data_intel_x64 *> vd)
+{
+    expects(vd->m_proclt != nullptr);
+    expects(vd->m_domain != nullptr);
+
+    if (auto &&vcpu = __acquire(vd->m_coreid))
+    {
+        auto ___ = gsl::on_failure([&]
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            m_pool[vd->m_coreid].push_front(vcpu);
+        });
+
+        // A pooled vCPU's old id was released when it was pooled, so it is
+        // given a new one here, and anything still holding an old id
+        // (e.g. a second delete_vcpu) cannot reach the vCPU anymore.
+
+        auto &&vcpuid = vcpu_intel_x64_hyperkernel::next_vcpuid(vd->m_coreid);
+        auto ____ = gsl::on_failure([&]
+        { g_vid->release(vcpuid); });
+
+        g_vid->set(vcpuid, vcpu);
+        vcpu->rebind(vd->m_proclt, vd->m_domain, vcpuid);
+
+        return vcpuid;
+    }
+
+    auto &&vcpuid = vcpu_intel_x64_hyperkernel::next_vcpuid(vd->m_coreid);
+    auto ___ = gsl::on_failure([&]
+    { g_vid->release(vcpuid); });
+
+    g_vcm->create_vcpu(vcpuid, vd.get());
+    return vcpuid;
+}
+
+bool
+vcpu_pool::delete_vcpu(vcpuid::type vcpuid)
+{
+    auto &&vcpu = g_vid->lookup(vcpuid);
+
+    if (vcpu == nullptr)
+        return false;
+
+    // Note:
+    //
+    // Only bound vCPUs have a live id, and only one release of an id can
+    // succeed, so releasing the id is what claims the vCPU. A concurrent
+    // (or repeated) delete_vcpu of the same id fails here, and so does one
+    // whose id died because the vCPU was pooled (and maybe rebound) in the
+    // meantime. The vCPU is not touched until the release succeeds, as a
+    // delete_vcpu that lost the race might be looking at a deleted vCPU.
+    //
+
+    if (!g_vid->release(vcpuid))
+        return false;
+
+    vcpu->unbind();
+
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        if (m_pool[vcpu->coreid()].size() < m_pool_size)
+        {
+            m_pool[vcpu->coreid()].push_back(vcpu);
+            return true;
+        }
+    }
+
+    g_vcm->delete_vcpu(vcpu->id());
+    return true;
+}
+
+void
+vcpu_pool::set_pool_size(std::size_t size)
+{
+    std::list<vcpuid::type> extra;
+
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        m_pool_size = size;
+        for (auto &&pool : m_pool)
+        {
+            while (pool.second.size() > m_pool_size)
+            {
+                extra.push_back(pool.second.back()->id());
+                pool.second.pop_back();
+            }
+        }
+    }
+
+    for (const auto &vcpuid : extra)
+        g_vcm->delete_vcpu(vcpuid);
+}
+
+std::size_t
+vcpu_pool::refill(gsl::not_null<vcpu_data_intel_x64 *> vd, std::size_t max)
+{
+    auto &&added = 0UL;
+
+    for (; added < max; added++)
+    {
+        {
+            std::lock_guard<std::mutex> guard(m_mutex);
+
+            if (m_pool[vd->m_coreid].size() >= m_pool_size)
+                break;
+        }
+
+        auto &&vcpuid = vcpu_intel_x64_hyperkernel::next_vcpuid(vd->m_coreid);
+        auto ___ = gsl::on_failure([&]
+        { g_vid->release(vcpuid); });
+
+        g_vcm->create_vcpu(vcpuid, vd.get());
+
+        auto &&vcpu = g_vid->lookup(vcpuid);
+
+        vcpu->unbind();
+        g_vid->release(vcpuid);
+
+        std::lock_guard<std::mutex> guard(m_mutex);
+
+        m_pool[vd->m_coreid].push_back(vcpu);
+    }
+
+    return added;
+}
+
+std::size_t
+vcpu_pool::pool_size() const
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+    return m_pool_size;
+}
+
+std::size_t
+vcpu_pool::pooled_vcpus(coreid::type coreid) const
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    auto &&iter = m_pool.find(coreid);
+    if (iter == m_pool.end())
+        return 0;
+
+    return iter->second.size();
+}
+
+void
+vcpu_pool::remove(gsl::not_null<vcpu_intel_x64_hyperkernel *> vcpu) noexcept
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    auto &&iter = m_pool.find(vcpu->coreid());
+    if (iter != m_pool.end())
+        iter->second.remove(vcpu);
+}
+
+vcpu_pool::vcpu_pool() noexcept :
+    m_pool_size(0)
+{ }
+
+vcpu_intel_x64_hyperkernel *
+vcpu_pool::__acquire(coreid::type coreid)
+{
+    std::lock_guard<std::mutex> guard(m_mutex);
+
+    auto &&iter = m_pool.find(coreid);
+    if (iter == m_pool.end() || iter->second.empty())
+        return nullptr;
+
+    auto vcpu = iter->second.front();
+    iter->second.pop_front();
+
+    return vcpu;
+}
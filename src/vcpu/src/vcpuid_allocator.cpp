@@ -0,0 +1,191 @@
+//
+// Bareflank Hyperkernel
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#include <string>
+#include <stdexcept>
+
+#include <vcpu/vcpuid_allocator.h>
+
+// Note:
+//
+// The head of a core's free list holds the index of the top slot (plus 1,
+// so that 0 means empty) in its lower half, and a tag in its upper half
+// that is incremented on every push and pop.
+//
+
+constexpr const auto head_index_mask = 0x00000000FFFFFFFFUL;
+constexpr const auto head_tag_from = 32;
+
+vcpuid_allocator *
+vcpuid_allocator::instance() noexcept
+{
+    static vcpuid_allocator self;
+    return &self;
+}
+
+vcpuid_allocator::~vcpuid_allocator()
+{
+    for (auto &&table : m_tables)
+        delete table.load();
+}
+
+vcpuid::type
+vcpuid_allocator::acquire(coreid::type coreid)
+{
+    auto &&table = __table(coreid);
+    auto &&head = table->m_free.load(std::memory_order_acquire);
+
+    while ((head & head_index_mask) != 0)
+    {
+        auto &&index = (head & head_index_mask) - 1;
+        auto &&next = table->m_slots.at(index).m_next.load(std::memory_order_relaxed);
+        auto &&tag = (head >> head_tag_from) + 1;
+
+        if (table->m_free.compare_exchange_weak(head, (tag << head_tag_from) | next,
+                                                std::memory_order_acq_rel, std::memory_order_acquire))
+        {
+            auto &&generation = table->m_slots.at(index).m_generation.load(std::memory_order_acquire);
+            return __make_id(coreid, index, generation);
+        }
+    }
+
+    auto &&index = table->m_next_unused.fetch_add(1, std::memory_order_acq_rel);
+    if (index >= max_vcpus_per_core)
+    {
+        table->m_next_unused.fetch_sub(1, std::memory_order_acq_rel);
+        throw std::runtime_error("out of vcpu ids on core: " + std::to_string(coreid));
+    }
+
+    return __make_id(coreid, index, table->m_slots.at(index).m_generation.load(std::memory_order_acquire));
+}
+
+bool
+vcpuid_allocator::release(vcpuid::type vcpuid) noexcept
+{
+    auto &&s = __slot(vcpuid);
+    if (s == nullptr)
+        return false;
+
+    // The generation is bumped first, so that only one release of an id
+    // can succeed, and so that the id is dead before the slot can be
+    // handed out again.
+
+    auto &&generation = vcpuid >> generation_from;
+    auto &&next_generation = (generation + 1) & generation_mask;
+
+    if (next_generation == 0)
+        next_generation = 1;
+
+    if (!s->m_generation.compare_exchange_strong(generation, next_generation, std::memory_order_acq_rel))
+        return false;
+
+    s->m_vcpu.store(nullptr, std::memory_order_release);
+
+    auto &&table = m_tables.at(vcpuid & ((1UL << vcpuid::guest_from) - 1)).load(std::memory_order_acquire);
+    auto &&index = (vcpuid >> vcpuid::guest_from) & ((1UL << index_bits) - 1);
+    auto &&head = table->m_free.load(std::memory_order_acquire);
+
+    while (true)
+    {
+        auto &&tag = (head >> head_tag_from) + 1;
+        s->m_next.store(head & head_index_mask, std::memory_order_relaxed);
+
+        if (table->m_free.compare_exchange_weak(head, (tag << head_tag_from) | (index + 1),
+                                                std::memory_order_acq_rel, std::memory_order_acquire))
+        {
+            return true;
+        }
+    }
+}
+
+bool
+vcpuid_allocator::set(vcpuid::type vcpuid, vcpu_intel_x64_hyperkernel *vcpu) noexcept
+{
+    auto &&s = __slot(vcpuid);
+    if (s == nullptr)
+        return false;
+
+    if (s->m_generation.load(std::memory_order_acquire) != (vcpuid >> generation_from))
+        return false;
+
+    s->m_vcpu.store(vcpu, std::memory_order_release);
+    return true;
+}
+
+vcpu_intel_x64_hyperkernel *
+vcpuid_allocator::lookup(vcpuid::type vcpuid) const noexcept
+{
+    auto &&s = __slot(vcpuid);
+    if (s == nullptr)
+        return nullptr;
+
+    if (s->m_generation.load(std::memory_order_acquire) != (vcpuid >> generation_from))
+        return nullptr;
+
+    return s->m_vcpu.load(std::memory_order_acquire);
+}
+
+vcpuid_allocator::core_table *
+vcpuid_allocator::__table(coreid::type coreid)
+{
+    if (coreid >= max_cores)
+        throw std::invalid_argument("invalid coreid: " + std::to_string(coreid));
+
+    auto &&entry = m_tables.at(coreid);
+
+    if (auto &&table = entry.load(std::memory_order_acquire))
+        return table;
+
+    // Note:
+    //
+    // A core's table is only created the first time the core creates a
+    // vCPU. If two cores race to create the same table (which only
+    // happens if a vCPU is created for a core from another core), the
+    // loser's table is deleted.
+    //
+
+    auto &&table = std::make_unique<core_table>();
+    core_table *expected = nullptr;
+
+    if (entry.compare_exchange_strong(expected, table.get(), std::memory_order_acq_rel))
+        return table.release();
+
+    return expected;
+}
+
+vcpuid_allocator::slot *
+vcpuid_allocator::__slot(vcpuid::type vcpuid) const noexcept
+{
+    if ((vcpuid >> 63) != 0 || (vcpuid >> generation_from) == 0)
+        return nullptr;
+
+    auto &&coreid = vcpuid & ((1UL << vcpuid::guest_from) - 1);
+    auto &&index = (vcpuid >> vcpuid::guest_from) & ((1UL << index_bits) - 1);
+
+    if (coreid >= max_cores || index >= max_vcpus_per_core)
+        return nullptr;
+
+    auto &&table = m_tables.at(coreid).load(std::memory_order_acquire);
+    if (table == nullptr || index >= table->m_next_unused.load(std::memory_order_acquire))
+        return nullptr;
+
+    return &table->m_slots.at(index);
+}
@@ -33,9 +33,12 @@ LIBRARY_PATH := $(LIBRARY_PATH):%BUILD_ABS%/makefiles/extended_apis/src/exit_han
 LIBRARY_PATH := $(LIBRARY_PATH):%BUILD_ABS%/makefiles/extended_apis/src/vmcs/bin/native
 LIBRARY_PATH := $(LIBRARY_PATH):%BUILD_ABS%/makefiles/hyperkernel/src/domain/bin/native
 LIBRARY_PATH := $(LIBRARY_PATH):%BUILD_ABS%/makefiles/hyperkernel/src/domain_factory/bin/native
+LIBRARY_PATH := $(LIBRARY_PATH):%BUILD_ABS%/makefiles/hyperkernel/src/driver/bin/native
 LIBRARY_PATH := $(LIBRARY_PATH):%BUILD_ABS%/makefiles/hyperkernel/src/exit_handler/bin/native
+LIBRARY_PATH := $(LIBRARY_PATH):%BUILD_ABS%/makefiles/hyperkernel/src/frame_allocator/bin/native
 LIBRARY_PATH := $(LIBRARY_PATH):%BUILD_ABS%/makefiles/hyperkernel/src/scheduler/bin/native
 LIBRARY_PATH := $(LIBRARY_PATH):%BUILD_ABS%/makefiles/hyperkernel/src/scheduler_factory/bin/native
+LIBRARY_PATH := $(LIBRARY_PATH):%BUILD_ABS%/makefiles/hyperkernel/src/shared_memory/bin/native
 LIBRARY_PATH := $(LIBRARY_PATH):%BUILD_ABS%/makefiles/hyperkernel/src/task/bin/native
 LIBRARY_PATH := $(LIBRARY_PATH):%BUILD_ABS%/makefiles/hyperkernel/src/task_factory/bin/native
 LIBRARY_PATH := $(LIBRARY_PATH):%BUILD_ABS%/makefiles/hyperkernel/src/vcpu/bin/native
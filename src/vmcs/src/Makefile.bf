@@ -64,6 +64,8 @@ NATIVE_OUTDIR+=%BUILD_REL%/../bin
 # Sources
 ################################################################################
 
+SOURCES+=vmcs_intel_x64_exit_stats.cpp
+SOURCES+=vmcs_intel_x64_field_cache.cpp
 SOURCES+=vmcs_intel_x64_hyperkernel.cpp
 SOURCES+=vmcs_intel_x64_guest_vm_state.cpp
 
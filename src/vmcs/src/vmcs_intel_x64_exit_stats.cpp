@@ -0,0 +1,89 @@
+//
+// Bareflank Hyperkernel
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#include <map>
+
+#include <vmcs/vmcs_intel_x64_exit_stats.h>
+
+static std::mutex g_exit_stats_mutex;
+static std::map<vcpuid::type, vmcs_intel_x64_exit_stats *> g_exit_stats;
+
+void
+vmcs_intel_x64_exit_stats::end_exit() noexcept
+{
+    if (m_start == 0)
+        return;
+
+    auto &&cycles = __builtin_ia32_rdtsc() - m_start;
+    auto &&bucket = 0UL;
+
+    if (cycles != 0)
+        bucket = 63UL - static_cast<value_type>(__builtin_clzl(cycles));
+
+    if (bucket >= num_buckets)
+        bucket = num_buckets - 1;
+
+    m_histogram[bucket]++;
+    m_start = 0;
+}
+
+void
+vmcs_intel_x64_exit_stats::attach(vcpuid::type vcpuid)
+{
+    std::lock_guard<std::mutex> guard(g_exit_stats_mutex);
+    g_exit_stats[vcpuid] = this;
+}
+
+void
+vmcs_intel_x64_exit_stats::detach(vcpuid::type vcpuid) noexcept
+{
+    std::lock_guard<std::mutex> guard(g_exit_stats_mutex);
+
+    auto &&iter = g_exit_stats.find(vcpuid);
+    if (iter != g_exit_stats.end() && iter->second == this)
+        g_exit_stats.erase(iter);
+}
+
+bool
+vmcs_intel_x64_exit_stats::count(vcpuid::type vcpuid, value_type reason, value_type &ret)
+{
+    std::lock_guard<std::mutex> guard(g_exit_stats_mutex);
+
+    auto &&iter = g_exit_stats.find(vcpuid);
+    if (iter == g_exit_stats.end())
+        return false;
+
+    ret = iter->second->count(reason);
+    return true;
+}
+
+bool
+vmcs_intel_x64_exit_stats::histogram(vcpuid::type vcpuid, value_type bucket, value_type &ret)
+{
+    std::lock_guard<std::mutex> guard(g_exit_stats_mutex);
+
+    auto &&iter = g_exit_stats.find(vcpuid);
+    if (iter == g_exit_stats.end())
+        return false;
+
+    ret = iter->second->histogram(bucket);
+    return true;
+}
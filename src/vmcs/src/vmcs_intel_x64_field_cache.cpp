@@ -0,0 +1,108 @@
+//
+// Bareflank Hyperkernel
+//
+// Copyright (C) 2015 Assured Information Security, Inc.
+// Author: Rian Quinn        <quinnr@ainfosec.com>
+// Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+//
+// This library is free software; you can redistribute it and/or
+// modify it under the terms of the GNU Lesser General Public
+// License as published by the Free Software Foundation; either
+// version 2.1 of the License, or (at your option) any later version.
+//
+// This library is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+// Lesser General Public License for more details.
+//
+// You should have received a copy of the GNU Lesser General Public
+// License along with this library; if not, write to the Free Software
+// Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+
+#include <vmcs/vmcs_intel_x64_field_cache.h>
+
+#include <vmcs/vmcs_intel_x64_32bit_read_only_data_fields.h>
+#include <vmcs/vmcs_intel_x64_64bit_read_only_data_fields.h>
+#include <vmcs/vmcs_intel_x64_natural_width_guest_state_fields.h>
+#include <vmcs/vmcs_intel_x64_natural_width_read_only_data_fields.h>
+
+using namespace intel_x64;
+
+void
+vmcs_intel_x64_field_cache::begin_exit() noexcept
+{
+    m_exit_qualification.m_valid = false;
+    m_guest_physical_address.m_valid = false;
+    m_vm_exit_interruption_information.m_valid = false;
+
+    m_guest_cr0.m_valid = false;
+    m_guest_cr3.m_valid = false;
+
+    m_stats.exits++;
+}
+
+void
+vmcs_intel_x64_field_cache::invalidate() noexcept
+{
+    m_exit_qualification.m_valid = false;
+    m_guest_physical_address.m_valid = false;
+    m_vm_exit_interruption_information.m_valid = false;
+
+    m_guest_cr0.m_valid = false;
+    m_guest_cr3.m_valid = false;
+
+    m_eptp.m_valid = false;
+    m_vpid.m_valid = false;
+}
+
+vmcs_intel_x64_field_cache::value_type
+vmcs_intel_x64_field_cache::exit_qualification()
+{ return __read(m_exit_qualification, [] { return vmcs::exit_qualification::get(); }); }
+
+vmcs_intel_x64_field_cache::value_type
+vmcs_intel_x64_field_cache::guest_physical_address()
+{ return __read(m_guest_physical_address, [] { return vmcs::guest_physical_address::get(); }); }
+
+vmcs_intel_x64_field_cache::value_type
+vmcs_intel_x64_field_cache::vm_exit_interruption_information()
+{ return __read(m_vm_exit_interruption_information, [] { return vmcs::vm_exit_interruption_information::get(); }); }
+
+vmcs_intel_x64_field_cache::value_type
+vmcs_intel_x64_field_cache::guest_cr0()
+{ return __read(m_guest_cr0, [] { return vmcs::guest_cr0::get(); }); }
+
+void
+vmcs_intel_x64_field_cache::set_guest_cr0(value_type val)
+{ __write(m_guest_cr0, val, [](value_type v) { vmcs::guest_cr0::set(v); }); }
+
+vmcs_intel_x64_field_cache::value_type
+vmcs_intel_x64_field_cache::guest_cr3()
+{ return __read(m_guest_cr3, [] { return vmcs::guest_cr3::get(); }); }
+
+void
+vmcs_intel_x64_field_cache::set_guest_cr3(value_type val)
+{ __write(m_guest_cr3, val, [](value_type v) { vmcs::guest_cr3::set(v); }); }
+
+bool
+vmcs_intel_x64_field_cache::update_eptp(value_type eptp) noexcept
+{ return __update(m_eptp, eptp); }
+
+bool
+vmcs_intel_x64_field_cache::update_vpid(value_type vpid) noexcept
+{ return __update(m_vpid, vpid); }
+
+bool
+vmcs_intel_x64_field_cache::__update(field &f, value_type val) noexcept
+{
+    if (f.m_valid && f.m_value == val)
+    {
+        m_stats.vmwrites_saved++;
+        return false;
+    }
+
+    f.m_value = val;
+    f.m_valid = true;
+
+    m_stats.vmwrites++;
+    return true;
+}
@@ -66,6 +66,7 @@ vmcs_intel_x64_guest_vm_state::vmcs_intel_x64_guest_vm_state(
     m_cr0 |= cr0::numeric_error::mask;
     m_cr0 |= cr0::write_protect::mask;
     m_cr0 |= cr0::paging::mask;
+    m_cr0 |= cr0::task_switched::mask;
 
     m_cr3 = m_domain->cr3();
 
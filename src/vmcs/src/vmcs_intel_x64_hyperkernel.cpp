@@ -21,7 +21,11 @@
 
 #include <vmcs/vmcs_intel_x64_hyperkernel.h>
 #include <vmcs/vmcs_intel_x64_guest_vm_state.h>
+#include <thread/thread_intel_x64.h>
+
+#include <vmcs/vmcs_intel_x64_16bit_control_fields.h>
 #include <vmcs/vmcs_intel_x64_32bit_control_fields.h>
+#include <vmcs/vmcs_intel_x64_natural_width_control_fields.h>
 
 using namespace x64;
 using namespace intel_x64;
@@ -36,8 +40,24 @@ vmcs_intel_x64_hyperkernel::vmcs_intel_x64_hyperkernel(
     m_coreid(coreid),
     m_vcpuid(vcpuid),
     m_proclt(proclt),
-    m_domain(domain)
-{ }
+    m_domain(domain),
+    m_vpid(0),
+    m_thread(nullptr)
+{ m_exit_stats.attach(vcpuid); }
+
+vmcs_intel_x64_hyperkernel::~vmcs_intel_x64_hyperkernel()
+{ m_exit_stats.detach(m_vcpuid); }
+
+void
+vmcs_intel_x64_hyperkernel::resume()
+{
+    m_exit_stats.end_exit();
+
+    if (m_thread != nullptr)
+        m_thread->deliver_events(*m_state_save);
+
+    vmcs_intel_x64_eapis::resume();
+}
 
 void
 vmcs_intel_x64_hyperkernel::write_fields(
@@ -46,12 +66,32 @@ vmcs_intel_x64_hyperkernel::write_fields(
 {
     vmcs_intel_x64_eapis::write_fields(host_state, guest_state);
 
+    // The fields are written directly below, so nothing that the cache
+    // knows about the VMCS can be trusted after this.
+    //
+    m_field_cache.invalidate();
+
     this->enable_vpid();
 
     if (guest_state->is_guest())
     {
         primary_processor_based_vm_execution_controls::hlt_exiting::enable();
 
+        // The VM app's extended state is switched lazily, so #NM (which
+        // the guest takes when it uses SIMD while CR0.TS is set) traps to
+        // the VMM. See xsave_manager.
+        //
+        exception_bitmap::set(exception_bitmap::get() | (1UL << 7));
+
+        // VM apps run in ring 0, so without this, a VM app could clear
+        // CR0.TS itself (CLTS, LMSW or MOV to CR0) and read the extended
+        // state of the core's previous owner without taking the #NM. TS is
+        // owned by the VMM, and since the read shadow always has TS set,
+        // any attempt to clear it exits (see handle_cr_access).
+        //
+        cr0_guest_host_mask::set(cr0::task_switched::mask);
+        cr0_read_shadow::set(cr0::task_switched::mask);
+
         // TODO:
         //
         // We should do some simple sanity checks on user1
@@ -59,5 +99,34 @@ vmcs_intel_x64_hyperkernel::write_fields(
 
         this->enable_ept();
         this->set_eptp(m_state_save->user1);
+
+        if (m_vpid != 0)
+            vmcs::virtual_processor_identifier::set(m_vpid);
     }
 }
+
+void
+vmcs_intel_x64_hyperkernel::rebind(
+    gsl::not_null<process_list *> proclt,
+    gsl::not_null<domain_intel_x64 *> domain,
+    vcpuid::type vcpuid)
+{
+    m_proclt = proclt;
+    m_domain = domain;
+    m_thread = nullptr;
+
+    m_exit_stats.detach(m_vcpuid);
+    m_exit_stats.reset();
+
+    m_vcpuid = vcpuid;
+    m_exit_stats.attach(m_vcpuid);
+}
+
+void
+vmcs_intel_x64_hyperkernel::set_vpid(uint16_t vpid, bool launched)
+{
+    m_vpid = vpid;
+
+    if (launched && m_field_cache.update_vpid(vpid))
+        vmcs::virtual_processor_identifier::set(vpid);
+}
@@ -26,6 +26,13 @@
 PARENT_SUBDIRS += basic_c
 PARENT_SUBDIRS += basic_cxx
 PARENT_SUBDIRS += basic_driver
+PARENT_SUBDIRS += bench_channel
+PARENT_SUBDIRS += bench_channel_producer
+PARENT_SUBDIRS += bench_ipc
+PARENT_SUBDIRS += bench_ipc_server
+PARENT_SUBDIRS += bench_launch
+PARENT_SUBDIRS += bench_yield
+PARENT_SUBDIRS += test_clts
 
 ################################################################################
 # Common
@@ -24,11 +24,36 @@
 #include <iostream>
 #include <vmcall_hyperkernel_interface.h>
 
+// Note:
+//
+// Requests are handed to the driver in batches. The handler is given the
+// devices that have queued data (its second argument, as the first is the
+// events posted by other VM apps, which this driver does not use), drains
+// them (one vmcall per buffer, not per byte), and then returns to wherever
+// the driver was interrupted (i.e. the HLT loop in main) using
+// vmcall__event_return, so it must not return normally.
+//
+
+static char g_buffer[0x1000];
+
 void
-handle_ttys0(char val)
+handle_events(uint64_t events, uint64_t devices)
 {
-    vmcall__ttys1(val);
-    vmcall__sched_yield();
+    (void) events;
+
+    if ((devices & (1UL << DEVICE_TTYS0)) != 0)
+    {
+        while (true)
+        {
+            auto size = vmcall__read_driver(DEVICE_TTYS0, g_buffer, sizeof(g_buffer));
+            if (size == 0 || size == REG_INVALID)
+                break;
+
+            vmcall__write_ttys1(g_buffer, size);
+        }
+    }
+
+    vmcall__event_return();
 }
 
 int
@@ -37,12 +62,11 @@ main(int argc, const char *argv[])
     (void) argc;
     (void) argv;
 
-    vmcall__register_ttys0(reinterpret_cast<uintptr_t>(handle_ttys0));
+    vmcall__register_driver(DEVICE_TTYS0, reinterpret_cast<uintptr_t>(handle_events));
 
     auto msg = gsl::ensure_z("registered: ttys0\n");
-    for (auto c : msg)
-        vmcall__ttys1(c);
+    vmcall__write_ttys1(msg.data(), static_cast<uint64_t>(msg.size()));
 
-    vmcall__sched_yield_and_remove();
-    return 0;
+    while (true)
+        vmcall__hlt_process(0);
 }
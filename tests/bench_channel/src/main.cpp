@@ -0,0 +1,103 @@
+/*
+ * Bareflank Hyperkernel
+ *
+ * Copyright (C) 2015 Assured Information Security, Inc.
+ * Author: Rian Quinn        <quinnr@ainfosec.com>
+ * Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <channel.h>
+#include <vmcall_hyperkernel_interface.h>
+
+// Channel Microbenchmark (receiver)
+//
+// Measures the throughput of a channel in cycles per message. This is run
+// with bench_channel_producer (i.e. "bfexec bench_channel
+// bench_channel_producer"). The receiver creates and binds the channel,
+// and then drains it, blocking whenever it runs dry. The number of times
+// it had to block is printed as well, as each block costs the producer a
+// notify (the rest of the messages do not exit at all).
+//
+
+constexpr const auto channel_shmid = 0xC0000001UL;
+constexpr const auto channel_addr = 0x40000000UL;
+
+constexpr const auto num_messages = 10000000UL;
+
+static inline uint64_t
+rdtsc()
+{
+    uint32_t lo = 0;
+    uint32_t hi = 0;
+
+    __asm__ __volatile__("lfence; rdtsc" : "=a"(lo), "=d"(hi));
+    return (static_cast<uint64_t>(hi) << 32) | lo;
+}
+
+int
+main(int argc, const char *argv[])
+{
+    (void) argc;
+    (void) argv;
+
+    if (!vmcall__create_shm(channel_shmid, sizeof(struct channel_t)))
+        return 1;
+
+    if (!vmcall__map_shm(channel_shmid, channel_addr, VM_PERM_R | VM_PERM_W))
+        return 1;
+
+    if (!vmcall__bind_channel(channel_shmid))
+        return 1;
+
+    auto ch = reinterpret_cast<struct channel_t *>(channel_addr);
+
+    auto &&msg = 0UL;
+    auto &&errors = 0UL;
+    auto &&blocks = 0UL;
+
+    auto &&start = 0UL;
+
+    for (auto i = 0UL; i < num_messages;)
+    {
+        if (channel_recv(ch, &msg) == 0)
+        {
+            if (channel_prepare_wait(ch) != 0)
+            {
+                vmcall__hlt_process(0);
+                blocks++;
+            }
+
+            continue;
+        }
+
+        if (i == 0)
+            start = rdtsc();
+
+        errors += msg == i ? 0 : 1;
+        i++;
+    }
+
+    auto &&end = rdtsc();
+
+    printf("channel: %lu cycles / message (%lu messages, %lu blocks, %lu bad messages)\n",
+           (end - start) / num_messages, num_messages, blocks, errors);
+
+    vmcall__destroy_shm(channel_shmid);
+    return 0;
+}
@@ -0,0 +1,74 @@
+/*
+ * Bareflank Hyperkernel
+ *
+ * Copyright (C) 2015 Assured Information Security, Inc.
+ * Author: Rian Quinn        <quinnr@ainfosec.com>
+ * Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <cstdint>
+#include <channel.h>
+#include <vmcall_hyperkernel_interface.h>
+
+// Channel Microbenchmark (producer)
+//
+// Streams messages to bench_channel in batches, checking whether the
+// receiver needs a notify once per batch. Whenever the channel is full,
+// the producer gives the core to the receiver.
+//
+
+constexpr const auto channel_shmid = 0xC0000001UL;
+constexpr const auto channel_addr = 0x40000000UL;
+
+constexpr const auto num_messages = 10000000UL;
+constexpr const auto batch_size = 64UL;
+
+int
+main(int argc, const char *argv[])
+{
+    (void) argc;
+    (void) argv;
+
+    // The receiver creates the channel, so until it has run, the map
+    // fails.
+
+    while (!vmcall__map_shm(channel_shmid, channel_addr, VM_PERM_R | VM_PERM_W))
+        vmcall__sched_yield();
+
+    auto ch = reinterpret_cast<struct channel_t *>(channel_addr);
+
+    for (auto i = 0UL; i < num_messages;)
+    {
+        for (auto n = 0UL; n < batch_size && i < num_messages; n++)
+        {
+            while (channel_send(ch, i) == 0)
+            {
+                if (channel_needs_notify(ch) != 0)
+                    vmcall__notify_channel(channel_shmid);
+
+                vmcall__sched_yield();
+            }
+
+            i++;
+        }
+
+        if (channel_needs_notify(ch) != 0)
+            vmcall__notify_channel(channel_shmid);
+    }
+
+    return 0;
+}
@@ -0,0 +1,88 @@
+/*
+ * Bareflank Hyperkernel
+ *
+ * Copyright (C) 2015 Assured Information Security, Inc.
+ * Author: Rian Quinn        <quinnr@ainfosec.com>
+ * Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <vmcall_hyperkernel_interface.h>
+
+// IPC Microbenchmark (client)
+//
+// Measures the average round trip of a vmcall__ipc_call in cycles. This
+// is run with the server first, so that the server is process 0 (i.e.
+// "bfexec bench_ipc_server bench_ipc"). Every call switches this vCPU
+// directly to the server, and every reply switches it directly back, so
+// compared with bench_yield, this measures the cost of two process
+// context switches without the scheduler in between.
+//
+
+constexpr const auto server_processid = 0UL;
+constexpr const auto server_threadid = 0UL;
+
+constexpr const auto num_warmup = 1000UL;
+constexpr const auto num_iterations = 100000UL;
+
+static inline uint64_t
+rdtsc()
+{
+    uint32_t lo = 0;
+    uint32_t hi = 0;
+
+    __asm__ __volatile__("lfence; rdtsc" : "=a"(lo), "=d"(hi));
+    return (static_cast<uint64_t>(hi) << 32) | lo;
+}
+
+static bool
+call(uint64_t i)
+{
+    struct ipc_msg_t msg = {i, 0, 0};
+
+    // The call fails until the server is waiting for a request (i.e.
+    // until it has run at least once), so the client yields to it.
+
+    while (!vmcall__ipc_call(server_processid, server_threadid, &msg))
+        vmcall__sched_yield();
+
+    return msg.w0 == i + 1;
+}
+
+int
+main(int argc, const char *argv[])
+{
+    (void) argc;
+    (void) argv;
+
+    for (auto i = 0UL; i < num_warmup; i++)
+        call(i);
+
+    auto &&errors = 0UL;
+    auto &&start = rdtsc();
+
+    for (auto i = 0UL; i < num_iterations; i++)
+        errors += call(i) ? 0 : 1;
+
+    auto &&end = rdtsc();
+
+    printf("ipc_call: %lu cycles / round trip (%lu iterations, %lu bad replies)\n",
+           (end - start) / num_iterations, num_iterations, errors);
+
+    return 0;
+}
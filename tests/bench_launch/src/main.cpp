@@ -0,0 +1,87 @@
+/*
+ * Bareflank Hyperkernel
+ *
+ * Copyright (C) 2015 Assured Information Security, Inc.
+ * Author: Rian Quinn        <quinnr@ainfosec.com>
+ * Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <vmcall_hyperkernel_interface.h>
+
+// vCPU Launch Microbenchmark
+//
+// Measures the average cost of creating a vCPU and deleting it again, in
+// cycles, first with the vCPU pool disabled (every create builds a new
+// vmcs, exit handler and guest state), and then with the pool enabled
+// (every create rebinds a pooled vCPU, and every delete puts it back).
+//
+// Note that the vCPUs are created in this process's own process list, but
+// are never run, as this process does not yield while they exist.
+//
+
+constexpr const auto pool_size = 4UL;
+constexpr const auto num_iterations = 1000UL;
+
+static inline uint64_t
+rdtsc()
+{
+    uint32_t lo = 0;
+    uint32_t hi = 0;
+
+    __asm__ __volatile__("lfence; rdtsc" : "=a"(lo), "=d"(hi));
+    return (static_cast<uint64_t>(hi) << 32) | lo;
+}
+
+static uint64_t
+bench(uint64_t size)
+{
+    if (!vmcall__set_vcpu_pool_size(size))
+        return 0;
+
+    auto &&start = rdtsc();
+
+    for (auto i = 0UL; i < num_iterations; i++)
+    {
+        auto &&vcpuid = vmcall__create_vcpu();
+        if (vcpuid == REG_INVALID)
+            return 0;
+
+        vmcall__delete_vcpu(vcpuid);
+    }
+
+    auto &&end = rdtsc();
+    return (end - start) / num_iterations;
+}
+
+int
+main(int argc, const char *argv[])
+{
+    (void) argc;
+    (void) argv;
+
+    auto &&unpooled = bench(0);
+    auto &&pooled = bench(pool_size);
+
+    vmcall__set_vcpu_pool_size(0);
+
+    printf("create/delete vcpu (no pool): %lu cycles (%lu iterations)\n", unpooled, num_iterations);
+    printf("create/delete vcpu (pool %lu): %lu cycles (%lu iterations)\n", pool_size, pooled, num_iterations);
+
+    return 0;
+}
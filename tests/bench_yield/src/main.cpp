@@ -0,0 +1,70 @@
+/*
+ * Bareflank Hyperkernel
+ *
+ * Copyright (C) 2015 Assured Information Security, Inc.
+ * Author: Rian Quinn        <quinnr@ainfosec.com>
+ * Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <vmcall_hyperkernel_interface.h>
+
+// Yield Microbenchmark
+//
+// Measures the average cost of a vmcall__sched_yield in cycles. When two
+// copies are run on the same vCPU (i.e. "bfexec bench_yield bench_yield"),
+// every yield switches from one process to the other, so this measures
+// the cost of a process context switch (VM exit, scheduler, EPTP / VPID
+// switch, VM entry), including the TLB misses the switch causes on the
+// way back.
+//
+
+constexpr const auto num_warmup = 1000UL;
+constexpr const auto num_iterations = 100000UL;
+
+static inline uint64_t
+rdtsc()
+{
+    uint32_t lo = 0;
+    uint32_t hi = 0;
+
+    __asm__ __volatile__("lfence; rdtsc" : "=a"(lo), "=d"(hi));
+    return (static_cast<uint64_t>(hi) << 32) | lo;
+}
+
+int
+main(int argc, const char *argv[])
+{
+    (void) argc;
+    (void) argv;
+
+    for (auto i = 0UL; i < num_warmup; i++)
+        vmcall__sched_yield();
+
+    auto &&start = rdtsc();
+
+    for (auto i = 0UL; i < num_iterations; i++)
+        vmcall__sched_yield();
+
+    auto &&end = rdtsc();
+
+    printf("sched_yield: %lu cycles / yield (%lu iterations)\n",
+           (end - start) / num_iterations, num_iterations);
+
+    return 0;
+}
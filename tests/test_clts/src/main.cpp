@@ -0,0 +1,93 @@
+/*
+ * Bareflank Hyperkernel
+ *
+ * Copyright (C) 2015 Assured Information Security, Inc.
+ * Author: Rian Quinn        <quinnr@ainfosec.com>
+ * Author: Brendan Kerrigan  <kerriganb@ainfosec.com>
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <cstdio>
+#include <cstdint>
+#include <vmcall_hyperkernel_interface.h>
+
+// CR0.TS Test
+//
+// Extended state is switched lazily, so when a thread is given a core, the
+// previous owner's XMM registers are still loaded, and only CR0.TS keeps the
+// new thread from reading them. VM apps run in ring 0, so this checks that
+// clearing TS directly (CLTS) does not expose them. Two copies are run on
+// the same vCPU (i.e. "bfexec test_clts test_clts"). Each one stamps XMM15
+// with its own value and yields to the other, which stamps XMM15 with a
+// different value. On the way back, the first thing each copy does is CLTS
+// followed by a read of XMM15, which must still hold its own stamp.
+//
+// Note: XMM15 is used because nothing between the stamp and the read
+// (i.e. vmcall__sched_yield) touches it.
+//
+
+constexpr const auto num_iterations = 1000UL;
+
+static inline uint64_t
+rdtsc()
+{
+    uint32_t lo = 0;
+    uint32_t hi = 0;
+
+    __asm__ __volatile__("lfence; rdtsc" : "=a"(lo), "=d"(hi));
+    return (static_cast<uint64_t>(hi) << 32) | lo;
+}
+
+static inline void
+stamp_xmm15(uint64_t val)
+{
+    __asm__ __volatile__("movq %0, %%xmm15" : : "r"(val) : "xmm15");
+}
+
+static inline uint64_t
+clts_read_xmm15()
+{
+    uint64_t val = 0;
+
+    __asm__ __volatile__("clts; movq %%xmm15, %0" : "=r"(val));
+    return val;
+}
+
+int
+main(int argc, const char *argv[])
+{
+    (void) argc;
+    (void) argv;
+
+    auto &&stamp = rdtsc() | 1UL;
+
+    for (auto i = 0UL; i < num_iterations; i++)
+    {
+        stamp_xmm15(stamp + i);
+        vmcall__sched_yield();
+
+        auto &&val = clts_read_xmm15();
+
+        if (val != stamp + i)
+        {
+            printf("test_clts: FAIL: read 0x%lx, expected 0x%lx\n", val, stamp + i);
+            return 1;
+        }
+    }
+
+    printf("test_clts: PASS (%lu iterations)\n", num_iterations);
+    return 0;
+}